@@ -0,0 +1,136 @@
+#include "bench.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "thread_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string to_json(const std::vector<BenchResult>& results) {
+    std::ostringstream os;
+    os << std::setprecision(6);
+    os << "{\n";
+    os << "  \"threads\": " << ThreadPool::global().thread_count() << ",\n";
+    os << "  \"results\": [\n";
+    for (size_t i{}; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "    {\"name\": \"" << r.name << "\", \"kind\": \"" << r.kind
+           << "\", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.ns_per_op;
+        if (r.kind == "macro") {
+            os << ", \"mrays_per_s\": " << r.mrays_per_s;
+        }
+        if (r.variance_time > 0.0) {
+            os << ", \"variance_time\": " << r.variance_time;
+        }
+        os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n";
+    os << "}\n";
+    return os.str();
+}
+
+}  // namespace
+
+bool BenchRunner::selected(const std::string& name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+void BenchRunner::run_micro(const std::string& name, const std::function<void(size_t)>& op) {
+    if (!selected(name)) {
+        return;
+    }
+
+    // Warm up caches and branch predictors
+    for (size_t i{}; i < 100; ++i) {
+        op(i);
+    }
+
+    size_t iterations{};
+    size_t batch{64};
+    auto start = Clock::now();
+    double elapsed{};
+    while (elapsed < min_seconds) {
+        for (size_t i{}; i < batch; ++i) {
+            op(iterations + i);
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed = seconds_since(start);
+    }
+
+    BenchResult res{name, "micro", iterations, elapsed * 1.0e9 / static_cast<double>(iterations)};
+    std::cerr << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << res.ns_per_op << " ns/op\n";
+    results.push_back(res);
+}
+
+void BenchRunner::run_macro(const std::string& name, const std::function<size_t()>& op) {
+    if (!selected(name)) {
+        return;
+    }
+
+    auto start     = Clock::now();
+    auto rays      = op();
+    double elapsed = seconds_since(start);
+
+    BenchResult res{name, "macro", 1, elapsed * 1.0e9};
+    res.mrays_per_s = static_cast<double>(rays) / elapsed / 1.0e6;
+    std::cerr << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << elapsed * 1000.0 << " ms" << std::setw(10)
+              << std::setprecision(3) << res.mrays_per_s << " Mrays/s\n";
+    results.push_back(res);
+}
+
+void BenchRunner::set_variance_time(const std::string& name, double value) {
+    for (auto& res : results) {
+        if (res.name == name) {
+            res.variance_time = value;
+            std::cerr << std::left << std::setw(40) << name << std::right << std::setw(12)
+                      << std::scientific << std::setprecision(3) << value << " variance x s\n"
+                      << std::fixed;
+        }
+    }
+}
+
+// Usage: v3_bench [--filter <substring>] [--min-time <seconds>] [--json <path>]
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string json_path;
+    double min_seconds{0.2};
+
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_seconds = std::stod(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            std::cerr << "usage: v3_bench [--filter <substring>] [--min-time <seconds>] [--json <path>]\n";
+            return 1;
+        }
+    }
+
+    BenchRunner runner{min_seconds, filter};
+    register_micro_benchmarks(runner);
+    register_macro_benchmarks(runner);
+
+    auto json = to_json(runner.get_results());
+    if (json_path.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream{json_path} << json;
+    }
+    return 0;
+}
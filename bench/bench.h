@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Keep a computed value alive so the optimizer can't drop the benchmarked call
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult {
+    std::string name;
+    std::string kind;  // "micro" or "macro"
+    size_t iterations{};
+    double ns_per_op{};
+
+    /// Camera rays per second in millions, macro benchmarks only
+    double mrays_per_s{};
+
+    /// Pixel variance times render seconds, for benchmarks comparing render efficiency
+    double variance_time{};
+};
+
+class BenchRunner {
+  public:
+    BenchRunner(double min_seconds, std::string filter)
+        : min_seconds{min_seconds},
+          filter{std::move(filter)} {}
+
+    /// @brief Time 'op' in batches until 'min_seconds' have passed. 'op(i)' runs one operation,
+    /// 'i' counts up from zero so inputs can be cycled.
+    void run_micro(const std::string& name, const std::function<void(size_t)>& op);
+
+    /// @brief Time a single run of 'op', which returns the number of camera rays it traced
+    void run_macro(const std::string& name, const std::function<size_t()>& op);
+
+    /// Attach a variance x time figure to the result of 'name', if that benchmark ran
+    void set_variance_time(const std::string& name, double value);
+
+    const std::vector<BenchResult>& get_results() const { return results; }
+
+  private:
+    bool selected(const std::string& name) const;
+
+    double min_seconds;
+    std::string filter;
+    std::vector<BenchResult> results;
+};
+
+void register_micro_benchmarks(BenchRunner& runner);
+
+void register_macro_benchmarks(BenchRunner& runner);
@@ -0,0 +1,118 @@
+#include "bdpt.h"
+#include "bench.h"
+#include "light.h"
+#include "mlt.h"
+#include "pathtracer.h"
+#include "scene.h"
+#include "tonemap.h"
+
+namespace {
+
+constexpr int image_w{160};
+constexpr int image_h{100};
+constexpr size_t spp{4};
+
+}  // namespace
+
+void register_macro_benchmarks(BenchRunner& runner) {
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(image_w) / image_h);
+    camera->focus_on_point({0, 0, 0});
+    camera->set_vfov(60);
+
+    auto scene = std::make_shared<TestScene>();
+    PathTracer renderer{image_w, image_h, std::make_shared<PixelSampler>(), spp};
+    renderer.load_scene(scene);
+
+    const std::pair<const char*, void (TestScene::*)()> scenes[] = {
+        {"render/scene1", &TestScene::load_scene1},
+        {"render/scene2", &TestScene::load_scene2},
+        {"render/scene3", &TestScene::load_scene3},
+    };
+
+    for (const auto& [name, load] : scenes) {
+        ((*scene).*load)();
+        runner.run_macro(name, [&]() {
+            renderer.render(*camera);
+            return static_cast<size_t>(image_w) * image_h * spp;
+        });
+    }
+
+    // Efficiency of the path termination policies, on scene 3 loaded last
+    for (const auto* policy : {"constant", "throughput", "throughput-split"}) {
+        auto name = std::string{"policy/"} + policy;
+        renderer.set_path_policy(create_path_policy(policy));
+        runner.run_macro(name, [&]() {
+            renderer.render(*camera);
+            return static_cast<size_t>(image_w) * image_h * spp;
+        });
+        runner.set_variance_time(name, renderer.get_stats().variance_time());
+    }
+    renderer.set_path_policy(create_path_policy("constant"));
+
+    // Direct lighting from the rectangle light of scene 3, sampled by area or by solid angle
+    for (const auto* sampling : {"area", "solid-angle"}) {
+        auto name = std::string{"lights/"} + sampling;
+        scene->set_light_sampling(parse_light_sampling(sampling));
+        runner.run_macro(name, [&]() {
+            renderer.render(*camera);
+            return static_cast<size_t>(image_w) * image_h * spp;
+        });
+        runner.set_variance_time(name, renderer.get_stats().variance_time());
+    }
+    scene->set_light_sampling(LightSampling::area);
+
+    // Path guiding needs a few training passes to pay off, so it gets more samples
+    constexpr size_t guiding_spp{32};
+    PathTracer guided{image_w, image_h, std::make_shared<PixelSampler>(), guiding_spp};
+    guided.load_scene(scene);
+    for (bool enabled : {false, true}) {
+        auto name = std::string{"guiding/"} + (enabled ? "on" : "off");
+        guided.set_guiding(enabled);
+        runner.run_macro(name, [&]() {
+            guided.render(*camera);
+            return static_cast<size_t>(image_w) * image_h * guiding_spp;
+        });
+        runner.set_variance_time(name, guided.get_stats().variance_time());
+    }
+
+    // Caustics of the glass sphere from a photon map, traced anew for every render
+    renderer.set_caustics(true);
+    runner.run_macro("caustics/photon-map", [&]() {
+        renderer.render(*camera);
+        return static_cast<size_t>(image_w) * image_h * spp;
+    });
+    runner.set_variance_time("caustics/photon-map", renderer.get_stats().variance_time());
+    renderer.set_caustics(false);
+
+    // Bidirectional path tracing and Metropolis light transport of the same scene. Their film
+    // variance misses the splatted samples, so only the time is comparable.
+    BidirectionalPathTracer bidirectional{image_w, image_h, std::make_shared<PixelSampler>(), spp};
+    bidirectional.load_scene(scene);
+    runner.run_macro("integrator/bdpt", [&]() {
+        bidirectional.render(*camera);
+        return static_cast<size_t>(image_w) * image_h * spp;
+    });
+
+    MetropolisRenderer metropolis{image_w, image_h, std::make_shared<PixelSampler>(), spp};
+    metropolis.load_scene(scene);
+    runner.run_macro("integrator/mlt", [&]() {
+        metropolis.render(*camera);
+        return static_cast<size_t>(image_w) * image_h * spp;
+    });
+
+    // Output stage of a full HD frame
+    Buffer2D<RgbColor> radiance{1920, 1080};
+    for (size_t i{}; i < radiance.size(); ++i) {
+        auto v              = static_cast<double>(i % 1920) / 480.0;
+        radiance.data()[i] = {v, 0.5 * v, 0.25 * v};
+    }
+    Image image{1920, 1080};
+    DisplayOptions display;
+    display.tonemapper = Tonemapper::aces;
+    display.dither     = true;
+    runner.run_macro("display/1080p", [&]() {
+        write_display_image(radiance, display, image);
+        return radiance.size();
+    });
+}
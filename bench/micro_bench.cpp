@@ -0,0 +1,156 @@
+#include <filesystem>
+#include <vector>
+
+#include "bench.h"
+#include "bxdf.h"
+#include "camera.h"
+#include "fresnel.h"
+#include "image.h"
+#include "image_texture.h"
+#include "intersection.h"
+#include "logger.h"
+#include "rng.h"
+#include "scene.h"
+#include "shape.h"
+#include "utils.h"
+
+namespace {
+
+// Power of two so inputs can be cycled with a mask
+constexpr size_t input_count{1024};
+
+std::vector<Ray> random_rays(const Vec3& origin_center, double origin_spread, const Vec3& target) {
+    std::vector<Ray> rays;
+    rays.reserve(input_count);
+    for (size_t i{}; i < input_count; ++i) {
+        auto o = origin_center + random_vec3(-origin_spread, origin_spread);
+        auto d = (target + random_vec3(-1, 1)) - o;
+        rays.emplace_back(o, d);
+    }
+    return rays;
+}
+
+std::vector<Vec3> random_points(double a, double b) {
+    std::vector<Vec3> points;
+    points.reserve(input_count);
+    for (size_t i{}; i < input_count; ++i) {
+        points.push_back(random_vec3(a, b));
+    }
+    return points;
+}
+
+}  // namespace
+
+void register_micro_benchmarks(BenchRunner& runner) {
+    // ----------- Shapes -----------
+    auto sphere_rays = random_rays({0, 0, 5}, 0.5, Vec3::zero());
+    Sphere sphere;
+    runner.run_micro("Sphere::hit", [&](size_t i) {
+        do_not_optimize(sphere.hit(sphere_rays[i & (input_count - 1)], 1e-6, inf));
+    });
+
+    auto rect_rays = random_rays({0, 2, 0}, 0.5, Vec3::zero());
+    RectXZ rect;
+    runner.run_micro("RectXZ::hit", [&](size_t i) {
+        do_not_optimize(rect.hit(rect_rays[i & (input_count - 1)], 1e-6, inf));
+    });
+
+    auto t_sphere_rays = random_rays({0, 1, 6}, 0.5, {0, 1, 0});
+    TransformedShape t_sphere{primitives.sphere, {0, 1, 0}, {0, 0, 0}, Vec3::all(1.2)};
+    runner.run_micro("TransformedShape::hit", [&](size_t i) {
+        do_not_optimize(t_sphere.hit(t_sphere_rays[i & (input_count - 1)], 1e-6, inf));
+    });
+
+    // ----------- Transforms -----------
+    Mat4 m = translate({1, 2, 3}) * rotate({10, 20, 30}) * scale({1, 2, 3});
+    runner.run_micro("Mat4::inverse", [&](size_t) {
+        do_not_optimize(m);
+        do_not_optimize(m.inverse());
+    });
+
+    Transform t{m};
+    auto points = random_points(-10, 10);
+    runner.run_micro("Transform::on_point", [&](size_t i) {
+        do_not_optimize(t.on_point(points[i & (input_count - 1)]));
+    });
+
+    std::vector<ShadingFrame> frames;
+    for (const auto& p : points) {
+        frames.push_back(generate_world_shading_frame(p));
+    }
+    runner.run_micro("shading_transforms", [&](size_t i) {
+        do_not_optimize(shading_transforms(frames[i & (input_count - 1)]));
+    });
+
+    // ----------- Camera -----------
+    Camera camera{{0, 4, 6}, {0, 0, -1}};
+    camera.set_aspect_ratio(1.5);
+    camera.focus_on_point({0, 0, 0});
+    runner.run_micro("Camera::generate_ray", [&](size_t i) {
+        const auto& p = points[i & (input_count - 1)];
+        do_not_optimize(camera.generate_ray(p.x(), p.y()));
+    });
+
+    // One 16x16 tile with 4 samples per pixel per op
+    std::vector<double> offsets(16 * 16 * 4, 0.5);
+    RayBatch tile_rays;
+    runner.run_micro("Camera::generate_tile_rays/16x16x4", [&](size_t) {
+        camera.generate_tile_rays(
+            300, 200, {0, 0, 16, 16}, 4, offsets.data(), offsets.data(), tile_rays);
+        do_not_optimize(tile_rays.dx[0]);
+    });
+
+    // ----------- Random numbers -----------
+    runner.run_micro("RandomStream::next", [&](size_t) { do_not_optimize(RandomStream::next()); });
+
+    runner.run_micro("RandomStream::start", [&](size_t i) {
+        RandomStream::start(1, i, i & 15);
+        do_not_optimize(RandomStream::dimension());
+    });
+
+    // ----------- Materials -----------
+    BsdfDiffuse diffuse{Color::white, 0.8};
+    runner.run_micro("BsdfDiffuse::sample", [&](size_t i) {
+        do_not_optimize(diffuse.sample(points[i & (input_count - 1)]));
+    });
+
+    FresnelDielectrics fresnel;
+    std::vector<double> cosines;
+    for (size_t i{}; i < input_count; ++i) {
+        cosines.push_back(random_double(-1, 1));
+    }
+    runner.run_micro("FresnelDielectrics::reflectance", [&](size_t i) {
+        do_not_optimize(fresnel.reflectance(cosines[i & (input_count - 1)], 1.0, 1.52));
+    });
+
+    // ----------- Textures -----------
+    auto texture_path = (std::filesystem::temp_directory_path() / "v3_bench_texture.png").string();
+    Image texture_image{1024, 1024};
+    texture_image.fill_u({200, 120, 40});
+    texture_image.save(texture_path);
+    ImageTexture texture{texture_path};
+    std::vector<Vec2> uvs;
+    for (size_t i{}; i < input_count; ++i) {
+        uvs.push_back({random_double(), random_double()});
+    }
+    runner.run_micro("ImageTexture::lookup", [&](size_t i) {
+        do_not_optimize(texture.lookup(uvs[i & (input_count - 1)]));
+    });
+
+    // ----------- Logging -----------
+    Logger::set_file("/dev/null");
+    runner.run_micro("Logger::log", [&](size_t i) {
+        Logger::log("[bench] sample ", i, " pdf ", cosines[i & (input_count - 1)]);
+        if ((i & 127) == 0) {
+            Logger::flush();  // measure formatting and queueing, not dropped lines
+        }
+    });
+
+    // ----------- Scene -----------
+    TestScene scene;
+    scene.load_scene3();
+    auto scene_rays = random_rays({0, 4, 6}, 0.2, {0, 1, 2});
+    runner.run_micro("TestScene::hit", [&](size_t i) {
+        do_not_optimize(scene.hit(scene_rays[i & (input_count - 1)]));
+    });
+}
@@ -0,0 +1,160 @@
+#include "batch_runner.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "bdpt.h"
+#include "mlt.h"
+#include "profiler.h"
+#include "scene_cache.h"
+#include "timer.h"
+
+namespace {
+
+// "out/a.png", 7 -> "out/a_0007.png"
+std::string frame_path(const std::string& output, size_t frame) {
+    auto dot = output.rfind('.');
+    auto sep = output.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) {
+        dot = output.size();
+    }
+
+    std::ostringstream os;
+    os << output.substr(0, dot) << "_" << std::setw(4) << std::setfill('0') << frame
+       << output.substr(dot);
+    return os.str();
+}
+
+}  // namespace
+
+const SceneDescription& BatchRunner::get_scene(const std::string& path) {
+    auto it = scenes.find(path);
+    if (it == scenes.end()) {
+        it = scenes.emplace(path, load_scene_cached(path)).first;
+    }
+    // Set on every use, the runner's mode may have changed since the scene was loaded
+    it->second.scene->set_light_sampling(light_sampling);
+    return it->second;
+}
+
+void BatchRunner::run(const std::vector<RenderJob>& jobs) {
+    Timer timer;
+    for (size_t i{}; i < jobs.size(); ++i) {
+        std::cout << "job " << i + 1 << "/" << jobs.size() << ": " << jobs[i].scene << "\n";
+        run_job(jobs[i]);
+    }
+    std::cout << jobs.size() << " jobs, " << scenes.size()
+              << " scenes loaded, total time: " << format_time(timer.duration()) << "\n";
+}
+
+void BatchRunner::run_job(const RenderJob& job) {
+    PROFILE_ZONE("batch_job");
+    const auto& desc = get_scene(job.scene);
+
+    auto settings = desc.settings;
+    settings.image_width       = job.image_width.value_or(settings.image_width);
+    settings.image_height      = job.image_height.value_or(settings.image_height);
+    settings.samples_per_pixel = job.samples_per_pixel.value_or(settings.samples_per_pixel);
+    settings.output            = job.output.value_or(settings.output);
+
+    // Jobs may move the camera, so each one works on a copy
+    Camera camera = *desc.camera;
+    if (job.camera_location) {
+        camera.set_location(*job.camera_location);
+    }
+    if (job.camera_focus) {
+        camera.focus_on_point(*job.camera_focus);
+    }
+    if (job.camera_vfov) {
+        camera.set_vfov(*job.camera_vfov);
+    }
+    camera.set_aspect_ratio(static_cast<double>(settings.image_width) / settings.image_height);
+
+    auto renderer_ptr =
+        create_renderer(settings.image_width, settings.image_height, settings.samples_per_pixel);
+    auto& renderer = *renderer_ptr;
+    renderer.load_scene(desc.scene);
+    renderer.set_denoise(denoise_enabled);
+    renderer.set_aovs(enabled_aovs);
+    renderer.set_time_budget(time_budget);
+    renderer.set_seed(seed);
+    renderer.set_display_options(display_options);
+    if (job.crop) {
+        const auto& crop = *job.crop;
+        if (crop.x1 > settings.image_width || crop.y1 > settings.image_height) {
+            throw std::runtime_error{"crop window outside of the image"};
+        }
+        renderer.set_crop_window(crop);
+    }
+
+    if (!job.frames) {
+        render_frame(renderer, camera, settings.output, job.film);
+        return;
+    }
+
+    auto& scene         = *desc.scene;
+    auto [first, count] = *job.frames;
+    for (size_t frame{first}; frame < first + count; ++frame) {
+        // Only the animated instances move, the BVH is refit rather than rebuilt
+        Timer setup_timer;
+        apply_animations(scene, desc.animations, static_cast<double>(frame));
+        bool rebuilt = scene.update_accelerator(rebuild_threshold);
+        std::cout << "frame " << frame << ": setup " << setup_timer.seconds() * 1000.0 << " ms ("
+                  << (rebuilt ? "rebuild" : "refit") << ")\n";
+
+        auto film = job.film ? std::optional{frame_path(*job.film, frame)} : std::nullopt;
+        render_frame(renderer, camera, frame_path(settings.output, frame), film);
+    }
+
+    // Leave the scene as loaded for later jobs
+    apply_animations(scene, desc.animations, 0.0);
+    scene.update_accelerator(rebuild_threshold);
+}
+
+std::unique_ptr<RayTracer> BatchRunner::create_renderer(int width, int height, size_t spp) const {
+    auto p_sampler = std::make_shared<PixelSampler>();
+    if (bidirectional) {
+        if (path_policy || guiding || caustics_enabled) {
+            throw std::runtime_error{
+                "bidirectional renders take no path policy, guiding or caustics options"};
+        }
+        return std::make_unique<BidirectionalPathTracer>(width, height, p_sampler, spp);
+    }
+    if (metropolis && time_budget > 0.0) {
+        throw std::runtime_error{"Metropolis renders have no time budget"};
+    }
+    auto renderer = metropolis ? std::make_unique<MetropolisRenderer>(width, height, p_sampler, spp)
+                               : std::make_unique<PathTracer>(width, height, p_sampler, spp);
+    if (path_policy) {
+        renderer->set_path_policy(path_policy);
+    }
+    renderer->set_guiding(guiding);
+    renderer->set_caustics(caustics_enabled, caustic_options);
+    return renderer;
+}
+
+void BatchRunner::render_frame(RayTracer& renderer,
+                               const Camera& camera,
+                               const std::string& output,
+                               const std::optional<std::string>& film) {
+    Timer timer;
+    renderer.render(camera);
+    size_t render_time = timer.reset();
+
+    renderer.save_output(output);
+    if (film) {
+        renderer.get_film().save(*film);
+    }
+    if (enabled_aovs != AovType::none || time_budget > 0.0) {
+        renderer.save_aovs(output.substr(0, output.rfind('.')));
+    }
+    std::cout << "render time: " << format_time(render_time) << "\n";
+
+    if (print_stats) {
+        auto stats = renderer.get_stats();
+        stats.add_stage("save", timer.seconds());
+        stats.print(std::cout);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "aov.h"
+#include "job_list.h"
+#include "pathtracer.h"
+#include "scene_loader.h"
+
+// Renders a list of jobs back to back in one process. Each scene file is loaded and its BVH
+// built once, then shared by every job that names it. Renders run on the global thread pool.
+// Animation sequences move the animated objects in place and refit the BVH between frames.
+class BatchRunner {
+  public:
+    void set_denoise(bool enabled) { denoise_enabled = enabled; }
+
+    void set_aovs(AovType aovs) { enabled_aovs = aovs; }
+
+    void set_print_stats(bool enabled) { print_stats = enabled; }
+
+    /// Render every job for a fixed wall time instead of a fixed spp, see RayTracer
+    void set_time_budget(double seconds) { time_budget = seconds; }
+
+    /// Seed of every render, see RayTracer::set_seed
+    void set_seed(uint64_t seed) { this->seed = seed; }
+
+    void set_display_options(const DisplayOptions& options) { display_options = options; }
+
+    void set_path_policy(std::shared_ptr<const PathPolicy> policy) {
+        path_policy = std::move(policy);
+    }
+
+    /// Guide the paths of every render by learned radiance, see PathTracer::set_guiding
+    void set_guiding(bool enabled) { guiding = enabled; }
+
+    /// Render caustics from photon maps, see PathTracer::set_caustics
+    void set_caustics(bool enabled, const CausticOptions& options = {}) {
+        caustics_enabled = enabled;
+        caustic_options  = options;
+    }
+
+    /// Render with a BidirectionalPathTracer. It takes none of the path tracer options above,
+    /// jobs then throw.
+    void set_bidirectional(bool enabled) { bidirectional = enabled; }
+
+    /// Render with a MetropolisRenderer. It has no time budget, jobs then throw.
+    void set_metropolis(bool enabled) { metropolis = enabled; }
+
+    /// How the lights of scenes loaded from now on sample points, see Light::set_sampling.
+    /// Unset keeps each light's default.
+    void set_light_sampling(std::optional<LightSampling> sampling) { light_sampling = sampling; }
+
+    /// Rebuild the BVH of an animation once refitting made it this much more expensive
+    void set_rebuild_threshold(double max_cost_ratio) { rebuild_threshold = max_cost_ratio; }
+
+    void run(const std::vector<RenderJob>& jobs);
+
+    /// Loaded scene for a path, loading it on first use
+    const SceneDescription& get_scene(const std::string& path);
+
+    size_t loaded_scene_count() const { return scenes.size(); }
+
+  private:
+    void run_job(const RenderJob& job);
+
+    std::unique_ptr<RayTracer> create_renderer(int width, int height, size_t spp) const;
+
+    void render_frame(RayTracer& renderer,
+                      const Camera& camera,
+                      const std::string& output,
+                      const std::optional<std::string>& film);
+
+    std::unordered_map<std::string, SceneDescription> scenes;
+
+    bool denoise_enabled{false};
+    AovType enabled_aovs{AovType::none};
+    bool print_stats{false};
+    double time_budget{};
+    uint64_t seed{};
+    DisplayOptions display_options;
+    std::shared_ptr<const PathPolicy> path_policy;  // else the path tracer's default
+    bool guiding{false};
+    bool caustics_enabled{false};
+    CausticOptions caustic_options;
+    bool bidirectional{false};
+    bool metropolis{false};
+    std::optional<LightSampling> light_sampling;
+    double rebuild_threshold{1.5};
+};
@@ -3,8 +3,15 @@
 #include "utils.h"
 
 void Camera::set_pose(const Vec3& location, const Vec3& look_at) {
-    set_location(location);
-    set_look_at(look_at);
+    this->location = location;
+    this->look_at  = look_at;
+    update_basis();
+}
+
+void Camera::update_basis() {
+    u_axis = u_vec();
+    v_axis = v_vec();
+    corner = lowerleft_corner();
 }
 
 Vec3 Camera::v_vec() const {
@@ -27,9 +34,36 @@ void Camera::focus_on_point(const Vec3& p) {
     set_look_at(normalized(p - location));
 }
 
-Ray Camera::generate_ray(double u, double v) const {
-    const auto& lowerLeft = lowerleft_corner();
-    return {location, lowerLeft + u * u_vec() + v * v_vec() - location};
+void Camera::generate_tile_rays(int image_width,
+                                int image_height,
+                                const ImageTile& tile,
+                                size_t samples_per_pixel,
+                                const double* u_offsets,
+                                const double* v_offsets,
+                                RayBatch& rays) const {
+    rays.resize(static_cast<size_t>(tile.pixel_count()) * samples_per_pixel);
+
+    // Direction = (corner - location) + u * u_axis + v * v_axis, per component
+    Vec3 base    = corner - location;
+    double inv_w = 1.0 / image_width;
+    double inv_h = 1.0 / image_height;
+    size_t i{};
+    for (int y{tile.y0}; y < tile.y1; ++y) {
+        double row_v = image_height - y - 1.0;
+        for (int x{tile.x0}; x < tile.x1; ++x) {
+            for (size_t s{}; s < samples_per_pixel; ++s, ++i) {
+                double u = (x + u_offsets[i]) * inv_w;
+                double v = (row_v + v_offsets[i]) * inv_h;
+
+                rays.ox[i] = location.x();
+                rays.oy[i] = location.y();
+                rays.oz[i] = location.z();
+                rays.dx[i] = base.x() + u * u_axis.x() + v * v_axis.x();
+                rays.dy[i] = base.y() + u * u_axis.y() + v * v_axis.y();
+                rays.dz[i] = base.z() + u * u_axis.z() + v * v_axis.z();
+            }
+        }
+    }
 }
 
 Vec3 Camera::normalized_right() const {
@@ -57,6 +91,34 @@ std::pair<double, double> Camera::to_image_plane_uv(
     return {img_u, img_v};
 }
 
+std::optional<std::pair<double, double>> Camera::project(const Vec3& p) const {
+    auto forward = look_at.normalized();
+    auto d       = p - location;
+    double depth = dot(d, forward);
+    if (depth <= 0.0) {
+        return std::nullopt;
+    }
+
+    // Intersect the image plane, then measure along its edges
+    auto on_plane = location + d * (focal_length / depth) - corner;
+    double u      = dot(on_plane, u_axis) / dot(u_axis, u_axis);
+    double v      = dot(on_plane, v_axis) / dot(v_axis, v_axis);
+    if (u < 0.0 || u >= 1.0 || v < 0.0 || v >= 1.0) {
+        return std::nullopt;
+    }
+    return std::make_pair(u, v);
+}
+
+double Camera::direction_pdf(const Vec3& d) const {
+    if (!project(location + d)) {
+        return 0.0;
+    }
+    // Image plane area over projected solid angle: dA = f^2 / cos^3 dw
+    double cos_theta = dot(normalized(d), look_at.normalized());
+    double area      = image_plane_width() * image_plane_height();
+    return focal_length * focal_length / (area * cos_theta * cos_theta * cos_theta);
+}
+
 std::shared_ptr<Camera> create_camera(const Vec3& location, const Vec3& look_at) {
     return std::make_shared<Camera>(location, look_at);
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include "ray.h"
 #include "vec.h"
@@ -10,6 +14,32 @@
 // x: right
 // y: down
 
+// Pixel rectangle [x0, x1) x [y0, y1) of an image
+struct ImageTile {
+    int x0{};
+    int y0{};
+    int x1{};
+    int y1{};
+
+    int pixel_count() const { return (x1 - x0) * (y1 - y0); }
+};
+
+// Rays as structure of arrays, the layout packet and wavefront tracers consume
+struct RayBatch {
+    std::vector<double> ox, oy, oz;
+    std::vector<double> dx, dy, dz;
+
+    size_t size() const { return ox.size(); }
+
+    void resize(size_t n) {
+        for (auto* v : {&ox, &oy, &oz, &dx, &dy, &dz}) {
+            v->resize(n);
+        }
+    }
+
+    Ray get(size_t i) const { return {{ox[i], oy[i], oz[i]}, {dx[i], dy[i], dz[i]}}; }
+};
+
 class Camera {
   public:
     Camera(Vec3 location,
@@ -23,33 +53,75 @@ class Camera {
           up{up},
           aspect_ratio{aspect_ratio},
           focal_length{focal_length},
-          vfov{vfov} {}
+          vfov{vfov} {
+        update_basis();
+    }
 
     Vec3 get_location() const { return location; }
 
-    void set_location(const Vec3& location) { this->location = location; }
+    void set_location(const Vec3& location) {
+        this->location = location;
+        update_basis();
+    }
 
     Vec3 get_look_at() const { return look_at; }
 
-    void set_look_at(const Vec3& look_at) { this->look_at = look_at; }
+    void set_look_at(const Vec3& look_at) {
+        this->look_at = look_at;
+        update_basis();
+    }
 
     void set_pose(const Vec3& location, const Vec3& look_at);
 
-    void set_aspect_ratio(double aspectRatio) { this->aspect_ratio = aspectRatio; }
+    void set_aspect_ratio(double aspectRatio) {
+        this->aspect_ratio = aspectRatio;
+        update_basis();
+    }
+
+    void set_vfov(double vFov) {
+        this->vfov = vFov;
+        update_basis();
+    }
 
-    void set_vfov(double vFov) { this->vfov = vFov; }
+    double get_aspect_ratio() const { return aspect_ratio; }
+
+    double get_vfov() const { return vfov; }
 
     void focus_on_point(const Vec3& p);
 
-    Ray generate_ray(double u, double v) const;
+    Ray generate_ray(double u, double v) const {
+        return {location, corner + u * u_axis + v * v_axis - location};
+    }
+
+    /// @brief Generate 'samples_per_pixel' rays for every pixel of 'tile', pixel by pixel in row
+    /// major order. 'u_offsets' and 'v_offsets' hold the in-pixel position of every ray, in the
+    /// same order. 'rays' is resized to tile.pixel_count() * samples_per_pixel.
+    void generate_tile_rays(int image_width,
+                            int image_height,
+                            const ImageTile& tile,
+                            size_t samples_per_pixel,
+                            const double* u_offsets,
+                            const double* v_offsets,
+                            RayBatch& rays) const;
 
     double image_plane_width() const;
     double image_plane_height() const;
 
+    /// @brief Image plane coordinates (u, v) in [0, 1)^2 at which generate_ray() passes through
+    /// 'p'. Empty if 'p' is behind the camera or outside the image.
+    std::optional<std::pair<double, double>> project(const Vec3& p) const;
+
+    /// @brief Density over solid angle of the direction of generate_ray() for (u, v) uniform
+    /// over the image plane, at direction 'd'. Zero outside the image.
+    double direction_pdf(const Vec3& d) const;
+
     std::pair<double, double> to_image_plane_uv(
         int image_width, int image_height, int x, int y, double u, double v) const;
 
   private:
+    /// Recompute the cached image plane, called whenever pose or projection change
+    void update_basis();
+
     Vec3 normalized_right() const;
     Vec3 normalized_top() const;
     Vec3 u_vec() const;
@@ -63,6 +135,11 @@ class Camera {
     double aspect_ratio{1.0};
     double focal_length{1.0};
     double vfov{60.0};
+
+    /// Lower left corner of the image plane and its edges, see update_basis()
+    Vec3 corner;
+    Vec3 u_axis;
+    Vec3 v_axis;
 };
 
 std::shared_ptr<Camera> create_camera(const Vec3& location, const Vec3& look_at);
\ No newline at end of file
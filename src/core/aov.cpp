@@ -0,0 +1,100 @@
+#include "aov.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "image.h"
+
+namespace {
+
+const std::pair<const char*, AovType> aov_names[] = {
+    {"depth", AovType::depth},
+    {"normal", AovType::normal},
+    {"albedo", AovType::albedo},
+    {"object_id", AovType::object_id},
+    {"material_id", AovType::material_id},
+    {"direct", AovType::direct},
+    {"indirect", AovType::indirect},
+    {"sample_count", AovType::sample_count},
+    {"all", AovType::all},
+};
+
+}  // namespace
+
+AovType parse_aov_list(const std::string& list) {
+    AovType res{AovType::none};
+    std::istringstream in{list};
+    for (std::string name; std::getline(in, name, ',');) {
+        bool found{false};
+        for (const auto& [aov_name, aov] : aov_names) {
+            if (name == aov_name) {
+                res   = res | aov;
+                found = true;
+            }
+        }
+        if (!found) {
+            throw std::runtime_error{"unknown AOV '" + name + "'"};
+        }
+    }
+    return res;
+}
+
+AovBuffers::AovBuffers(int w, int h, AovType enabled) : enabled{enabled} {
+    if (has(AovType::depth)) {
+        depth = {w, h, 0.0};
+    }
+    if (has(AovType::normal)) {
+        normal = {w, h, Vec3::zero()};
+    }
+    if (has(AovType::albedo)) {
+        albedo = {w, h};
+    }
+    if (has(AovType::object_id)) {
+        object_id = {w, h, -1.0};
+    }
+    if (has(AovType::material_id)) {
+        material_id = {w, h, -1.0};
+    }
+    if (has(AovType::direct)) {
+        direct = {w, h};
+    }
+    if (has(AovType::indirect)) {
+        indirect = {w, h};
+    }
+    if (has(AovType::sample_count)) {
+        sample_count = {w, h, 0.0};
+    }
+}
+
+void AovBuffers::save(const std::string& prefix) const {
+    if (has(AovType::depth)) {
+        save_pfm(prefix + "_depth.pfm", depth);
+    }
+    if (has(AovType::normal)) {
+        Buffer2D<RgbColor> rgb{normal.get_width(), normal.get_height()};
+        for (size_t i{}; i < normal.size(); ++i) {
+            const auto& n = normal.data()[i];
+            rgb.data()[i] = {n.x(), n.y(), n.z()};
+        }
+        save_pfm(prefix + "_normal.pfm", rgb);
+    }
+    if (has(AovType::albedo)) {
+        save_pfm(prefix + "_albedo.pfm", albedo);
+    }
+    if (has(AovType::object_id)) {
+        save_pfm(prefix + "_object_id.pfm", object_id);
+    }
+    if (has(AovType::material_id)) {
+        save_pfm(prefix + "_material_id.pfm", material_id);
+    }
+    if (has(AovType::direct)) {
+        save_pfm(prefix + "_direct.pfm", direct);
+    }
+    if (has(AovType::indirect)) {
+        save_pfm(prefix + "_indirect.pfm", indirect);
+    }
+    if (has(AovType::sample_count)) {
+        save_pfm(prefix + "_sample_count.pfm", sample_count);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+
+#include "buffer2d.h"
+#include "color.h"
+#include "vec.h"
+
+// Arbitrary output variables: per-pixel channels written alongside the beauty pass
+enum class AovType : unsigned {
+    none         = 0x00,
+    depth        = 0x01,
+    normal       = 0x02,
+    albedo       = 0x04,
+    object_id    = 0x08,
+    material_id  = 0x10,
+    direct       = 0x20,
+    indirect     = 0x40,
+    sample_count = 0x80,
+    all          = 0xff
+};
+
+inline AovType operator|(AovType a, AovType b) {
+    return static_cast<AovType>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+}
+
+inline bool has_aov(AovType set, AovType aov) {
+    return (static_cast<unsigned>(set) & static_cast<unsigned>(aov)) != 0;
+}
+
+/// @brief Parse a comma separated list like "depth,normal" or "all". Throws std::runtime_error on
+/// unknown names.
+AovType parse_aov_list(const std::string& list);
+
+// Only the buffers of enabled AOVs are allocated
+class AovBuffers {
+  public:
+    AovBuffers() = default;
+
+    AovBuffers(int w, int h, AovType enabled);
+
+    AovType get_enabled() const { return enabled; }
+
+    bool has(AovType aov) const { return has_aov(enabled, aov); }
+
+    /// @brief Write every enabled AOV to "<prefix>_<name>.pfm" as 32-bit float
+    void save(const std::string& prefix) const;
+
+    /// Distance from the camera to the first hit, averaged over samples, zero for escaped rays
+    Buffer2D<double> depth;
+
+    /// World space normal at the first hit, zero for escaped rays
+    Buffer2D<Vec3> normal;
+
+    Buffer2D<RgbColor> albedo;
+
+    /// Index of the object hit by the first sample of each pixel, -1 for escaped rays. Lights
+    /// come after the objects.
+    Buffer2D<double> object_id;
+
+    /// Index of the material hit by the first sample of each pixel in order of first use, -1 for
+    /// escaped rays and lights
+    Buffer2D<double> material_id;
+
+    /// Emitted radiance at the first hit plus direct lighting there
+    Buffer2D<RgbColor> direct;
+
+    /// Everything else, so direct + indirect is the beauty pass
+    Buffer2D<RgbColor> indirect;
+
+    Buffer2D<double> sample_count;
+
+  private:
+    AovType enabled{AovType::none};
+};
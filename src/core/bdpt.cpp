@@ -0,0 +1,418 @@
+#include "bdpt.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "camera.h"
+#include "light.h"
+#include "material.h"
+#include "objects.h"
+#include "scene.h"
+#include "stats.h"
+
+namespace {
+
+// Diffuse BSDFs sample and evaluate the upper hemisphere of the shading frame. Mirror 'w' into
+// it when 'wo' lies below, so that surfaces reflect on the side they are seen from.
+Vec3 to_upper(const Vec3& wo, const Vec3& w) {
+    return wo.y() < 0.0 ? Vec3{w.x(), -w.y(), w.z()} : w;
+}
+
+/// Solid angle density at 'from' to area density at 'to', 'to_normal' null for the camera
+double to_area(double pdf, const Vec3& from, const Vec3& to, const Vec3* to_normal) {
+    auto d       = to - from;
+    double dist2 = dot(d, d);
+    if (dist2 == 0.0) {
+        return 0.0;
+    }
+    if (to_normal) {
+        pdf *= absdot(*to_normal, d / std::sqrt(dist2));
+    }
+    return pdf / dist2;
+}
+
+double remap0(double x) {
+    return x != 0.0 ? x : 1.0;
+}
+
+}  // namespace
+
+void BidirectionalPathTracer::begin_render(const Camera& camera) {
+    this->camera = &camera;
+    splats       = SplatImage{output.get_width(), output.get_height()};
+    light_paths  = 0;
+}
+
+void BidirectionalPathTracer::add_splats(Buffer2D<RgbColor>& radiance) const {
+    if (light_paths == 0) {
+        return;
+    }
+
+    // Every light path estimates the whole image, see Camera::direction_pdf
+    int w{output.get_width()};
+    int h{output.get_height()};
+    double scale      = static_cast<double>(w) * h / static_cast<double>(light_paths);
+    const auto& tile = get_film().get_window();
+    for (int y{tile.y0}; y < tile.y1; ++y) {
+        for (int x{tile.x0}; x < tile.x1; ++x) {
+            radiance.at(x - tile.x0, y - tile.y0) += splats.get(x, y) * scale;
+        }
+    }
+}
+
+void BidirectionalPathTracer::splat(const Vec3& p, const RgbColor& value) const {
+    auto uv = camera->project(p);
+    if (!uv) {
+        return;
+    }
+    int w{output.get_width()};
+    int h{output.get_height()};
+    int x = std::min(static_cast<int>(uv->first * w), w - 1);
+    int y = h - 1 - std::min(static_cast<int>(uv->second * h), h - 1);
+    splats.add(x, y, value);
+}
+
+RgbColor BidirectionalPathTracer::compute_radiance(const Ray& ray,
+                                                   const PixelEstimate&,
+                                                   SampleRecord* record) const {
+    thread_local std::vector<Vertex> camera_path;
+    thread_local std::vector<Vertex> light_path;
+
+    Vertex eye;
+    eye.kind    = Vertex::Kind::camera;
+    eye.p       = ray.o;
+    eye.pdf_fwd = 1.0;
+    camera_path.assign(1, eye);
+    auto d = normalized(ray.d);
+    random_walk({ray.o, d}, Color::white, camera->direction_pdf(d), false, camera_path);
+    thread_stats().record_path_length(camera_path.size() - 1);
+
+    trace_light_path(light_path);
+    ++light_paths;
+
+    RgbColor direct   = Color::black;
+    RgbColor indirect = Color::black;
+    for (size_t t{1}; t <= camera_path.size(); ++t) {
+        for (size_t s{}; s <= light_path.size(); ++s) {
+            // Lights the camera sees directly are left to s = 0, like in pbrt, the weights
+            // assume so
+            if (t == 1 && s <= 1) {
+                continue;
+            }
+            auto depth = s + t - 2;
+            if (depth > max_depth) {
+                continue;
+            }
+
+            Vertex sampled;
+            auto value = connect(light_path, camera_path, s, t, sampled);
+            if (is_nearly_black(value)) {
+                continue;
+            }
+            value = value * mis_weight(light_path, camera_path, sampled, s, t);
+            if (t == 1) {
+                splat(light_path[s - 1].p, value);
+            } else if (depth <= 1) {
+                direct += value;
+            } else {
+                indirect += value;
+            }
+        }
+    }
+
+    if (record) {
+        if (auto rec = scene->hit(ray); rec.has_value()) {
+            record->normal    = rec->frame.normal;
+            record->depth     = rec->t * ray.d.norm();
+            record->object_id = static_cast<int>(rec->scene_index);
+            if (rec->is_light()) {
+                record->albedo = rec->get_light()->get_base_color();
+            } else {
+                auto material    = rec->get_geometry()->get_material();
+                record->albedo   = material->get_albedo(rec->uv);
+                record->material = material.get();
+            }
+        }
+        record->direct   = direct;
+        record->indirect = indirect;
+    }
+
+    return direct + indirect;
+}
+
+void BidirectionalPathTracer::trace_light_path(std::vector<Vertex>& path) const {
+    path.clear();
+    if (scene->light_count() == 0) {
+        return;
+    }
+
+    auto light  = get_random_light(*scene);
+    auto sample = light->sample_emission();
+
+    Vertex origin;
+    origin.kind    = Vertex::Kind::light;
+    origin.p       = sample.p;
+    origin.n       = sample.normal;
+    origin.light   = light.get();
+    origin.pdf_fwd = sample.pdf_area / static_cast<double>(scene->light_count());
+    origin.beta    = Color::white / origin.pdf_fwd;
+    path.push_back(origin);
+
+    auto beta = origin.beta * light->compute_emitted_radiance(sample.p, sample.direction) *
+                (absdot(sample.normal, sample.direction) / sample.pdf_direction);
+    random_walk({sample.p, sample.direction}, beta, sample.pdf_direction, true, path);
+}
+
+void BidirectionalPathTracer::random_walk(
+    Ray ray, RgbColor beta, double pdf, bool light_path, std::vector<Vertex>& path) const {
+    size_t max_vertices = max_depth + (light_path ? 1 : 2);
+    while (path.size() < max_vertices) {
+        auto rec = scene->hit(ray);
+        if (!rec.has_value()) {
+            return;
+        }
+
+        Vertex v;
+        v.p       = rec->p;
+        v.n       = rec->frame.normal;
+        v.wo      = normalized(rec->incident);
+        v.frame   = rec->frame;
+        v.beta    = beta;
+        v.pdf_fwd = to_area(pdf, path.back().p, v.p, &v.n);
+        if (rec->is_light()) {
+            // Lights absorb, camera paths end on them to gather their emission
+            if (!light_path) {
+                v.kind  = Vertex::Kind::light;
+                v.light = rec->get_light().get();
+                path.push_back(v);
+            }
+            return;
+        }
+
+        auto material = rec->get_geometry()->get_material();
+        v.bsdf        = material->compute_bsdf(rec->uv);
+        v.delta       = v.bsdf->type() == BsdfType::specular;
+        ++thread_stats().bsdf_samples[material.get()];
+
+        const auto& [world_to_shading, shading_to_world] = shading_transforms(rec->frame);
+        auto shading_wo = world_to_shading.on_vec(v.wo).normalized();
+        auto upper_wo   = v.delta ? shading_wo : to_upper(shading_wo, shading_wo);
+        auto sample     = v.bsdf->sample(upper_wo);
+        path.push_back(v);
+        if (!sample.has_value()) {
+            return;
+        }
+
+        // Specular vertices take no part in connections, their densities stay zero
+        auto shading_wi = normalized(sample->shading_wi);
+        double pdf_rev{};
+        if (!v.delta) {
+            pdf_rev    = v.bsdf->pdf(shading_wi, upper_wo);
+            shading_wi = to_upper(shading_wo, shading_wi);
+        }
+        beta = beta * sample->bsdf_value * (absdot(shading_wi, {0, 1, 0}) / sample->pdf_value);
+        pdf  = v.delta ? 0.0 : sample->pdf_value;
+
+        auto& prev   = path[path.size() - 2];
+        auto prev_n  = prev.kind == Vertex::Kind::camera ? nullptr : &prev.n;
+        prev.pdf_rev = to_area(pdf_rev, v.p, prev.p, prev_n);
+        if (is_nearly_black(beta)) {
+            return;
+        }
+        ray = {v.p, shading_to_world.on_vec(shading_wi).normalized()};
+    }
+}
+
+RgbColor BidirectionalPathTracer::connect(const std::vector<Vertex>& light_path,
+                                          const std::vector<Vertex>& camera_path,
+                                          size_t s,
+                                          size_t t,
+                                          Vertex& sampled) const {
+    const auto& pt = camera_path[t - 1];
+
+    // The camera path found a light on its own
+    if (s == 0) {
+        if (pt.kind != Vertex::Kind::light) {
+            return Color::black;
+        }
+        return pt.beta * pt.light->compute_emitted_radiance(pt.p, pt.wo);
+    }
+
+    // Light tracing, the result lands on the pixel the light vertex projects to
+    if (t == 1) {
+        const auto& qs = light_path[s - 1];
+        if (qs.delta) {
+            return Color::black;
+        }
+        auto d         = pt.p - qs.p;
+        double dist2   = dot(d, d);
+        auto wi        = normalized(d);
+        double pdf_dir = camera->direction_pdf(-wi);
+        if (pdf_dir == 0.0 || !scene->mutually_visible(qs.p, pt.p)) {
+            return Color::black;
+        }
+        // The importance of the pinhole is its direction density
+        return qs.beta * evaluate(qs, wi) * (pdf_dir * absdot(qs.n, wi) / dist2);
+    }
+
+    if (pt.delta || pt.kind == Vertex::Kind::light) {
+        return Color::black;
+    }
+
+    // Next event estimation, a fresh point on a light sampled as the light sees fit for 'pt'
+    if (s == 1) {
+        auto light  = get_random_light(*scene);
+        auto sample = light->sample_from(pt.p);
+        if (sample.pdf_value == 0.0) {
+            return Color::black;
+        }
+        sampled.kind    = Vertex::Kind::light;
+        sampled.p       = sample.p;
+        sampled.n       = sample.normal.normalized();
+        sampled.light   = light.get();
+        sampled.pdf_fwd = sample.pdf_value / static_cast<double>(scene->light_count());
+        sampled.beta    = Color::white / sampled.pdf_fwd;
+    }
+
+    const auto& qs = s == 1 ? sampled : light_path[s - 1];
+    if (qs.delta) {
+        return Color::black;
+    }
+    auto d       = pt.p - qs.p;
+    double dist2 = dot(d, d);
+    auto wi      = normalized(d);
+    auto value   = qs.beta * evaluate(qs, wi) * evaluate(pt, -wi) * pt.beta;
+    if (is_nearly_black(value) || !scene->mutually_visible(qs.p, pt.p)) {
+        return Color::black;
+    }
+    return value * (absdot(qs.n, wi) * absdot(pt.n, wi) / dist2);
+}
+
+double BidirectionalPathTracer::mis_weight(const std::vector<Vertex>& light_path,
+                                           const std::vector<Vertex>& camera_path,
+                                           const Vertex& sampled,
+                                           size_t s,
+                                           size_t t) const {
+    if (s + t == 2) {
+        return 1.0;
+    }
+
+    // Densities of the vertices when sampled from either end, with the connection in place
+    struct Densities {
+        double from_light;
+        double from_camera;
+        bool delta;
+    };
+    thread_local std::vector<Densities> lights;
+    thread_local std::vector<Densities> cameras;
+    lights.clear();
+    cameras.clear();
+
+    const Vertex* qs       = s == 0 ? nullptr : (s == 1 && t > 1 ? &sampled : &light_path[s - 1]);
+    const Vertex* qs_minus = s > 1 ? &light_path[s - 2] : nullptr;
+    const Vertex& pt       = camera_path[t - 1];
+    const Vertex* pt_minus = t > 1 ? &camera_path[t - 2] : nullptr;
+
+    for (size_t i{}; i < s; ++i) {
+        const auto& v = i == s - 1 ? *qs : light_path[i];
+        lights.push_back({v.pdf_fwd, v.pdf_rev, v.delta});
+    }
+    for (size_t i{}; i < t; ++i) {
+        const auto& v = camera_path[i];
+        cameras.push_back({v.pdf_rev, v.pdf_fwd, v.delta});
+    }
+
+    // The light end x0 has two densities. Next event estimation (s == 1) samples it from x1 the
+    // way the light sees fit, the longer light paths start there with the emission density.
+    const Vertex& x0  = s == 0 ? pt : (s == 1 ? *qs : light_path[0]);
+    const Vertex* x1  = s == 0 ? pt_minus : (s == 1 ? &pt : &light_path[1]);
+    double origin_pdf = x0.light ? light_pdf(x0) : 0.0;
+    double nee_pdf    = x0.light && x1 ? light_pdf_from(x0, *x1) : origin_pdf;
+    if (s > 0) {
+        lights[0].from_light = nee_pdf;
+    }
+
+    cameras[t - 1].from_light = qs ? pdf(*qs, qs_minus, pt) : nee_pdf;
+    cameras[t - 1].delta      = false;
+    if (pt_minus) {
+        cameras[t - 2].from_light = qs ? pdf(pt, qs, *pt_minus) : pdf(pt, nullptr, *pt_minus);
+    }
+    if (qs) {
+        lights[s - 1].from_camera = pdf(pt, pt_minus, *qs);
+        lights[s - 1].delta       = false;
+    }
+    if (qs_minus) {
+        lights[s - 2].from_camera = pdf(*qs, &pt, *qs_minus);
+    }
+
+    // Ratios of the densities of the other strategies for the same path to this one
+    double sum{};
+    double ratio{1.0};
+    for (size_t i{t - 1}; i > 0; --i) {
+        ratio *= remap0(cameras[i].from_light) / remap0(cameras[i].from_camera);
+        if (s + t - i == 2) {
+            ratio *= remap0(origin_pdf) / remap0(nee_pdf);
+        }
+        if (!cameras[i].delta && !cameras[i - 1].delta) {
+            sum += ratio;
+        }
+    }
+    ratio = 1.0;
+    for (size_t i{s}; i-- > 0;) {
+        ratio *= remap0(lights[i].from_camera) / remap0(lights[i].from_light);
+        if (i == 1) {
+            ratio *= remap0(nee_pdf) / remap0(origin_pdf);
+        }
+        bool previous_delta = i > 0 && lights[i - 1].delta;
+        if (!lights[i].delta && !previous_delta) {
+            sum += ratio;
+        }
+    }
+    return 1.0 / (1.0 + sum);
+}
+
+RgbColor BidirectionalPathTracer::evaluate(const Vertex& v, const Vec3& wi) const {
+    if (v.kind == Vertex::Kind::light) {
+        return v.light->compute_emitted_radiance(v.p, wi);
+    }
+    if (v.kind == Vertex::Kind::camera || v.delta) {
+        return Color::black;
+    }
+
+    const auto& [world_to_shading, shading_to_world] = shading_transforms(v.frame);
+    auto shading_wo = world_to_shading.on_vec(v.wo).normalized();
+    auto shading_wi = world_to_shading.on_vec(wi).normalized();
+    if (shading_wo.y() * shading_wi.y() <= 0.0) {
+        return Color::black;
+    }
+    return v.bsdf->evaluate(to_upper(shading_wo, shading_wo), to_upper(shading_wo, shading_wi));
+}
+
+double BidirectionalPathTracer::pdf(const Vertex& v, const Vertex* prev, const Vertex& next) const {
+    auto wi = normalized(next.p - v.p);
+    double density{};
+    if (v.kind == Vertex::Kind::camera) {
+        density = camera->direction_pdf(wi);
+    } else if (v.kind == Vertex::Kind::light) {
+        density = v.light->emission_pdf(v.n, wi);
+    } else if (!v.delta) {
+        const auto& [world_to_shading, shading_to_world] = shading_transforms(v.frame);
+        auto wo         = prev ? normalized(prev->p - v.p) : v.wo;
+        auto shading_wo = world_to_shading.on_vec(wo).normalized();
+        auto shading_wi = world_to_shading.on_vec(wi).normalized();
+        if (shading_wo.y() * shading_wi.y() > 0.0) {
+            density = v.bsdf->pdf(to_upper(shading_wo, shading_wo),
+                                  to_upper(shading_wo, shading_wi));
+        }
+    }
+    return to_area(density, v.p, next.p, next.kind == Vertex::Kind::camera ? nullptr : &next.n);
+}
+
+double BidirectionalPathTracer::light_pdf(const Vertex& v) const {
+    double area = v.light->get_transformed_shape().compute_area();
+    return 1.0 / (area * static_cast<double>(scene->light_count()));
+}
+
+double BidirectionalPathTracer::light_pdf_from(const Vertex& v, const Vertex& ref) const {
+    return v.light->pdf_from(ref.p, v.p) / static_cast<double>(scene->light_count());
+}
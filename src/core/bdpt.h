@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bxdf.h"
+#include "film.h"
+#include "intersection.h"
+#include "renderer.h"
+
+// Bidirectional path tracer (Veach 1997), following the formulation of pbrt-v3. Every camera
+// sample traces a camera subpath and a light subpath, connects each pair of their vertices and
+// weights every strategy by the balance heuristic. Connections of light vertices to the camera
+// land on other pixels, so they are splatted into an image of their own and
+// added to the film radiance when the render resolves.
+//
+// Diffuse surfaces reflect on the side they are seen from, and the light paths only store
+// vertices on surfaces, lights end them.
+class BidirectionalPathTracer : public RayTracer {
+  public:
+    BidirectionalPathTracer(int w,
+                            int h,
+                            std::shared_ptr<PixelSampler> pixel_sampler,
+                            size_t samples_per_pixel)
+        : RayTracer{w, h, std::move(pixel_sampler), samples_per_pixel} {}
+
+    /// Longest path in bounces, counting neither the camera nor the light vertex
+    void set_max_depth(size_t depth) { max_depth = depth; }
+
+    RgbColor compute_radiance(const Ray& ray,
+                              const PixelEstimate& estimate,
+                              SampleRecord* record) const override;
+
+  private:
+    struct Vertex {
+        enum class Kind : unsigned char { camera, light, surface };
+
+        Kind kind{Kind::surface};
+        Vec3 p;
+        Vec3 n;   // geometric normal of lights and surfaces
+        Vec3 wo;  // towards the previous vertex of the subpath
+        ShadingFrame frame;
+        RgbColor beta{Color::white};  // subpath throughput up to and excluding this vertex
+        std::shared_ptr<Bsdf> bsdf;
+        const Light* light{};
+        bool delta{};
+        double pdf_fwd{};  // area density of this vertex when sampled along its own subpath
+        double pdf_rev{};  // the same when sampled from the other end of the path
+    };
+
+    void begin_render(const Camera& camera) override;
+
+    void add_splats(Buffer2D<RgbColor>& radiance) const override;
+
+    /// @brief Extend 'path' from its last vertex along 'ray', which was sampled with solid angle
+    /// density 'pdf'. Light paths end before lights, camera paths on them.
+    void random_walk(
+        Ray ray, RgbColor beta, double pdf, bool light_path, std::vector<Vertex>& path) const;
+
+    void trace_light_path(std::vector<Vertex>& path) const;
+
+    /// Unweighted contribution of the strategy with 's' light and 't' camera vertices
+    RgbColor connect(const std::vector<Vertex>& light_path,
+                     const std::vector<Vertex>& camera_path,
+                     size_t s,
+                     size_t t,
+                     Vertex& sampled) const;
+
+    /// Balance heuristic weight of the strategy, 'sampled' replaces the light vertex if s is 1
+    double mis_weight(const std::vector<Vertex>& light_path,
+                      const std::vector<Vertex>& camera_path,
+                      const Vertex& sampled,
+                      size_t s,
+                      size_t t) const;
+
+    /// Scattering at 'v' from its wo towards 'wi', Le for light vertices
+    RgbColor evaluate(const Vertex& v, const Vec3& wi) const;
+
+    /// @brief Area density at 'next' of sampling it from 'v'. The scattering at 'v' comes from
+    /// 'prev', or from v.wo if 'prev' is null.
+    double pdf(const Vertex& v, const Vertex* prev, const Vertex& next) const;
+
+    /// Area density of 'v' as the origin of a light path
+    double light_pdf(const Vertex& v) const;
+
+    /// Area density of 'v' when next event estimation at 'ref' samples the lights
+    double light_pdf_from(const Vertex& v, const Vertex& ref) const;
+
+    /// Add 'value' to the splat image at the pixel 'p' projects to
+    void splat(const Vec3& p, const RgbColor& value) const;
+
+    size_t max_depth{8};
+    const Camera* camera{};
+
+    mutable SplatImage splats;  // light tracing over the full output
+    mutable std::atomic<uint64_t> light_paths{};
+};
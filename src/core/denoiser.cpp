@@ -0,0 +1,168 @@
+#include "denoiser.h"
+
+#include <cmath>
+
+#include "profiler.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace {
+
+constexpr double albedo_epsilon{1.0e-3};
+
+// B3 spline, the a-trous scaling function
+constexpr double kernel[5] = {1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4, 1.0 / 16};
+
+RgbColor demodulate(const RgbColor& radiance, const RgbColor& albedo) {
+    auto safe = [](double a) { return a < albedo_epsilon ? 1.0 : a; };
+    return {radiance.r() / safe(albedo.r()),
+            radiance.g() / safe(albedo.g()),
+            radiance.b() / safe(albedo.b())};
+}
+
+RgbColor remodulate(const RgbColor& irradiance, const RgbColor& albedo) {
+    auto safe = [](double a) { return a < albedo_epsilon ? 1.0 : a; };
+    return {irradiance.r() * safe(albedo.r()),
+            irradiance.g() * safe(albedo.g()),
+            irradiance.b() * safe(albedo.b())};
+}
+
+double squared_distance(const RgbColor& a, const RgbColor& b) {
+    double dr = a.r() - b.r();
+    double dg = a.g() - b.g();
+    double db = a.b() - b.b();
+    return dr * dr + dg * dg + db * db;
+}
+
+// 3x3 Gaussian blurred variance. A pixel whose few samples happen to agree would otherwise reject
+// every neighbor and stay as a speckle.
+double prefiltered_variance(const Buffer2D<double>& variance, int x, int y) {
+    constexpr double gaussian[2] = {0.25, 0.125};
+
+    int w = variance.get_width();
+    int h = variance.get_height();
+
+    double sum{};
+    double sum_weight{};
+    for (int dy{-1}; dy <= 1; ++dy) {
+        for (int dx{-1}; dx <= 1; ++dx) {
+            int qx = x + dx;
+            int qy = y + dy;
+            if (qx < 0 || qx >= w || qy < 0 || qy >= h) {
+                continue;
+            }
+            double weight = gaussian[std::abs(dx)] * gaussian[std::abs(dy)];
+            sum += weight * variance.at(qx, qy);
+            sum_weight += weight;
+        }
+    }
+    return sum / sum_weight;
+}
+
+struct Level {
+    Buffer2D<RgbColor> color;
+    Buffer2D<double> variance;
+};
+
+void filter_pass(const Level& in,
+                 Level& out,
+                 const FeatureBuffers& features,
+                 const DenoiseOptions& options,
+                 int step) {
+    int w = in.color.get_width();
+    int h = in.color.get_height();
+
+    ThreadPool::global().parallel_for(0, h, [&](size_t row) {
+        int y = static_cast<int>(row);
+        for (int x{}; x < w; ++x) {
+            const auto& c_p = in.color.at(x, y);
+            const auto& n_p = features.normal.at(x, y);
+            const auto& a_p = features.albedo.at(x, y);
+            double z_p      = features.depth.at(x, y);
+            double l_p      = luminance(c_p);
+            double sigma_l  = options.sigma_luminance * std::sqrt(prefiltered_variance(in.variance, x, y)) +
+                             1.0e-6;
+
+            RgbColor sum_color = Color::black;
+            double sum_weight{};
+            double sum_variance{};
+
+            for (int dy{-2}; dy <= 2; ++dy) {
+                int qy = y + dy * step;
+                if (qy < 0 || qy >= h) {
+                    continue;
+                }
+                for (int dx{-2}; dx <= 2; ++dx) {
+                    int qx = x + dx * step;
+                    if (qx < 0 || qx >= w) {
+                        continue;
+                    }
+
+                    const auto& c_q = in.color.at(qx, qy);
+                    const auto& n_q = features.normal.at(qx, qy);
+
+                    // Pixels where the camera ray escaped have a zero normal
+                    double cos_n = dot(n_p, n_q);
+                    if (n_p == Vec3::zero() && n_q == Vec3::zero()) {
+                        cos_n = 1.0;
+                    }
+
+                    double z_q = features.depth.at(qx, qy);
+                    double dz  = std::abs(z_p - z_q) / (options.sigma_depth * std::max(z_p, 1.0e-3));
+
+                    double w_l = std::abs(l_p - luminance(c_q)) / sigma_l;
+                    double w_n = std::max(0.0, 1.0 - cos_n) / options.sigma_normal;
+                    double w_a = squared_distance(a_p, features.albedo.at(qx, qy)) /
+                                 (options.sigma_albedo * options.sigma_albedo);
+
+                    double weight = kernel[dx + 2] * kernel[dy + 2] * std::exp(-(w_l + w_n + dz + w_a));
+
+                    sum_color += weight * c_q;
+                    sum_weight += weight;
+                    sum_variance += weight * weight * in.variance.at(qx, qy);
+                }
+            }
+
+            // The center pixel always has a positive weight
+            out.color.at(x, y)    = sum_color / sum_weight;
+            out.variance.at(x, y) = sum_variance / (sum_weight * sum_weight);
+        }
+    });
+}
+
+}  // namespace
+
+Buffer2D<RgbColor> denoise(const Buffer2D<RgbColor>& radiance,
+                           const FeatureBuffers& features,
+                           const DenoiseOptions& options) {
+    PROFILE_ZONE("denoise");
+    int w = radiance.get_width();
+    int h = radiance.get_height();
+
+    Level current{Buffer2D<RgbColor>{w, h}, Buffer2D<double>{w, h}};
+    Level next{Buffer2D<RgbColor>{w, h}, Buffer2D<double>{w, h}};
+
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            const auto& albedo = features.albedo.at(x, y);
+            current.color.at(x, y) = demodulate(radiance.at(x, y), albedo);
+
+            // Luminance variance scales with the square of the divisor
+            double l_albedo           = std::max(luminance(albedo), albedo_epsilon);
+            current.variance.at(x, y) = features.variance.at(x, y) / (l_albedo * l_albedo);
+        }
+    }
+
+    for (int i{}; i < options.iterations; ++i) {
+        filter_pass(current, next, features, options, 1 << i);
+        std::swap(current, next);
+    }
+
+    Buffer2D<RgbColor> res{w, h};
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            res.at(x, y) = remodulate(current.color.at(x, y), features.albedo.at(x, y));
+        }
+    }
+    return res;
+}
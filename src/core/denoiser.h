@@ -0,0 +1,62 @@
+#pragma once
+
+#include <utility>
+
+#include "buffer2d.h"
+#include "color.h"
+#include "vec.h"
+
+// Per-pixel guides written by the renderer, averaged over the samples of each pixel
+struct FeatureBuffers {
+    FeatureBuffers() = default;
+
+    FeatureBuffers(int w, int h)
+        : albedo{w, h},
+          normal{w, h, Vec3::zero()},
+          depth{w, h, 0.0},
+          variance{w, h, 0.0} {}
+
+    FeatureBuffers(Buffer2D<RgbColor> albedo,
+                   Buffer2D<Vec3> normal,
+                   Buffer2D<double> depth,
+                   Buffer2D<double> variance)
+        : albedo{std::move(albedo)},
+          normal{std::move(normal)},
+          depth{std::move(depth)},
+          variance{std::move(variance)} {}
+
+    /// Albedo of the first surface hit
+    Buffer2D<RgbColor> albedo;
+
+    /// World space normal of the first surface hit, zero where the camera ray escapes
+    Buffer2D<Vec3> normal;
+
+    /// Distance from the camera to the first surface hit, zero where the camera ray escapes
+    Buffer2D<double> depth;
+
+    /// Variance of the pixel estimate's luminance
+    Buffer2D<double> variance;
+};
+
+struct DenoiseOptions {
+    /// Number of a-trous passes, pass i uses a 5x5 kernel with holes of 2^i pixels
+    int iterations{5};
+
+    /// Luminance edge stopping in units of the local standard deviation
+    double sigma_luminance{4.0};
+
+    double sigma_normal{0.1};
+
+    /// Relative depth difference
+    double sigma_depth{0.1};
+
+    double sigma_albedo{0.1};
+};
+
+/// @brief Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) with variance guided
+/// luminance weights as in SVGF (Schied et al. 2017). Radiance is divided by albedo before
+/// filtering and multiplied back afterwards, so texture and color edges are kept sharp. Rows are
+/// filtered in parallel on the global thread pool.
+Buffer2D<RgbColor> denoise(const Buffer2D<RgbColor>& radiance,
+                           const FeatureBuffers& features,
+                           const DenoiseOptions& options = {});
@@ -0,0 +1,302 @@
+#include "film.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "profiler.h"
+
+namespace {
+
+constexpr char film_magic[8] = {'V', '3', 'F', 'I', 'L', 'M', '\0', '\0'};
+constexpr uint32_t film_version{1};
+constexpr uint32_t endian_tag{0x01020304};
+
+struct FilmHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    int32_t full_width;
+    int32_t full_height;
+    int32_t window[4];
+    uint32_t aovs;
+    uint32_t padding;
+};
+
+bool contains(const ImageTile& outer, const ImageTile& inner) {
+    return inner.x0 >= outer.x0 && inner.y0 >= outer.y0 && inner.x1 <= outer.x1 &&
+           inner.y1 <= outer.y1;
+}
+
+template <typename T>
+void write_buffer(std::ostream& out, const Buffer2D<T>& buffer) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.write(reinterpret_cast<const char*>(buffer.data()),
+              static_cast<std::streamsize>(buffer.size() * sizeof(T)));
+}
+
+template <typename T>
+void read_buffer(std::istream& in, Buffer2D<T>& buffer) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    in.read(reinterpret_cast<char*>(buffer.data()),
+            static_cast<std::streamsize>(buffer.size() * sizeof(T)));
+}
+
+// Every buffer of a film in file order, the AOVs in the order of their flags
+template <typename FilmT, typename F>
+void for_each_buffer(FilmT& film, F&& visit) {
+    visit(film.radiance);
+    visit(film.luminance);
+    visit(film.luminance_sq);
+    visit(film.sample_count);
+
+    auto& aovs = film.aovs;
+    if (aovs.has(AovType::depth)) {
+        visit(aovs.depth);
+    }
+    if (aovs.has(AovType::normal)) {
+        visit(aovs.normal);
+    }
+    if (aovs.has(AovType::albedo)) {
+        visit(aovs.albedo);
+    }
+    if (aovs.has(AovType::object_id)) {
+        visit(aovs.object_id);
+    }
+    if (aovs.has(AovType::material_id)) {
+        visit(aovs.material_id);
+    }
+    if (aovs.has(AovType::direct)) {
+        visit(aovs.direct);
+    }
+    if (aovs.has(AovType::indirect)) {
+        visit(aovs.indirect);
+    }
+    // The sample_count AOV is resolved from the film's own counts
+}
+
+}  // namespace
+
+Film::Film(int w, int h, AovType aovs) : Film{w, h, {0, 0, w, h}, aovs} {}
+
+Film::Film(int full_w, int full_h, const ImageTile& window, AovType aovs)
+    : radiance{window.x1 - window.x0, window.y1 - window.y0},
+      luminance{window.x1 - window.x0, window.y1 - window.y0, 0.0},
+      luminance_sq{window.x1 - window.x0, window.y1 - window.y0, 0.0},
+      sample_count{window.x1 - window.x0, window.y1 - window.y0, 0.0},
+      aovs{window.x1 - window.x0, window.y1 - window.y0, aovs},
+      full_width{full_w},
+      full_height{full_h},
+      window{window} {
+    if (window.x0 >= window.x1 || window.y0 >= window.y1 ||
+        !contains({0, 0, full_w, full_h}, window)) {
+        throw std::runtime_error{"film window outside of the image"};
+    }
+}
+
+void Film::merge(const Film& part) {
+    if (part.full_width != full_width || part.full_height != full_height) {
+        throw std::runtime_error{"can't merge films of different image sizes"};
+    }
+    if (!contains(window, part.window)) {
+        throw std::runtime_error{"can't merge a film outside of the window"};
+    }
+    if (part.get_aovs() != get_aovs()) {
+        throw std::runtime_error{"can't merge films with different AOVs"};
+    }
+
+    int dx = part.window.x0 - window.x0;
+    int dy = part.window.y0 - window.y0;
+    for (int y{}; y < part.get_height(); ++y) {
+        for (int x{}; x < part.get_width(); ++x) {
+            // Ids come from the first film that sampled the pixel
+            if (sample_count.at(x + dx, y + dy) == 0.0) {
+                if (aovs.has(AovType::object_id)) {
+                    aovs.object_id.at(x + dx, y + dy) = part.aovs.object_id.at(x, y);
+                }
+                if (aovs.has(AovType::material_id)) {
+                    aovs.material_id.at(x + dx, y + dy) = part.aovs.material_id.at(x, y);
+                }
+            }
+
+            radiance.at(x + dx, y + dy) += part.radiance.at(x, y);
+            luminance.at(x + dx, y + dy) += part.luminance.at(x, y);
+            luminance_sq.at(x + dx, y + dy) += part.luminance_sq.at(x, y);
+            sample_count.at(x + dx, y + dy) += part.sample_count.at(x, y);
+
+            if (aovs.has(AovType::depth)) {
+                aovs.depth.at(x + dx, y + dy) += part.aovs.depth.at(x, y);
+            }
+            if (aovs.has(AovType::normal)) {
+                aovs.normal.at(x + dx, y + dy) += part.aovs.normal.at(x, y);
+            }
+            if (aovs.has(AovType::albedo)) {
+                aovs.albedo.at(x + dx, y + dy) += part.aovs.albedo.at(x, y);
+            }
+            if (aovs.has(AovType::direct)) {
+                aovs.direct.at(x + dx, y + dy) += part.aovs.direct.at(x, y);
+            }
+            if (aovs.has(AovType::indirect)) {
+                aovs.indirect.at(x + dx, y + dy) += part.aovs.indirect.at(x, y);
+            }
+        }
+    }
+}
+
+void Film::save(const std::string& path) const {
+    PROFILE_ZONE("film_save");
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    write(file);
+    if (file.fail()) {
+        throw std::runtime_error{"failed to write film: " + path};
+    }
+}
+
+Film Film::load(const std::string& path) {
+    PROFILE_ZONE("film_load");
+    std::ifstream file{path, std::ios::binary};
+    if (file.fail()) {
+        throw std::runtime_error{"can't open film: " + path};
+    }
+
+    try {
+        return read(file);
+    } catch (const std::exception& e) {
+        throw std::runtime_error{path + ": " + e.what()};
+    }
+}
+
+void Film::write(std::ostream& out) const {
+    FilmHeader header{};
+    std::memcpy(header.magic, film_magic, sizeof(film_magic));
+    header.version     = film_version;
+    header.endian      = endian_tag;
+    header.full_width  = full_width;
+    header.full_height = full_height;
+    header.window[0]   = window.x0;
+    header.window[1]   = window.y0;
+    header.window[2]   = window.x1;
+    header.window[3]   = window.y1;
+    header.aovs        = static_cast<uint32_t>(get_aovs());
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for_each_buffer(*this, [&](const auto& buffer) { write_buffer(out, buffer); });
+}
+
+Film Film::read(std::istream& in) {
+    FilmHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (in.fail() || std::memcmp(header.magic, film_magic, sizeof(film_magic)) != 0 ||
+        header.version != film_version || header.endian != endian_tag) {
+        throw std::runtime_error{"not a film"};
+    }
+
+    ImageTile window{header.window[0], header.window[1], header.window[2], header.window[3]};
+    Film film{header.full_width, header.full_height, window, static_cast<AovType>(header.aovs)};
+    for_each_buffer(film, [&](auto& buffer) { read_buffer(in, buffer); });
+    if (in.fail()) {
+        throw std::runtime_error{"truncated film"};
+    }
+    return film;
+}
+
+Film merge_film_files(const std::vector<std::string>& paths) {
+    Film merged;
+    for (size_t i{}; i < paths.size(); ++i) {
+        auto part = Film::load(paths[i]);
+        if (i == 0) {
+            merged = Film{part.get_full_width(), part.get_full_height(), part.get_aovs()};
+        }
+        try {
+            merged.merge(part);
+        } catch (const std::exception& e) {
+            throw std::runtime_error{paths[i] + ": " + e.what()};
+        }
+    }
+    return merged;
+}
+
+void Film::resolve(Buffer2D<RgbColor>& radiance_out,
+                   AovBuffers& aovs_out,
+                   Buffer2D<double>* variance_out) const {
+    int w = get_width();
+    int h = get_height();
+
+    radiance_out = Buffer2D<RgbColor>{w, h};
+    aovs_out     = AovBuffers{w, h, aovs.get_enabled()};
+    if (variance_out) {
+        *variance_out = Buffer2D<double>{w, h, 0.0};
+    }
+
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            double n = sample_count.at(x, y);
+            if (aovs.has(AovType::sample_count)) {
+                aovs_out.sample_count.at(x, y) = n;
+            }
+            if (aovs.has(AovType::object_id)) {
+                aovs_out.object_id.at(x, y) = aovs.object_id.at(x, y);
+            }
+            if (aovs.has(AovType::material_id)) {
+                aovs_out.material_id.at(x, y) = aovs.material_id.at(x, y);
+            }
+            if (n == 0.0) {
+                continue;
+            }
+
+            radiance_out.at(x, y) = radiance.at(x, y) / n;
+
+            if (aovs.has(AovType::depth)) {
+                aovs_out.depth.at(x, y) = aovs.depth.at(x, y) / n;
+            }
+            if (aovs.has(AovType::normal)) {
+                const auto& normal = aovs.normal.at(x, y);
+                if (normal.norm() > 0.0) {
+                    aovs_out.normal.at(x, y) = normal.normalized();
+                }
+            }
+            if (aovs.has(AovType::albedo)) {
+                aovs_out.albedo.at(x, y) = aovs.albedo.at(x, y) / n;
+            }
+            if (aovs.has(AovType::direct)) {
+                aovs_out.direct.at(x, y) = aovs.direct.at(x, y) / n;
+            }
+            if (aovs.has(AovType::indirect)) {
+                aovs_out.indirect.at(x, y) = aovs.indirect.at(x, y) / n;
+            }
+
+            if (variance_out) {
+                // Variance of the mean, from the unbiased sample variance
+                double mean            = luminance.at(x, y) / n;
+                double sample_variance = n > 1 ? (luminance_sq.at(x, y) - n * mean * mean) / (n - 1)
+                                               : 0.0;
+                variance_out->at(x, y) = std::max(sample_variance, 0.0) / n;
+            }
+        }
+    }
+}
+
+SplatImage::SplatImage(int w, int h)
+    : width{w},
+      height{h},
+      sums{std::make_unique<std::atomic<double>[]>(3 * static_cast<size_t>(w) * h)} {}
+
+void SplatImage::add(int x, int y, const RgbColor& value) {
+    auto* sum = &sums[3 * (static_cast<size_t>(y) * width + x)];
+    double channels[]{value.r(), value.g(), value.b()};
+    for (int c{}; c < 3; ++c) {
+        double old = sum[c].load(std::memory_order_relaxed);
+        while (!sum[c].compare_exchange_weak(old, old + channels[c], std::memory_order_relaxed)) {
+        }
+    }
+}
+
+RgbColor SplatImage::get(int x, int y) const {
+    const auto* sum = &sums[3 * (static_cast<size_t>(y) * width + x)];
+    return {sum[0].load(), sum[1].load(), sum[2].load()};
+}
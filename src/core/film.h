@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aov.h"
+#include "buffer2d.h"
+#include "camera.h"
+#include "color.h"
+
+class Material;
+
+// Per-sample quantities besides radiance, filled by the integrator on request. Surface
+// attributes describe the first intersection and keep their defaults if the ray escapes.
+struct SampleRecord {
+    Vec3 normal{Vec3::zero()};
+    RgbColor albedo{Color::black};
+    double depth{};
+
+    int object_id{-1};
+    const Material* material{};
+
+    /// Split of the returned radiance: emission and direct lighting at the first hit vs the rest
+    RgbColor direct{Color::black};
+    RgbColor indirect{Color::black};
+};
+
+// Running per-pixel sums over every sample taken so far. Renders add to it pass by pass and
+// resolve() turns the sums into averages, so no finished sample is ever lost.
+//
+// A film may cover only a window of the full image. Buffers are indexed relative to the window
+// origin. Partial films of one image, rendered by tile or by sample range, are saved to disk and
+// merged by adding their sums.
+class Film {
+  public:
+    Film() = default;
+
+    /// Film covering the whole image
+    Film(int w, int h, AovType aovs);
+
+    /// Film covering 'window' of a 'full_w' x 'full_h' image
+    Film(int full_w, int full_h, const ImageTile& window, AovType aovs);
+
+    /// Size of the window
+    int get_width() const { return radiance.get_width(); }
+
+    int get_height() const { return radiance.get_height(); }
+
+    int get_full_width() const { return full_width; }
+
+    int get_full_height() const { return full_height; }
+
+    const ImageTile& get_window() const { return window; }
+
+    AovType get_aovs() const { return aovs.get_enabled(); }
+
+    /// @brief Add the sums of another film of the same image. Its window must lie inside this
+    /// window and it must carry the same AOVs. Throws std::runtime_error otherwise.
+    void merge(const Film& part);
+
+    /// @brief Write the sums as a binary float film. Throws std::runtime_error on failure.
+    void save(const std::string& path) const;
+
+    /// @brief Read a film written by save(). Throws std::runtime_error on malformed files.
+    static Film load(const std::string& path);
+
+    /// Same format as save(), for films sent over the network
+    void write(std::ostream& out) const;
+
+    /// @brief Read a film written by write(). Throws std::runtime_error on malformed input.
+    static Film read(std::istream& in);
+
+    /// @brief Average the sums: radiance and enabled AOVs, and if 'variance' is not null the
+    /// luminance variance of each pixel estimate. Pixels without samples resolve to zero.
+    void resolve(Buffer2D<RgbColor>& radiance_out,
+                 AovBuffers& aovs_out,
+                 Buffer2D<double>* variance_out) const;
+
+    Buffer2D<RgbColor> radiance;
+    Buffer2D<double> luminance;
+    Buffer2D<double> luminance_sq;
+    Buffer2D<double> sample_count;
+
+    /// Sums of the enabled AOVs, except ids which hold the value of the first sample
+    AovBuffers aovs;
+
+  private:
+    int full_width{};
+    int full_height{};
+    ImageTile window;
+};
+
+// Radiance that any thread adds to any pixel, for samples that don't belong to the pixel being
+// rendered, like light paths reaching the camera or the states of Markov chains
+class SplatImage {
+  public:
+    SplatImage() = default;
+
+    SplatImage(int w, int h);
+
+    int get_width() const { return width; }
+
+    int get_height() const { return height; }
+
+    /// Add 'value' to pixel (x, y), safe to call concurrently
+    void add(int x, int y, const RgbColor& value);
+
+    RgbColor get(int x, int y) const;
+
+  private:
+    int width{};
+    int height{};
+    std::unique_ptr<std::atomic<double>[]> sums;  // three channels per pixel
+};
+
+/// @brief Merge partial film files into one film of the full image, see Film::merge. Throws
+/// std::runtime_error if the parts don't belong to one image.
+Film merge_film_files(const std::vector<std::string>& paths);
@@ -0,0 +1,268 @@
+#include "guiding.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils.h"
+
+namespace {
+
+// Largest double below one, keeps rescaled coordinates inside their quadrant
+constexpr double one_minus_epsilon{0x1.fffffffffffffp-1};
+
+double to_unit(double x) {
+    return std::clamp(x, 0.0, one_minus_epsilon);
+}
+
+}  // namespace
+
+Vec2 direction_to_square(const Vec3& d) {
+    double phi = std::atan2(d.y(), d.x());
+    if (phi < 0.0) {
+        phi += 2 * pi;
+    }
+    return {to_unit(0.5 * (d.z() + 1.0)), to_unit(phi * inv_2pi)};
+}
+
+Vec3 square_to_direction(const Vec2& p) {
+    double z   = 2.0 * p.x() - 1.0;
+    double r   = std::sqrt(std::max(0.0, 1.0 - z * z));
+    double phi = 2 * pi * p.y();
+    return {r * std::cos(phi), r * std::sin(phi), z};
+}
+
+DirectionalQuadtree::Node::Node(const Node& other) : children{other.children} {
+    for (size_t i{}; i < 4; ++i) {
+        sums[i].store(other.sums[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+DirectionalQuadtree::Node& DirectionalQuadtree::Node::operator=(const Node& other) {
+    children = other.children;
+    for (size_t i{}; i < 4; ++i) {
+        sums[i].store(other.sums[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+DirectionalQuadtree::DirectionalQuadtree() : nodes(1) {}
+
+int DirectionalQuadtree::quadrant(Vec2& p) {
+    int x = p.x() >= 0.5 ? 1 : 0;
+    int y = p.y() >= 0.5 ? 1 : 0;
+    p     = {to_unit(2.0 * p.x() - x), to_unit(2.0 * p.y() - y)};
+    return x + 2 * y;
+}
+
+void DirectionalQuadtree::record(const Vec2& p, double value) {
+    if (!(value > 0.0) || !std::isfinite(value)) {
+        return;
+    }
+
+    Vec2 local{to_unit(p.x()), to_unit(p.y())};
+    uint32_t index{};
+    while (true) {
+        int q     = quadrant(local);
+        auto& sum = nodes[index].sums[q];
+        // Atomic add on a double
+        double old = sum.load(std::memory_order_relaxed);
+        while (!sum.compare_exchange_weak(old, old + value, std::memory_order_relaxed)) {
+        }
+        index = nodes[index].children[q];
+        if (index == 0) {
+            return;
+        }
+    }
+}
+
+double DirectionalQuadtree::total() const {
+    double res{};
+    for (const auto& sum : nodes[0].sums) {
+        res += sum.load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+Vec2 DirectionalQuadtree::sample(double u1, double u2) const {
+    u1 = to_unit(u1);
+    u2 = to_unit(u2);
+    Vec2 origin{0.0, 0.0};
+    double size{1.0};
+    uint32_t index{};
+    while (true) {
+        const auto& node = nodes[index];
+        std::array<double, 4> w;
+        for (size_t i{}; i < 4; ++i) {
+            w[i] = node.sums[i].load(std::memory_order_relaxed);
+        }
+        if (w[0] + w[1] + w[2] + w[3] <= 0.0) {
+            w = {1.0, 1.0, 1.0, 1.0};
+        }
+
+        // Pick the column by its marginal, then the quadrant within it, reusing the numbers
+        double left = (w[0] + w[2]) / (w[0] + w[1] + w[2] + w[3]);
+        int x{};
+        if (u1 < left) {
+            u1 = to_unit(u1 / left);
+        } else {
+            x  = 1;
+            u1 = to_unit((u1 - left) / (1.0 - left));
+        }
+        double bottom = w[x] / (w[x] + w[x + 2]);
+        int y{};
+        if (u2 < bottom) {
+            u2 = to_unit(u2 / bottom);
+        } else {
+            y  = 1;
+            u2 = to_unit((u2 - bottom) / (1.0 - bottom));
+        }
+
+        size *= 0.5;
+        origin = origin + Vec2{x * size, y * size};
+        index  = node.children[x + 2 * y];
+        if (index == 0) {
+            return {to_unit(origin.x() + u1 * size), to_unit(origin.y() + u2 * size)};
+        }
+    }
+}
+
+double DirectionalQuadtree::pdf(const Vec2& p) const {
+    Vec2 local{to_unit(p.x()), to_unit(p.y())};
+    double res{1.0};
+    uint32_t index{};
+    while (true) {
+        const auto& node = nodes[index];
+        double sum{};
+        for (const auto& s : node.sums) {
+            sum += s.load(std::memory_order_relaxed);
+        }
+        int q = quadrant(local);
+        if (sum > 0.0) {
+            // Probability of the quadrant over its quarter of the area
+            res *= 4.0 * node.sums[q].load(std::memory_order_relaxed) / sum;
+        }
+        index = node.children[q];
+        if (index == 0 || res == 0.0) {
+            return res;
+        }
+    }
+}
+
+DirectionalQuadtree DirectionalQuadtree::refined(double threshold, int max_depth) const {
+    DirectionalQuadtree res;
+    double sum = total();
+    if (sum <= 0.0) {
+        return res;
+    }
+
+    // A node of the new tree, the node of this tree covering the same square if there is one,
+    // and otherwise the value of the enclosing quadrant, spread evenly
+    struct Work {
+        uint32_t node;
+        uint32_t old;
+        bool has_old;
+        double share;
+        int depth;
+    };
+    std::vector<Work> stack{{0, 0, true, sum, 1}};
+    while (!stack.empty()) {
+        auto work = stack.back();
+        stack.pop_back();
+        for (size_t q{}; q < 4; ++q) {
+            double value = work.has_old ? nodes[work.old].sums[q].load(std::memory_order_relaxed)
+                                        : 0.25 * work.share;
+            if (value <= threshold * sum || work.depth >= max_depth) {
+                continue;
+            }
+
+            auto child = static_cast<uint32_t>(res.nodes.size());
+            res.nodes.emplace_back();
+            res.nodes[work.node].children[q] = child;
+
+            uint32_t old_child = work.has_old ? nodes[work.old].children[q] : 0;
+            stack.push_back({child, old_child, old_child != 0, value, work.depth + 1});
+        }
+    }
+    return res;
+}
+
+GuidingField::GuidingField(const Bounds3& scene_bounds) {
+    // A cube, so midpoint splits give regions of even proportions
+    auto center = scene_bounds.is_empty() ? Vec3{} : scene_bounds.centroid();
+    auto extent = scene_bounds.is_empty() ? Vec3{} : scene_bounds.extent();
+    double half = 0.5 * std::max({extent.x(), extent.y(), extent.z(), 1e-3}) * 1.001;
+    bounds.min  = center - Vec3::all(half);
+    bounds.max  = center + Vec3::all(half);
+
+    nodes.emplace_back();
+    regions.push_back(std::make_unique<Region>());
+}
+
+uint32_t GuidingField::locate(const Vec3& p) const {
+    auto extent = bounds.extent();
+    Vec3 local{to_unit((p.x() - bounds.min.x()) / extent.x()),
+               to_unit((p.y() - bounds.min.y()) / extent.y()),
+               to_unit((p.z() - bounds.min.z()) / extent.z())};
+
+    uint32_t index{};
+    while (nodes[index].children[0] != 0) {
+        const auto& node = nodes[index];
+        int axis         = node.axis;
+        int side         = local[axis] >= 0.5 ? 1 : 0;
+        local[axis]      = to_unit(2.0 * local[axis] - side);
+        index            = node.children[side];
+    }
+    return nodes[index].region;
+}
+
+void GuidingField::record(const Vec3& p, const Vec3& direction, double value) {
+    auto& region = *regions[locate(p)];
+    region.building.record(direction_to_square(direction), value);
+    region.samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+const DirectionalQuadtree* GuidingField::sampling_tree(const Vec3& p) const {
+    const auto& region = *regions[locate(p)];
+    return region.sampling.total() > 0.0 ? &region.sampling : nullptr;
+}
+
+void GuidingField::refine(size_t iteration) {
+    double threshold = split_factor * std::sqrt(std::pow(2.0, static_cast<double>(iteration)));
+
+    // Children are appended, so the loop also visits them
+    for (size_t i{}; i < nodes.size(); ++i) {
+        if (nodes[i].children[0] != 0) {
+            continue;
+        }
+        auto& parent_region = *regions[nodes[i].region];
+        auto samples        = parent_region.samples.load(std::memory_order_relaxed);
+        if (static_cast<double>(samples) <= threshold) {
+            continue;
+        }
+
+        // Both halves start from the directional distribution of the parent
+        parent_region.samples.store(samples / 2, std::memory_order_relaxed);
+        auto region      = std::make_unique<Region>();
+        region->building = parent_region.building;
+        region->samples.store(samples / 2, std::memory_order_relaxed);
+
+        Node left;
+        Node right;
+        left.axis    = (nodes[i].axis + 1) % 3;
+        right.axis   = left.axis;
+        left.region  = nodes[i].region;
+        right.region = static_cast<uint32_t>(regions.size());
+        regions.push_back(std::move(region));
+
+        nodes[i].children[0] = static_cast<uint32_t>(nodes.size());
+        nodes[i].children[1] = static_cast<uint32_t>(nodes.size() + 1);
+        nodes.push_back(left);
+        nodes.push_back(right);
+    }
+
+    for (auto& region : regions) {
+        region->sampling = region->building;
+        region->building = region->building.refined();
+        region->samples.store(0, std::memory_order_relaxed);
+    }
+}
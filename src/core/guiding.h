@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bounds.h"
+#include "vec.h"
+
+/// @brief Map a unit direction to the unit square by cylindrical coordinates (z, phi). The map
+/// preserves area up to 4 pi, so a density over the square divided by 4 pi is one over solid angle.
+Vec2 direction_to_square(const Vec3& d);
+
+Vec3 square_to_direction(const Vec2& p);
+
+// Quadtree over the unit square of directions holding the radiance recorded in each quadrant.
+// Sampling descends proportionally to the sums, so directions that brought in more light are
+// picked more often. Recording is thread safe, everything else must not overlap with it.
+class DirectionalQuadtree {
+  public:
+    /// A root split into four empty quadrants, which samples uniformly
+    DirectionalQuadtree();
+
+    /// Add 'value' to the quadrants containing 'p' at every level
+    void record(const Vec2& p, double value);
+
+    double total() const;
+
+    /// Point of the unit square drawn from the recorded distribution with two uniform numbers
+    Vec2 sample(double u1, double u2) const;
+
+    /// Density of sample() over the unit square
+    double pdf(const Vec2& p) const;
+
+    /// @brief Empty tree whose quadrants are split until none holds more than 'threshold' of the
+    /// total, up to 'max_depth' levels. Follows the recorded distribution, keeps the structure of
+    /// this tree where it had no data.
+    DirectionalQuadtree refined(double threshold = 0.01, int max_depth = 20) const;
+
+    size_t node_count() const { return nodes.size(); }
+
+  private:
+    struct Node {
+        std::array<std::atomic<double>, 4> sums{};
+        std::array<uint32_t, 4> children{};  // zero for leaf quadrants, the root is never a child
+
+        Node() = default;
+
+        Node(const Node& other);
+
+        Node& operator=(const Node& other);
+    };
+
+    // Quadrant of 'p' inside a node, and 'p' rescaled to the quadrant
+    static int quadrant(Vec2& p);
+
+    std::vector<Node> nodes;
+};
+
+// Spatial-directional radiance cache for path guiding, after "Practical Path Guiding for
+// Efficient Light-Transport Simulation" (Müller et al. 2017). A binary tree splits the scene
+// bounds at midpoints along cycling axes, and every region holds two directional quadtrees:
+// one that guides the current iteration and one that learns from it. refine() closes an
+// iteration by splitting regions that received many samples and swapping the trees.
+class GuidingField {
+  public:
+    explicit GuidingField(const Bounds3& bounds);
+
+    /// Record radiance 'value' arriving at 'p' from 'direction'. Thread safe.
+    void record(const Vec3& p, const Vec3& direction, double value);
+
+    /// Distribution to guide by at 'p', null while the region has learned nothing
+    const DirectionalQuadtree* sampling_tree(const Vec3& p) const;
+
+    /// @brief End training iteration 'iteration', counted from zero. Regions with more than
+    /// c * sqrt(2^iteration) samples are split, after which the learned trees guide the next
+    /// iteration and refined empty copies start learning.
+    void refine(size_t iteration);
+
+    size_t region_count() const { return regions.size(); }
+
+    static constexpr double split_factor{12000.0};  // c above
+
+  private:
+    struct Region {
+        DirectionalQuadtree sampling;
+        DirectionalQuadtree building;
+        std::atomic<uint64_t> samples{};
+    };
+
+    struct Node {
+        int axis{};
+        uint32_t children[2]{};  // zero for leaves, the root is never a child
+        uint32_t region{};
+    };
+
+    // Region containing 'p'
+    uint32_t locate(const Vec3& p) const;
+
+    Bounds3 bounds;
+    std::vector<Node> nodes;
+    std::vector<std::unique_ptr<Region>> regions;
+};
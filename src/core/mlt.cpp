@@ -0,0 +1,219 @@
+#include "mlt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "camera.h"
+#include "profiler.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace {
+
+// Random streams of the bootstrap paths and the chains, 'pixel' keys far above the camera pixels
+constexpr uint64_t bootstrap_stream{uint64_t{1} << 62};
+constexpr uint64_t chain_stream{bootstrap_stream + 1};
+
+// Bootstrap paths traced per pool task
+constexpr size_t bootstrap_chunk{1024};
+
+}  // namespace
+
+PrimarySample::PrimarySample(uint64_t initial, uint64_t mutations, const MltOptions& options)
+    : initial_key{initial},
+      mutation_key{mutations},
+      large_step_probability{options.large_step},
+      sigma{options.sigma} {}
+
+double PrimarySample::uniform() {
+    return RandomStream::value(mutation_key, mutation_dimension++);
+}
+
+double PrimarySample::normal() {
+    double u1 = uniform();
+    double u2 = uniform();
+    return std::sqrt(-2.0 * std::log(1.0 - u1)) * std::cos(2 * pi * u2);
+}
+
+double PrimarySample::value(uint64_t dimension) {
+    // Numbers read for the first time are fresh, as if redrawn by every step so far
+    if (dimension >= numbers.size()) {
+        auto first = numbers.size();
+        numbers.resize(dimension + 1);
+        for (auto i = first; i < numbers.size(); ++i) {
+            auto& x           = numbers[i];
+            x.value           = iteration == 0 ? RandomStream::value(initial_key, i) : uniform();
+            x.modified        = iteration;
+            x.backup          = x.value;
+            x.modified_backup = iteration;
+        }
+        return numbers[dimension].value;
+    }
+
+    auto& x = numbers[dimension];
+    if (x.modified == iteration) {
+        return x.value;
+    }
+    if (x.modified < last_large_step) {
+        x.value    = uniform();
+        x.modified = last_large_step;
+    }
+
+    x.backup          = x.value;
+    x.modified_backup = x.modified;
+    if (large_step) {
+        x.value = uniform();
+    } else {
+        // The small steps since the last change add up to one normal step
+        auto steps = static_cast<double>(iteration - x.modified);
+        x.value += normal() * sigma * std::sqrt(steps);
+        x.value -= std::floor(x.value);
+        x.value = std::min(x.value, 0x1.fffffffffffffp-1);
+    }
+    x.modified = iteration;
+    return x.value;
+}
+
+void PrimarySample::start_iteration() {
+    ++iteration;
+    large_step = uniform() < large_step_probability;
+}
+
+void PrimarySample::accept() {
+    if (large_step) {
+        last_large_step = iteration;
+    }
+}
+
+void PrimarySample::reject() {
+    for (auto& x : numbers) {
+        if (x.modified == iteration) {
+            x.value    = x.backup;
+            x.modified = x.modified_backup;
+        }
+    }
+    --iteration;
+}
+
+RgbColor MetropolisRenderer::evaluate(const Camera& camera,
+                                      PrimarySample& sample,
+                                      int& x,
+                                      int& y) const {
+    const auto& tile = get_film().get_window();
+    int w{tile.x1 - tile.x0};
+    int h{tile.y1 - tile.y0};
+
+    RandomStream::replay(sample);
+    double u = RandomStream::next() * w;
+    double v = RandomStream::next() * h;
+    x        = std::min(static_cast<int>(u), w - 1);
+    y        = std::min(static_cast<int>(v), h - 1);
+
+    auto [image_u, image_v] = camera.to_image_plane_uv(
+        output.get_width(), output.get_height(), tile.x0 + x, tile.y0 + y, u - x, v - y);
+    ++thread_stats().camera_rays;
+    auto radiance = compute_radiance(camera.generate_ray(image_u, image_v), {}, nullptr);
+    RandomStream::end_replay();
+    return radiance;
+}
+
+void MetropolisRenderer::begin_render(const Camera& camera) {
+    PROFILE_ZONE("mlt");
+    if (options.bootstrap == 0 || options.chains == 0) {
+        throw std::runtime_error{"MLT needs bootstrap paths and at least one chain"};
+    }
+
+    // There are no film passes, set up the photon map of the caustics mode here
+    PathTracer::begin_render(camera);
+    PathTracer::begin_pass();
+
+    const auto& tile = get_film().get_window();
+    splats           = SplatImage{tile.x1 - tile.x0, tile.y1 - tile.y0};
+    splat_scale      = 0.0;
+
+    // Bootstrap
+    std::vector<double> weights(options.bootstrap);
+    size_t chunks = (options.bootstrap + bootstrap_chunk - 1) / bootstrap_chunk;
+    ThreadPool::global().parallel_for(0, chunks, [&](size_t chunk) {
+        auto end = std::min(options.bootstrap, (chunk + 1) * bootstrap_chunk);
+        for (size_t i{chunk * bootstrap_chunk}; i < end; ++i) {
+            PrimarySample sample{RandomStream::key(get_seed(), bootstrap_stream, i), 0, options};
+            int x{};
+            int y{};
+            weights[i] = luminance(evaluate(camera, sample, x, y));
+        }
+    });
+
+    std::vector<double> cdf(weights.size());
+    double sum{};
+    for (size_t i{}; i < weights.size(); ++i) {
+        sum += weights[i];
+        cdf[i] = sum;
+    }
+    if (sum == 0.0) {
+        return;
+    }
+    double b = sum / static_cast<double>(weights.size());
+
+    auto mutations = static_cast<uint64_t>(tile.pixel_count()) * get_samples_per_pixel();
+    splat_scale    = b * tile.pixel_count() / static_cast<double>(mutations);
+
+    ThreadPool::global().parallel_for(0, options.chains, [&](size_t chain) {
+        PROFILE_ZONE("mlt_chain");
+        auto chain_key = RandomStream::key(get_seed(), chain_stream, chain);
+        auto pick      = RandomStream::value(chain_key, ~uint64_t{0}) * sum;
+        auto start     = std::upper_bound(cdf.begin(), cdf.end(), pick) - cdf.begin();
+        start          = std::min<ptrdiff_t>(start, static_cast<ptrdiff_t>(cdf.size()) - 1);
+
+        auto initial = RandomStream::key(get_seed(), bootstrap_stream, static_cast<size_t>(start));
+        PrimarySample sample{initial, chain_key, options};
+        int x{};
+        int y{};
+        auto current          = evaluate(camera, sample, x, y);
+        double current_weight = luminance(current);
+
+        auto count = mutations / options.chains + (chain < mutations % options.chains ? 1 : 0);
+        for (uint64_t i{}; i < count; ++i) {
+            sample.start_iteration();
+            int proposed_x{};
+            int proposed_y{};
+            auto proposed          = evaluate(camera, sample, proposed_x, proposed_y);
+            double proposed_weight = luminance(proposed);
+
+            // Both states share the visit by their probability, which saves the variance of
+            // the accept decision
+            double accept =
+                current_weight > 0.0 ? std::min(1.0, proposed_weight / current_weight) : 1.0;
+            if (accept > 0.0) {
+                splats.add(proposed_x, proposed_y, proposed * (accept / proposed_weight));
+            }
+            if (accept < 1.0 && current_weight > 0.0) {
+                splats.add(x, y, current * ((1.0 - accept) / current_weight));
+            }
+
+            if (sample.uniform() < accept) {
+                current        = proposed;
+                current_weight = proposed_weight;
+                x              = proposed_x;
+                y              = proposed_y;
+                sample.accept();
+            } else {
+                sample.reject();
+            }
+        }
+    });
+}
+
+void MetropolisRenderer::add_splats(Buffer2D<RgbColor>& radiance) const {
+    if (splat_scale == 0.0) {
+        return;
+    }
+    for (int y{}; y < radiance.get_height(); ++y) {
+        for (int x{}; x < radiance.get_width(); ++x) {
+            radiance.at(x, y) += splats.get(x, y) * splat_scale;
+        }
+    }
+}
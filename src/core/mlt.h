@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "film.h"
+#include "pathtracer.h"
+#include "rng.h"
+
+// How Metropolis light transport explores the image
+struct MltOptions {
+    size_t bootstrap{100000};  // independent paths that estimate the image brightness
+    size_t chains{256};        // Markov chains, each started from one of the bootstrap paths
+    double large_step{0.3};    // probability of proposing all new numbers
+    double sigma{0.01};        // standard deviation of the small steps of each number
+};
+
+// The random numbers of one Markov chain state. A large step redraws every number, a small
+// step moves each one by a normal offset, wrapping around [0, 1). Numbers are mutated when a
+// path first reads them in an iteration and catch up on the steps they missed, so a path can
+// read as many as it likes.
+class PrimarySample : public SampleSource {
+  public:
+    /// @brief Numbers of the first state from the stream with key 'initial', those of the
+    /// mutations and the chain's own decisions from the stream with key 'mutations'
+    PrimarySample(uint64_t initial, uint64_t mutations, const MltOptions& options);
+
+    double value(uint64_t dimension) override;
+
+    /// Start proposing a mutation of the current state
+    void start_iteration();
+
+    /// Make the proposal the current state
+    void accept();
+
+    /// Restore the numbers the proposal changed
+    void reject();
+
+    /// Uniform number in [0, 1) that no path reads
+    double uniform();
+
+  private:
+    struct Number {
+        double value{};
+        uint64_t modified{};  // iteration of the last change
+        double backup{};
+        uint64_t modified_backup{};
+    };
+
+    /// Standard normal number, by the Box-Muller transform
+    double normal();
+
+    std::vector<Number> numbers;
+    uint64_t initial_key;
+    uint64_t mutation_key;
+    uint64_t mutation_dimension{};
+    double large_step_probability;
+    double sigma;
+
+    uint64_t iteration{};
+    uint64_t last_large_step{};
+    bool large_step{true};
+};
+
+// Primary sample space Metropolis light transport (Kelemen et al. 2002), following pbrt-v3.
+// The path tracer draws every random number through RandomStream, so a path is a function of
+// the numbers it reads, the first two of which place it on the image. Markov chains mutate
+// those numbers and visit paths in proportion to their luminance, which finds the bright
+// narrow paths of caustics and indirect light again once they are found.
+//
+// A bootstrap of independent paths estimates the mean image luminance b, which scales the
+// chains' histogram of visits into radiance, and picks the start states of the chains by
+// their luminance. Each chain runs on one thread and splats its states into a shared image.
+// The render spends samples_per_pixel mutations per pixel of the crop window.
+//
+// All the work happens before the film passes, which are empty. The film, its AOVs and its
+// variance stay black, and time budgets and previews are not supported.
+class MetropolisRenderer : public PathTracer {
+  public:
+    MetropolisRenderer(int w,
+                       int h,
+                       std::shared_ptr<PixelSampler> pixel_sampler,
+                       size_t samples_per_pixel)
+        : PathTracer{w, h, std::move(pixel_sampler), samples_per_pixel} {}
+
+    void set_mlt_options(const MltOptions& options) { this->options = options; }
+
+  protected:
+    void begin_render(const Camera& camera) override;
+
+    std::vector<size_t> pass_schedule(size_t) const override { return {}; }
+
+    void add_splats(Buffer2D<RgbColor>& radiance) const override;
+
+  private:
+    /// Radiance of the path the numbers of 'sample' describe, and the film pixel it lands on
+    RgbColor evaluate(const Camera& camera, PrimarySample& sample, int& x, int& y) const;
+
+    MltOptions options;
+    SplatImage splats;  // over the film window
+    double splat_scale{};
+};
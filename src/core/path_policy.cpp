@@ -0,0 +1,37 @@
+#include "path_policy.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+double ThroughputRoulette::continuation(const PathVertexState& state) const {
+    // The first diffuse vertex, also behind mirrors and glass
+    if (state.is_diffuse && !state.after_diffuse && options.first_bounce_splits > 1) {
+        return static_cast<double>(options.first_bounce_splits);
+    }
+    if (state.depth < options.min_depth) {
+        return 1.0;
+    }
+
+    double contribution = luminance(state.throughput);
+    if (state.pixel_estimate > 0.0 && state.image_estimate > 0.0) {
+        contribution *= state.image_estimate / state.pixel_estimate;
+    }
+    return std::clamp(contribution, options.min_probability, options.max_probability);
+}
+
+std::string ThroughputRoulette::name() const {
+    return options.first_bounce_splits > 1 ? "throughput-split" : "throughput";
+}
+
+std::shared_ptr<const PathPolicy> create_path_policy(const std::string& name) {
+    if (name == "constant") {
+        return std::make_shared<ConstantRoulette>();
+    } else if (name == "throughput") {
+        return std::make_shared<ThroughputRoulette>();
+    } else if (name == "throughput-split") {
+        ThroughputRoulette::Options options;
+        options.first_bounce_splits = 4;
+        return std::make_shared<ThroughputRoulette>(options);
+    }
+    throw std::runtime_error{"unknown path policy '" + name + "'"};
+}
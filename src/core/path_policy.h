@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "color.h"
+
+// What a path knows about itself at a vertex when it decides how to continue
+struct PathVertexState {
+    RgbColor throughput;      // weight of the path from the camera up to this vertex
+    size_t depth{};           // number of vertices so far
+    bool is_diffuse{};        // the BSDF at the vertex isn't specular
+    double pixel_estimate{};  // mean luminance of the pixel so far, zero while unknown
+    double image_estimate{};  // mean luminance of the whole image so far, zero while unknown
+    bool after_diffuse{};     // an earlier vertex is diffuse
+};
+
+// Decides how many continuations a path gets after each vertex. A factor q below 1 is Russian
+// roulette with survival probability q, above 1 splits the path into floor(q) or ceil(q)
+// branches, with odds that make q branches the expectation. Each branch is weighted 1 / q, so
+// any policy leaves the estimate unbiased and only changes its variance and cost.
+class PathPolicy {
+  public:
+    virtual ~PathPolicy() = default;
+
+    /// Expected number of continuations, zero ends the path
+    virtual double continuation(const PathVertexState& state) const = 0;
+
+    virtual std::string name() const = 0;
+};
+
+// Survive with a fixed probability at every vertex
+class ConstantRoulette : public PathPolicy {
+  public:
+    explicit ConstantRoulette(double probability = 0.8) : probability{probability} {}
+
+    double continuation(const PathVertexState&) const override { return probability; }
+
+    std::string name() const override { return "constant"; }
+
+  private:
+    double probability;
+};
+
+// Roulette on the expected contribution of a path relative to its pixel, in the spirit of
+// adjoint-driven Russian roulette. Without an estimate of the radiance arriving at a vertex,
+// the image mean stands in for it, so a path is expected to add throughput * image / pixel of
+// the pixel value. Paths that still matter nearly always survive, paths through dark, absorbing
+// interactions are ended early, and pixels darker than the image keep their paths longer.
+class ThroughputRoulette : public PathPolicy {
+  public:
+    struct Options {
+        size_t min_depth{3};            // vertices before roulette starts
+        double min_probability{0.05};   // keep rare bright paths reachable
+        double max_probability{0.95};   // end paths that bounce between mirrors and glass
+        size_t first_bounce_splits{1};  // branches at the first diffuse vertex, 1 for none
+    };
+
+    ThroughputRoulette() = default;
+
+    explicit ThroughputRoulette(const Options& options) : options{options} {}
+
+    double continuation(const PathVertexState& state) const override;
+
+    std::string name() const override;
+
+  private:
+    Options options;
+};
+
+/// @brief "constant", "throughput" or "throughput-split", the latter splitting four ways at the
+/// first diffuse bounce. Throws std::runtime_error on other names.
+std::shared_ptr<const PathPolicy> create_path_policy(const std::string& name);
@@ -1,14 +1,22 @@
 #include "pathtracer.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "bxdf.h"
 #include "light.h"
 #include "material.h"
 #include "objects.h"
+#include "photon_map.h"
 #include "scene.h"
+#include "stats.h"
 
-RgbColor PathTracer::compute_radiance(const Ray& ray) const {
+RgbColor PathTracer::compute_radiance(const Ray& ray,
+                                      const PixelEstimate& estimate,
+                                      SampleRecord* record) const {
     auto rec = scene->hit(ray);
     if (!rec.has_value()) {
+        thread_stats().record_path_length(0);
         return Color::black;
     }
 
@@ -18,39 +26,100 @@ RgbColor PathTracer::compute_radiance(const Ray& ray) const {
         emitted    = light->compute_emitted_radiance(rec->p, rec->incident);
     }
 
-    auto scattered = compute_scattered_radiance(*rec);
-    return emitted + scattered;
+    auto [direct, indirect] = compute_scattered_components(*rec, {1, Color::white, estimate});
+
+    if (record) {
+        record->normal    = rec->frame.normal;
+        record->depth     = rec->t * ray.d.norm();
+        record->object_id = static_cast<int>(rec->scene_index);
+        if (rec->is_light()) {
+            record->albedo = rec->get_light()->get_base_color();
+        } else {
+            auto material    = rec->get_geometry()->get_material();
+            record->albedo   = material->get_albedo(rec->uv);
+            record->material = material.get();
+        }
+        record->direct   = emitted + direct;
+        record->indirect = indirect;
+    }
+
+    return emitted + direct + indirect;
 }
 
-RgbColor PathTracer::compute_scattered_radiance(const SurfaceIntersection& rec) const {
+RgbColor PathTracer::compute_scattered_radiance(const SurfaceIntersection& rec,
+                                                const PathState& path) const {
+    auto [direct, indirect] = compute_scattered_components(rec, path);
+    return direct + indirect;
+}
+
+std::pair<RgbColor, RgbColor> PathTracer::compute_scattered_components(
+    const SurfaceIntersection& rec, const PathState& path) const {
     if (rec.is_light()) {
-        return Color::black;
+        thread_stats().record_path_length(path.depth);
+        return {Color::black, Color::black};
     }
 
-    RgbColor direct_lighting = compute_direct_lighting(rec);
+    // ----------- Get material info -----------
+    auto geometry = rec.get_geometry();
+    auto material = geometry->get_material();
+    if (!material) {
+        auto name = geometry->name();
+        throw std::runtime_error{"Some " + name + " doesn't have material"};
+    }
+    auto bsdf = material->compute_bsdf(rec.uv);
+    if (!bsdf) {
+        throw std::runtime_error{"empty BSDF"};
+    }
+
+    // Light that reaches a diffuse vertex through specular ones comes from the photon map
+    RgbColor direct_lighting = Color::black;
+    bool specular            = bsdf->type() == BsdfType::specular;
+    if (!photon_map || !specular || !path.after_diffuse) {
+        direct_lighting = compute_direct_lighting(rec, *bsdf);
+    }
+    if (photon_map && !specular) {
+        direct_lighting += compute_caustics(rec, *bsdf);
+    }
+
+    // Expected number of continuations q: floor(q) of them, plus one more with the odds of the
+    // fractional part
+    double q = policy->continuation({path.throughput,
+                                     path.depth,
+                                     !specular,
+                                     path.estimate.pixel,
+                                     path.estimate.image,
+                                     path.after_diffuse});
+    auto n   = static_cast<size_t>(q);
+    if (random_double() < q - static_cast<double>(n)) {
+        ++n;
+    }
 
     RgbColor indirect_lighting = Color::black;
-    constexpr double p_rr      = 0.8;
-    if (random_double() < p_rr) {
-        indirect_lighting = compute_indirect_lighting(rec) / p_rr;
+    if (n == 0) {
+        auto& stats = thread_stats();
+        ++stats.rr_terminations;
+        stats.record_path_length(path.depth);
+    }
+    for (size_t i{}; i < n; ++i) {
+        indirect_lighting += compute_indirect_lighting(rec, *bsdf, path, q);
     }
 
-    return direct_lighting + indirect_lighting;
+    return {direct_lighting, indirect_lighting / std::max(q, 1e-12)};
 }
 
-RgbColor PathTracer::compute_direct_lighting(const SurfaceIntersection& rec) const {
-    auto light = get_random_light(*scene);
-    auto bsdf  = rec.get_geometry()->get_material()->compute_bsdf();
+RgbColor PathTracer::compute_direct_lighting(const SurfaceIntersection& rec, const Bsdf& bsdf) const {
+    auto material = rec.get_geometry()->get_material();
 
     const auto& [world_to_shading, shading_to_world] = shading_transforms(rec.frame);
 
     // Special case for perfect specular reflection or refraction
     // In this case, we sample BSDF instead of light to get wi
-    if (bsdf->type() == BsdfType::specular) {
+    if (bsdf.type() == BsdfType::specular) {
         auto world_wo   = normalized(rec.incident);
         auto shading_wo = world_to_shading.on_vec(world_wo).normalized();
 
-        auto sample = bsdf->sample(shading_wo);
+        auto sample = bsdf.sample(shading_wo);
+        ++thread_stats().bsdf_samples[material.get()];
         if (!sample.has_value()) {
             throw std::runtime_error{"empty sample result for specular BSDF"};
         }
@@ -63,7 +132,9 @@ RgbColor PathTracer::compute_direct_lighting(const SurfaceIntersection& rec) con
             return Color::black;
         }
 
-        auto radiance = light->compute_emitted_radiance(next_rec->p, next_rec->incident);
+        // The light the ray found, its emission may depend on the direction
+        auto radiance =
+            next_rec->get_light()->compute_emitted_radiance(next_rec->p, next_rec->incident);
         auto abscos_o = absdot(rec.frame.normal, normalized(next_rec->p - rec.p));
 
         // double abscos_l      = absdot(-world_wi, next_rec->frame.normal.normalized());
@@ -76,8 +147,9 @@ RgbColor PathTracer::compute_direct_lighting(const SurfaceIntersection& rec) con
     }
 
     // For glossy BSDF, we sample light sources
-    const auto& [p, normal, pdf] = light->sample();
-    if (!scene->mutually_visible(p, rec.p)) {
+    auto light                   = get_random_light(*scene);
+    const auto& [p, normal, pdf] = light->sample_from(rec.p);
+    if (pdf == 0.0 || !scene->mutually_visible(p, rec.p)) {
         return Color::black;
     }
 
@@ -86,7 +158,7 @@ RgbColor PathTracer::compute_direct_lighting(const SurfaceIntersection& rec) con
 
     auto shading_wo = world_to_shading.on_vec(world_wo).normalized();
     auto shading_wi = world_to_shading.on_vec(world_wi).normalized();
-    RgbColor fr     = bsdf->evaluate(shading_wo, shading_wi);
+    RgbColor fr     = bsdf.evaluate(shading_wo, shading_wi);
 
     double abscos_o      = absdot(shading_wi, {0, 1, 0});
     double abscos_l      = absdot(-world_wi, normal.normalized());
@@ -97,55 +169,157 @@ RgbColor PathTracer::compute_direct_lighting(const SurfaceIntersection& rec) con
     return fr * radiance * geometry_term / pdf;
 }
 
-RgbColor PathTracer::compute_indirect_lighting(const SurfaceIntersection& rec) const {
+RgbColor PathTracer::compute_caustics(const SurfaceIntersection& rec, const Bsdf& bsdf) const {
     const auto& [world_to_shading, shading_to_world] = shading_transforms(rec.frame);
+    auto world_wo   = normalized(rec.incident);
+    auto shading_wo = world_to_shading.on_vec(world_wo).normalized();
+    const auto& n   = rec.frame.normal;
+    double side     = dot(world_wo, n);
+
+    RgbColor flux = Color::black;
+    photon_map->for_each_near(rec.p, [&](const Photon& photon) {
+        // Same surface and same side of it
+        if (dot(photon.normal, n) < 0.9 || dot(photon.wi, n) * side <= 0.0) {
+            return;
+        }
+        auto shading_wi = world_to_shading.on_vec(photon.wi).normalized();
+        flux += bsdf.evaluate(shading_wo, shading_wi) * photon.power;
+    });
 
-    // ----------- Get material info -----------
-    auto geometry = rec.get_geometry();
-    auto material = geometry->get_material();
-    if (!material) {
-        auto name = geometry->name();
-        throw std::runtime_error{"Some " + name + " doesn't have material"};
-    }
+    double radius = photon_map->get_radius();
+    return flux / (pi * radius * radius);
+}
+
+RgbColor PathTracer::compute_indirect_lighting(const SurfaceIntersection& rec,
+                                               const Bsdf& bsdf,
+                                               const PathState& path,
+                                               double q) const {
+    const auto& [world_to_shading, shading_to_world] = shading_transforms(rec.frame);
+    auto material = rec.get_geometry()->get_material();
 
     // ----------- Transform to shading frame -----------
 
     auto world_wo   = normalized(rec.incident);
     auto shading_wo = world_to_shading.on_vec(world_wo).normalized();
 
-    // ----------- Sample wo in shading frame -----------
+    // ----------- Sample wi in shading frame -----------
 
-    auto bsdf = material->compute_bsdf();
-    if (!bsdf) {
-        throw std::runtime_error{"empty BSDF"};
+    // Once the region has learned something, pick the BSDF or the guiding distribution at
+    // random and weight by the density of the mixture
+    const DirectionalQuadtree* guide{};
+    if (guiding && bsdf.type() != BsdfType::specular) {
+        guide = guiding->sampling_tree(rec.p);
     }
 
-    auto sample = bsdf->sample(shading_wo);
-    if (!sample.has_value()) {
-        throw std::runtime_error{"Bsdf from " + material->name() + " doesn't sample"};
+    Vec3 shading_wi;
+    Vec3 world_wi;
+    RgbColor bsdf_value;
+    double pdf{};
+    if (!guide || random_double() < guiding_bsdf_fraction) {
+        auto sample = bsdf.sample(shading_wo);
+        ++thread_stats().bsdf_samples[material.get()];
+        if (!sample.has_value()) {
+            throw std::runtime_error{"Bsdf from " + material->name() + " doesn't sample"};
+        }
+        bsdf_value = sample->bsdf_value;
+        pdf        = sample->pdf_value;
+        shading_wi = normalized(sample->shading_wi);
+        world_wi   = shading_to_world.on_vec(shading_wi).normalized();
+    } else {
+        world_wi   = square_to_direction(guide->sample(random_double(), random_double()));
+        shading_wi = world_to_shading.on_vec(world_wi).normalized();
+        // The BSDFs guided here only reflect
+        bsdf_value = shading_wi.y() > 0.0 ? bsdf.evaluate(shading_wo, shading_wi) : Color::black;
+    }
+    if (guide) {
+        pdf = guiding_bsdf_fraction * bsdf.pdf(shading_wo, shading_wi) +
+              (1.0 - guiding_bsdf_fraction) * guide->pdf(direction_to_square(world_wi)) * inv_4pi;
     }
 
     // ----------- BSDF value & PDF & cos -----------
 
-    RgbColor bsdf_value = sample->bsdf_value;
     if (is_nearly_black(bsdf_value)) {
+        thread_stats().record_path_length(path.depth);
         return Color::black;
     }
 
-    auto pdf = sample->pdf_value;
-
-    auto shading_wi = normalized(sample->shading_wi);
-    double abscos   = absdot(shading_wi, {0, 1, 0});
+    double abscos = absdot(shading_wi, {0, 1, 0});
 
     // ----------- Indirect incoming radiance -----------
 
-    auto world_wi = shading_to_world.on_vec(shading_wi).normalized();
+    bool learn    = guiding && bsdf.type() != BsdfType::specular;
     auto next_rec = scene->hit({rec.p, world_wi});
     if (!next_rec.has_value()) {
+        thread_stats().record_path_length(path.depth);
+        if (learn) {
+            guiding->record(rec.p, world_wi, 0.0);
+        }
         return Color::black;
     }
 
-    auto radiance = compute_scattered_radiance(*next_rec);
+    auto weight   = bsdf_value * abscos / pdf;
+    bool diffuse  = bsdf.type() != BsdfType::specular;
+    auto radiance = compute_scattered_radiance(*next_rec, path.next(weight / q, diffuse));
+    if (learn) {
+        guiding->record(rec.p, world_wi, luminance(radiance) / pdf);
+    }
+
+    return weight * radiance;
+}
 
-    return bsdf_value * radiance * abscos / pdf;
+void PathTracer::begin_pass() {
+    if (!caustics_enabled || (photon_map && !caustic_options.progressive)) {
+        return;
+    }
+
+    // Radius reduction of progressive photon mapping: pass i keeps (i + alpha) / (i + 1) of
+    // the photons within the radius, so the bias vanishes while the noise still averages out
+    if (caustic_pass > 0) {
+        double i = static_cast<double>(caustic_pass);
+        caustic_radius *= std::sqrt((i + caustic_options.alpha) / (i + 1.0));
+    }
+    auto photons = trace_caustic_photons(*scene, caustic_options.photons, get_seed(), caustic_pass);
+    photon_map   = std::make_unique<PhotonMap>(std::move(photons), caustic_radius);
+    ++caustic_pass;
+}
+
+void PathTracer::begin_render(const Camera&) {
+    guiding.reset();
+    if (guiding_enabled) {
+        guiding = std::make_unique<GuidingField>(scene->bounds());
+    }
+    guiding_iteration = 0;
+    next_refine       = 1;
+
+    photon_map.reset();
+    caustic_radius = caustic_options.radius;
+    caustic_pass   = 0;
+}
+
+std::vector<size_t> PathTracer::pass_schedule(size_t spp) const {
+    if (!guiding_enabled) {
+        if (caustics_enabled && caustic_options.progressive) {
+            // A photon map per sample, like the iterations of SPPM
+            return std::vector<size_t>(spp, 1);
+        }
+        return RayTracer::pass_schedule(spp);
+    }
+
+    // Training iterations double in length. The last one takes the rest, unless that leaves
+    // room for another full iteration.
+    std::vector<size_t> res;
+    for (size_t length{1}; spp > 0; length *= 2) {
+        auto pass = spp < 3 * length ? spp : length;
+        res.push_back(pass);
+        spp -= pass;
+    }
+    return res;
+}
+
+void PathTracer::end_pass(size_t samples_done) {
+    if (!guiding || samples_done < next_refine) {
+        return;
+    }
+    guiding->refine(guiding_iteration++);
+    next_refine = samples_done + (size_t{1} << guiding_iteration);
 }
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include "bxdf.h"
+#include "guiding.h"
 #include "intersection.h"
+#include "path_policy.h"
+#include "photon_map.h"
 #include "renderer.h"
 
 class PathTracer : public RayTracer {
@@ -11,10 +16,83 @@ class PathTracer : public RayTracer {
     PathTracer(int w, int h, std::shared_ptr<PixelSampler> pixel_sampler, size_t samples_per_pixel)
         : RayTracer{w, h, std::move(pixel_sampler), samples_per_pixel} {}
 
-    RgbColor compute_radiance(const Ray& ray) const override;
+    /// How paths are ended or split after each vertex, ConstantRoulette by default
+    void set_path_policy(std::shared_ptr<const PathPolicy> policy) {
+        this->policy = std::move(policy);
+    }
+
+    const PathPolicy& get_path_policy() const { return *policy; }
+
+    /// @brief Guide indirect bounces by the radiance learned so far in the render, see
+    /// GuidingField. Renders then train in passes of 1, 2, 4, ... samples per pixel.
+    void set_guiding(bool enabled) { guiding_enabled = enabled; }
+
+    /// @brief Render the light that reaches diffuse surfaces through specular objects from a
+    /// photon map instead of paths. Paths that would find that light skip it, so nothing
+    /// is counted twice. The estimate is biased by the gather radius, progressive renders
+    /// shrink it every pass and converge.
+    void set_caustics(bool enabled, const CausticOptions& options = {}) {
+        caustics_enabled = enabled;
+        caustic_options  = options;
+    }
+
+    RgbColor compute_radiance(const Ray& ray,
+                              const PixelEstimate& estimate,
+                              SampleRecord* record) const override;
+
+  protected:
+    void begin_render(const Camera& camera) override;
+
+    void begin_pass() override;
+
+    std::vector<size_t> pass_schedule(size_t spp) const override;
+
+    void end_pass(size_t samples_done) override;
 
   private:
-    RgbColor compute_scattered_radiance(const SurfaceIntersection& rec) const;
-    RgbColor compute_direct_lighting(const SurfaceIntersection& rec) const;
-    RgbColor compute_indirect_lighting(const SurfaceIntersection& rec) const;
-};
\ No newline at end of file
+    // Where a path stands when it reaches a vertex
+    struct PathState {
+        size_t depth;  // number of path vertices up to and including the current one
+        RgbColor throughput;
+        const PixelEstimate& estimate;
+        bool after_diffuse{};  // an earlier vertex is diffuse, the later ones then are caustics
+
+        PathState next(const RgbColor& weight, bool from_diffuse) const {
+            return {depth + 1, throughput * weight, estimate, after_diffuse || from_diffuse};
+        }
+    };
+
+    RgbColor compute_scattered_radiance(const SurfaceIntersection& rec, const PathState& path) const;
+
+    // Return (direct, indirect) parts of the radiance scattered at 'rec'
+    std::pair<RgbColor, RgbColor> compute_scattered_components(const SurfaceIntersection& rec,
+                                                               const PathState& path) const;
+
+    RgbColor compute_direct_lighting(const SurfaceIntersection& rec, const Bsdf& bsdf) const;
+
+    /// Radiance the caustic photons around 'rec' reflect towards the path
+    RgbColor compute_caustics(const SurfaceIntersection& rec, const Bsdf& bsdf) const;
+
+    /// One continuation of the path through 'rec', its throughput already divided by the
+    /// expected number of continuations 'q'
+    RgbColor compute_indirect_lighting(const SurfaceIntersection& rec,
+                                       const Bsdf& bsdf,
+                                       const PathState& path,
+                                       double q) const;
+
+    std::shared_ptr<const PathPolicy> policy{std::make_shared<ConstantRoulette>()};
+
+    bool guiding_enabled{false};
+    std::unique_ptr<GuidingField> guiding;  // records from the const render path, thread safe
+    size_t guiding_iteration{};
+    size_t next_refine{};  // samples per pixel that end the current training iteration
+
+    /// Probability of sampling the BSDF rather than the guiding distribution
+    static constexpr double guiding_bsdf_fraction{0.5};
+
+    bool caustics_enabled{false};
+    CausticOptions caustic_options;
+    std::unique_ptr<PhotonMap> photon_map;
+    double caustic_radius{};
+    size_t caustic_pass{};
+};
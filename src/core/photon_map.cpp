@@ -0,0 +1,125 @@
+#include "photon_map.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "bxdf.h"
+#include "material.h"
+#include "objects.h"
+#include "profiler.h"
+#include "rng.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Random streams of photons use 'pixel' keys counting down from here, clear of the camera pixels
+constexpr uint64_t photon_stream{~uint64_t{0} - 1};
+
+// Photons traced per pool task
+constexpr size_t photon_chunk{1024};
+
+// Specular bounces a photon may take before it is dropped
+constexpr int max_photon_bounces{16};
+
+}  // namespace
+
+PhotonMap::PhotonMap(std::vector<Photon> stored, double radius)
+    : radius{radius},
+      inv_cell_size{1.0 / radius} {
+    if (!(radius > 0.0)) {
+        throw std::runtime_error{"photon gather radius must be positive"};
+    }
+
+    size_t bucket_count{1};
+    while (bucket_count < stored.size()) {
+        bucket_count *= 2;
+    }
+    bucket_starts.assign(bucket_count + 1, 0);
+
+    // Counting sort by bucket
+    std::vector<size_t> buckets(stored.size());
+    for (size_t i{}; i < stored.size(); ++i) {
+        const auto& p = stored[i].p;
+        buckets[i]    = bucket(cell(p.x()), cell(p.y()), cell(p.z()));
+        ++bucket_starts[buckets[i] + 1];
+    }
+    for (size_t b{}; b < bucket_count; ++b) {
+        bucket_starts[b + 1] += bucket_starts[b];
+    }
+    photons.resize(stored.size());
+    auto next = bucket_starts;
+    for (size_t i{}; i < stored.size(); ++i) {
+        photons[next[buckets[i]]++] = stored[i];
+    }
+}
+
+size_t PhotonMap::bucket(int64_t x, int64_t y, int64_t z) const {
+    auto h = static_cast<uint64_t>(x) * 73856093 ^ static_cast<uint64_t>(y) * 19349663 ^
+             static_cast<uint64_t>(z) * 83492791;
+    return mix_bits(h) & (bucket_starts.size() - 2);
+}
+
+std::vector<Photon> trace_caustic_photons(const TestScene& scene,
+                                          size_t count,
+                                          uint64_t seed,
+                                          size_t pass) {
+    PROFILE_ZONE("trace_photons");
+    if (scene.light_count() == 0) {
+        return {};
+    }
+    auto light_count = static_cast<double>(scene.light_count());
+
+    size_t chunks = (count + photon_chunk - 1) / photon_chunk;
+    std::vector<std::vector<Photon>> stored(chunks);
+    ThreadPool::global().parallel_for(0, chunks, [&](size_t chunk) {
+        auto end = std::min(count, (chunk + 1) * photon_chunk);
+        for (size_t i{chunk * photon_chunk}; i < end; ++i) {
+            RandomStream::start(seed, photon_stream - pass, i);
+
+            auto light  = get_random_light(scene);
+            auto sample = light->sample_emission();
+
+            // Le cos / (pdf_area pdf_direction) of one in 'count' photons
+            double weight  = absdot(sample.normal, sample.direction) * light_count /
+                            (sample.pdf_area * sample.pdf_direction * static_cast<double>(count));
+            RgbColor power = light->compute_emitted_radiance(sample.p, sample.direction) * weight;
+
+            Ray ray{sample.p, sample.direction};
+            bool after_specular{false};
+            for (int bounce{}; bounce <= max_photon_bounces; ++bounce) {
+                auto rec = scene.hit(ray);
+                if (!rec.has_value() || rec->is_light()) {
+                    break;
+                }
+                auto bsdf = rec->get_geometry()->get_material()->compute_bsdf(rec->uv);
+                if (bsdf->type() != BsdfType::specular) {
+                    // Only caustics go to the map, path tracing handles the rest
+                    if (after_specular) {
+                        stored[chunk].push_back(
+                            {rec->p, normalized(rec->incident), rec->frame.normal, power});
+                    }
+                    break;
+                }
+
+                const auto& [world_to_shading, shading_to_world] = shading_transforms(rec->frame);
+                auto shading_wo = world_to_shading.on_vec(normalized(rec->incident)).normalized();
+                auto bounced    = bsdf->sample(shading_wo);
+                if (!bounced.has_value()) {
+                    break;
+                }
+                auto shading_wi = normalized(bounced->shading_wi);
+                double cos_wi   = absdot(shading_wi, {0, 1, 0});
+                power          = power * bounced->bsdf_value * (cos_wi / bounced->pdf_value);
+                ray            = {rec->p, shading_to_world.on_vec(shading_wi).normalized()};
+                after_specular = true;
+            }
+        }
+    });
+
+    std::vector<Photon> res;
+    for (auto& photons : stored) {
+        res.insert(res.end(), photons.begin(), photons.end());
+    }
+    return res;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "color.h"
+#include "vec.h"
+
+class TestScene;
+
+// Light arriving at a diffuse surface
+struct Photon {
+    Vec3 p;
+    Vec3 wi;      // towards where the photon came from
+    Vec3 normal;  // geometric normal of the surface it landed on
+    RgbColor power;
+};
+
+// How the caustics of specular objects are rendered from photons
+struct CausticOptions {
+    size_t photons{200000};   // emitted per photon map
+    double radius{0.05};      // gather radius in world units
+    bool progressive{false};  // trace a new map with a smaller radius every pass, like SPPM
+    double alpha{2.0 / 3.0};  // fraction of the photons each progressive pass keeps
+};
+
+// Photons hashed into a uniform grid of cells one gather radius wide, so a lookup visits the
+// 27 cells around the query point
+class PhotonMap {
+  public:
+    PhotonMap() = default;
+
+    PhotonMap(std::vector<Photon> photons, double radius);
+
+    /// Call f(photon) for every photon within the gather radius of 'p'
+    template <typename F>
+    void for_each_near(const Vec3& p, F&& f) const;
+
+    size_t size() const { return photons.size(); }
+
+    double get_radius() const { return radius; }
+
+  private:
+    size_t bucket(int64_t x, int64_t y, int64_t z) const;
+
+    int64_t cell(double x) const { return static_cast<int64_t>(std::floor(x * inv_cell_size)); }
+
+    std::vector<Photon> photons;          // ordered by bucket
+    std::vector<uint32_t> bucket_starts;  // first photon of every bucket, and the end
+    double radius{};
+    double inv_cell_size{};
+};
+
+template <typename F>
+void PhotonMap::for_each_near(const Vec3& p, F&& f) const {
+    if (photons.empty()) {
+        return;
+    }
+
+    // Neighboring cells can share a bucket, visit each bucket once
+    size_t visited[27];
+    size_t count{};
+    int64_t cx = cell(p.x());
+    int64_t cy = cell(p.y());
+    int64_t cz = cell(p.z());
+    for (int64_t z{cz - 1}; z <= cz + 1; ++z) {
+        for (int64_t y{cy - 1}; y <= cy + 1; ++y) {
+            for (int64_t x{cx - 1}; x <= cx + 1; ++x) {
+                auto b = bucket(x, y, z);
+                bool seen{false};
+                for (size_t i{}; i < count && !seen; ++i) {
+                    seen = visited[i] == b;
+                }
+                if (seen) {
+                    continue;
+                }
+                visited[count++] = b;
+
+                for (auto i = bucket_starts[b]; i < bucket_starts[b + 1]; ++i) {
+                    const auto& photon = photons[i];
+                    auto d             = photon.p - p;
+                    if (dot(d, d) <= radius * radius) {
+                        f(photon);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// @brief Emit 'count' photons from the lights of 'scene' and keep those that reach a diffuse
+/// surface after one or more specular bounces. Pass 'pass' of seed 'seed' has its own random
+/// numbers, so progressive passes trace independent maps.
+std::vector<Photon> trace_caustic_photons(const TestScene& scene,
+                                          size_t count,
+                                          uint64_t seed,
+                                          size_t pass);
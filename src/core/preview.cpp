@@ -0,0 +1,77 @@
+#include "preview.h"
+
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+#include "image.h"
+#include "profiler.h"
+
+PreviewWriter::PreviewWriter(std::string path, const DisplayOptions& display)
+    : path{std::move(path)}, display{display}, writer{[this] { writer_main(); }} {}
+
+PreviewWriter::~PreviewWriter() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+}
+
+void PreviewWriter::publish(const Film& film) {
+    PROFILE_ZONE("preview_copy");
+    // Radiance and sample counts are all a preview resolves
+    auto snapshot = std::make_unique<Film>(
+        film.get_full_width(), film.get_full_height(), film.get_window(), AovType::none);
+    snapshot->radiance     = film.radiance;
+    snapshot->sample_count = film.sample_count;
+
+    {
+        std::lock_guard lock{mutex};
+        pending = std::move(snapshot);
+    }
+    wake.notify_one();
+}
+
+size_t PreviewWriter::written_count() const {
+    std::lock_guard lock{mutex};
+    return written;
+}
+
+void PreviewWriter::writer_main() {
+    std::unique_lock lock{mutex};
+    while (true) {
+        wake.wait(lock, [this] { return pending || stopping; });
+        if (!pending) {
+            break;
+        }
+
+        auto snapshot = std::move(pending);
+        lock.unlock();
+        write(*snapshot);
+        lock.lock();
+        ++written;
+    }
+}
+
+void PreviewWriter::write(const Film& snapshot) const {
+    PROFILE_ZONE("preview_write");
+    Buffer2D<RgbColor> radiance;
+    AovBuffers aovs;
+    snapshot.resolve(radiance, aovs, nullptr);
+
+    const auto& window = snapshot.get_window();
+    Image image{snapshot.get_full_width(), snapshot.get_full_height()};
+    image.fill(Color::black);
+    // Off the pool, which is busy rendering
+    write_display_image(radiance, display, image, window.x0, window.y0, false);
+
+    auto temp_path = path + ".tmp";
+    image.save(temp_path);
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::cerr << "failed to write preview: " << path << "\n";
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "film.h"
+#include "tonemap.h"
+
+// When and where a render in progress publishes snapshots, see RayTracer::set_preview
+struct PreviewOptions {
+    std::string path;      // PNG to overwrite, previews are off if empty
+    double interval{2.0};  // seconds between snapshots, zero to only count passes
+    size_t passes{};       // also publish every this many passes if nonzero
+};
+
+// Writes snapshots of a film to an image on a background thread, so the render threads never
+// wait for tonemapping or PNG encoding. publish() only copies the sums. If the writer is still
+// busy when the next snapshot arrives, the older pending one is dropped. Images are written
+// aside and renamed into place, so viewers never read a half written file.
+class PreviewWriter {
+  public:
+    PreviewWriter(std::string path, const DisplayOptions& display);
+
+    /// Write the last pending snapshot, then stop the thread
+    ~PreviewWriter();
+
+    PreviewWriter(const PreviewWriter&)            = delete;
+    PreviewWriter& operator=(const PreviewWriter&) = delete;
+
+    /// Queue a snapshot of the current sums of 'film'
+    void publish(const Film& film);
+
+    /// Number of snapshots written so far
+    size_t written_count() const;
+
+  private:
+    void writer_main();
+
+    void write(const Film& snapshot) const;
+
+    std::string path;
+    DisplayOptions display;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unique_ptr<Film> pending;
+    size_t written{};
+    bool stopping{false};
+
+    std::thread writer;
+};
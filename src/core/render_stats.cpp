@@ -0,0 +1,81 @@
+#include "render_stats.h"
+
+#include <iomanip>
+
+namespace {
+
+double ratio(uint64_t a, uint64_t b) {
+    return b == 0 ? 0.0 : static_cast<double>(a) / static_cast<double>(b);
+}
+
+}  // namespace
+
+double RenderStats::stage_seconds(const std::string& name) const {
+    for (const auto& [stage, seconds] : stages) {
+        if (stage == name) {
+            return seconds;
+        }
+    }
+    return 0.0;
+}
+
+double RenderStats::mrays_per_second() const {
+    auto seconds = stage_seconds("render");
+    return seconds > 0.0 ? static_cast<double>(traced_rays()) / seconds / 1.0e6 : 0.0;
+}
+
+void RenderStats::print(std::ostream& os) const {
+    const auto& c = counters;
+    auto flags    = os.flags();
+    auto prec     = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << "---------- render statistics ----------\n";
+    double total{};
+    for (const auto& [stage, seconds] : stages) {
+        os << std::left << std::setw(24) << ("time/" + stage) << std::right << std::setw(14)
+           << seconds << " s\n";
+        total += seconds;
+    }
+    os << std::left << std::setw(24) << "time/total" << std::right << std::setw(14) << total
+       << " s\n";
+
+    auto line = [&os](const std::string& name, uint64_t value) {
+        os << std::left << std::setw(24) << name << std::right << std::setw(14) << value << "\n";
+    };
+    line("camera rays", c.camera_rays);
+    line("closest hit queries", c.closest_hit_queries);
+    line("shadow queries", c.shadow_queries);
+    line("primitive tests", c.primitive_tests);
+    line("bvh node visits", c.bvh_node_visits);
+    line("rr terminations", c.rr_terminations);
+
+    auto queries = c.closest_hit_queries + c.shadow_queries;
+    os << std::left << std::setw(24) << "tests per ray" << std::right << std::setw(14)
+       << ratio(c.primitive_tests, queries) << "\n";
+    os << std::left << std::setw(24) << "nodes per ray" << std::right << std::setw(14)
+       << ratio(c.bvh_node_visits, queries) << "\n";
+    os << std::left << std::setw(24) << "Mrays/s" << std::right << std::setw(14)
+       << mrays_per_second() << "\n";
+    os << std::left << std::setw(24) << "variance" << std::right << std::setw(14)
+       << std::setprecision(6) << mean_variance << "\n";
+    os << std::left << std::setw(24) << "variance x time" << std::right << std::setw(14)
+       << variance_time() << std::setprecision(3) << "\n";
+
+    os << "path length:\n";
+    for (size_t i{}; i < c.path_lengths.size(); ++i) {
+        if (c.path_lengths[i] == 0) {
+            continue;
+        }
+        auto label = std::to_string(i) + (i == StatCounters::max_path_length ? "+" : "");
+        line("  " + label, c.path_lengths[i]);
+    }
+
+    os << "bsdf samples:\n";
+    for (const auto& [material, count] : bsdf_samples) {
+        line("  " + material, count);
+    }
+
+    os.flags(flags);
+    os.precision(prec);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stats.h"
+
+// Counters and stage timings of one render, see stats.h
+struct RenderStats {
+    StatCounters counters;
+
+    /// Wall clock seconds per stage, in execution order
+    std::vector<std::pair<std::string, double>> stages;
+
+    /// BSDF samples by material label, in material id order
+    std::vector<std::pair<std::string, uint64_t>> bsdf_samples;
+
+    /// Mean over the pixels of the variance of their luminance estimates
+    double mean_variance{};
+
+    /// @brief Variance times seconds of the "render" stage. Lower is more efficient, and it is
+    /// comparable between renders with different sample counts or path policies.
+    double variance_time() const { return mean_variance * stage_seconds("render"); }
+
+    void add_stage(const std::string& name, double seconds) { stages.emplace_back(name, seconds); }
+
+    /// Seconds spent in a stage, zero if it didn't run
+    double stage_seconds(const std::string& name) const;
+
+    /// Rays traced through the scene, camera rays included
+    uint64_t traced_rays() const { return counters.closest_hit_queries + counters.shadow_queries; }
+
+    /// Traced rays per second of the "render" stage
+    double mrays_per_second() const;
+
+    void print(std::ostream& os) const;
+};
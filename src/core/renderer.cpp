@@ -1,8 +1,19 @@
 #include "renderer.h"
 
+#include <atomic>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
+#include "material.h"
+#include "preview.h"
+#include "profiler.h"
+#include "rng.h"
+#include "scene.h"
+#include "thread_pool.h"
+#include "timer.h"
 #include "utils.h"
 
 void Renderer::save_output(const std::string& path) const {
@@ -10,27 +21,265 @@ void Renderer::save_output(const std::string& path) const {
 }
 
 void RayTracer::render(const Camera& camera) {
-    // Iterate through all pixels and render for each
+    PROFILE_ZONE("render");
     auto [w, h] = std::make_pair(output.get_width(), output.get_height());
 
-    for (int y{}; y < h; ++y) {
-        std::cout << "rows remaining: " << std::setw(4) << h - y - 1 << "\r";
+    auto required = enabled_aovs;
+    if (denoise_enabled) {
+        required = required | AovType::albedo | AovType::normal | AovType::depth;
+    }
+    if (time_budget > 0.0) {
+        // Sample counts differ per pixel when the budget runs out mid pass
+        required = required | AovType::sample_count;
+    }
+    film             = Film{w, h, crop_window.value_or(ImageTile{0, 0, w, h}), required};
+    const auto& tile = film.get_window();
+
+    material_ids.clear();
+    for (const auto& object : scene->get_objects()) {
+        material_ids.try_emplace(object->get_material().get(), static_cast<int>(material_ids.size()));
+    }
 
-        for (int x{}; x < w; ++x) {
-            // Render for each pixel
-            auto result = Color::black;
+    stats = {};
+    reset_stats();
+    Timer timer;
+    begin_render(camera);
 
-            for (size_t s{0}; s < samples_per_pixel; ++s) {
-                auto [u_inpix, v_inpix] = pixel_sampler->sample();
-                auto [u_img, v_img]     = camera.to_image_plane_uv(w, h, x, y, u_inpix, v_inpix);
+    if (time_budget > 0.0 || !preview.path.empty()) {
+        std::optional<Deadline> deadline;
+        if (time_budget > 0.0) {
+            deadline = std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>{time_budget});
+        }
+        std::unique_ptr<PreviewWriter> preview_writer;
+        if (!preview.path.empty()) {
+            preview_writer = std::make_unique<PreviewWriter>(preview.path, display_options);
+        }
+        Timer preview_timer;
 
-                Ray ray = camera.generate_ray(u_img, v_img);
-                result += compute_radiance(ray);
+        // One sample per pass, so stopping at any row leaves an even image. The first pass
+        // ignores the deadline so that every pixel gets at least one sample.
+        size_t passes{};
+        while (passes < samples_per_pixel) {
+            std::cout << "pass " << passes + 1 << ": ";
+            begin_pass();
+            int rows = render_pass(camera, 1, passes == 0 ? std::nullopt : deadline);
+            if (rows == film.get_height()) {
+                end_pass(++passes);
+            }
+            if (rows < film.get_height() ||
+                (deadline && std::chrono::steady_clock::now() >= *deadline)) {
+                break;
             }
 
-            auto d = static_cast<double>(samples_per_pixel);
-            output.set_pixel_value(x, y, result / d);
+            bool preview_due =
+                (preview.interval > 0.0 && preview_timer.seconds() >= preview.interval) ||
+                (preview.passes > 0 && passes % preview.passes == 0);
+            if (preview_writer && preview_due && passes < samples_per_pixel) {
+                preview_writer->publish(film);
+                preview_timer.reset();
+            }
         }
+        if (deadline) {
+            std::cout << "\n" << passes << " complete passes in the time budget";
+        }
+    } else {
+        size_t samples_done{};
+        for (auto spp : pass_schedule(samples_per_pixel)) {
+            begin_pass();
+            render_pass(camera, spp, std::nullopt);
+            end_pass(samples_done += spp);
+        }
+    }
+
+    Buffer2D<double> variance;
+    film.resolve(radiance, aovs, &variance);
+    add_splats(radiance);
+    stats.add_stage("render", timer.seconds());
+    collect_render_stats();
+    double variance_sum{};
+    for (size_t i{}; i < variance.size(); ++i) {
+        variance_sum += variance.data()[i];
     }
+    stats.mean_variance = variance.empty() ? 0.0 : variance_sum / static_cast<double>(variance.size());
+
+    if (denoise_enabled) {
+        std::cout << "\ndenoising...";
+        timer.reset();
+        FeatureBuffers features{aovs.albedo, aovs.normal, aovs.depth, variance};
+        radiance = denoise(radiance, features, denoise_options);
+        stats.add_stage("denoise", timer.seconds());
+    }
+
+    timer.reset();
+    output.fill(Color::black);
+    write_display_image(radiance, display_options, output, tile.x0, tile.y0);
+    stats.add_stage("film", timer.seconds());
     std::cout << "\ndone.\n";
 }
+
+int RayTracer::render_pass(const Camera& camera,
+                           size_t spp,
+                           const std::optional<Deadline>& deadline) {
+    const auto& tile = film.get_window();
+    int h            = film.get_height();
+    std::atomic<int> rows_done{0};
+    std::mutex print_mutex;
+
+    double luminance_sum{};
+    double count_sum{};
+    for (size_t i{}; i < film.sample_count.size(); ++i) {
+        luminance_sum += film.luminance.data()[i];
+        count_sum += film.sample_count.data()[i];
+    }
+    image_estimate = count_sum > 0.0 ? luminance_sum / count_sum : 0.0;
+
+    ThreadPool::global().parallel_for(tile.y0, tile.y1, [&](size_t y) {
+        if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+            return;
+        }
+
+        {
+            PROFILE_ZONE("render_row");
+            render_row(camera, static_cast<int>(y), spp);
+        }
+
+        int remaining = h - ++rows_done;
+        std::lock_guard lock{print_mutex};
+        std::cout << "rows remaining: " << std::setw(4) << remaining << "\r" << std::flush;
+    });
+    return rows_done;
+}
+
+void RayTracer::render_row(const Camera& camera, int y, size_t spp) {
+    const auto& tile = film.get_window();
+    int w            = film.get_width();
+    int fy           = y - tile.y0;
+    auto d           = static_cast<double>(spp);
+
+    // Random streams are keyed by the pixel in the full image and the sample index, so crops,
+    // passes and sample ranges see the same numbers as one full render
+    auto pixel_index = [&](int x) {
+        return static_cast<uint64_t>(y) * output.get_width() + tile.x0 + x;
+    };
+    auto sample_index = [&](int x, size_t s) {
+        return first_sample + static_cast<uint64_t>(film.sample_count.at(x, fy)) + s;
+    };
+    constexpr uint64_t camera_dimensions{2};
+    auto& sums       = film.aovs;
+    bool need_record = sums.get_enabled() != AovType::none;
+
+    thread_stats().camera_rays += static_cast<uint64_t>(w) * spp;
+
+    // Generate the camera rays of the whole row up front
+    thread_local std::vector<double> u_offsets;
+    thread_local std::vector<double> v_offsets;
+    thread_local RayBatch rays;
+    u_offsets.resize(static_cast<size_t>(w) * spp);
+    v_offsets.resize(u_offsets.size());
+    for (int x{}; x < w; ++x) {
+        for (size_t s{}; s < spp; ++s) {
+            auto i = static_cast<size_t>(x) * spp + s;
+            RandomStream::start(seed, pixel_index(x), sample_index(x, s));
+            std::tie(u_offsets[i], v_offsets[i]) = pixel_sampler->sample();
+        }
+    }
+    camera.generate_tile_rays(output.get_width(), output.get_height(), {tile.x0, y, tile.x1, y + 1},
+                              spp, u_offsets.data(), v_offsets.data(), rays);
+
+    // Film coordinates from here on
+    for (int x{}; x < w; ++x) {
+        // Render for each pixel
+        auto result = Color::black;
+
+        SampleRecord sum;
+        double sum_l{};
+        double sum_l2{};
+        double taken       = film.sample_count.at(x, fy);
+        bool first_samples = taken == 0.0;
+
+        for (size_t s{0}; s < spp; ++s) {
+            Ray ray = rays.get(static_cast<size_t>(x) * spp + s);
+            RandomStream::start(seed, pixel_index(x), sample_index(x, s), camera_dimensions);
+
+            PixelEstimate estimate{0.0, image_estimate};
+            if (taken + s > 0) {
+                estimate.pixel = (film.luminance.at(x, fy) + sum_l) / (taken + s);
+            }
+
+            SampleRecord record;
+            auto sample = compute_radiance(ray, estimate, need_record ? &record : nullptr);
+            result += sample;
+
+            double l = luminance(sample);
+            sum_l += l;
+            sum_l2 += l * l;
+
+            if (!need_record) {
+                continue;
+            }
+
+            sum.albedo += record.albedo;
+            sum.normal += record.normal;
+            sum.depth += record.depth;
+            sum.direct += record.direct;
+            sum.indirect += record.indirect;
+
+            // Ids can't be averaged, keep the ones of the first sample
+            if (s == 0) {
+                sum.object_id = record.object_id;
+                sum.material  = record.material;
+            }
+        }
+
+        film.radiance.at(x, fy) += result;
+        film.luminance.at(x, fy) += sum_l;
+        film.luminance_sq.at(x, fy) += sum_l2;
+        film.sample_count.at(x, fy) += d;
+
+        if (!need_record) {
+            continue;
+        }
+
+        if (sums.has(AovType::depth)) {
+            sums.depth.at(x, fy) += sum.depth;
+        }
+        if (sums.has(AovType::normal)) {
+            sums.normal.at(x, fy) += sum.normal;
+        }
+        if (sums.has(AovType::albedo)) {
+            sums.albedo.at(x, fy) += sum.albedo;
+        }
+        if (sums.has(AovType::object_id) && first_samples) {
+            sums.object_id.at(x, fy) = sum.object_id;
+        }
+        if (sums.has(AovType::material_id) && first_samples) {
+            sums.material_id.at(x, fy) = material_id(sum.material);
+        }
+        if (sums.has(AovType::direct)) {
+            sums.direct.at(x, fy) += sum.direct;
+        }
+        if (sums.has(AovType::indirect)) {
+            sums.indirect.at(x, fy) += sum.indirect;
+        }
+    }
+}
+
+int RayTracer::material_id(const Material* material) const {
+    auto it = material_ids.find(material);
+    return it == material_ids.end() ? -1 : it->second;
+}
+
+void RayTracer::collect_render_stats() {
+    stats.counters = collect_stats();
+
+    // Label materials by their dense id, several materials can share a name
+    std::vector<std::pair<std::string, uint64_t>> samples(material_ids.size());
+    for (const auto& [material, id] : material_ids) {
+        auto it     = stats.counters.bsdf_samples.find(material);
+        auto count  = it == stats.counters.bsdf_samples.end() ? 0 : it->second;
+        samples[id] = {std::to_string(id) + " " + material->name(), count};
+    }
+    stats.bsdf_samples = std::move(samples);
+}
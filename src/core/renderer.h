@@ -1,14 +1,32 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "aov.h"
+#include "buffer2d.h"
 #include "camera.h"
+#include "denoiser.h"
+#include "film.h"
 #include "image.h"
+#include "preview.h"
+#include "render_stats.h"
 #include "sampler.h"
+#include "tonemap.h"
 
 class TestScene;
 
+// Running luminance estimates a camera sample can steer by, zero while unknown
+struct PixelEstimate {
+    double pixel{};  // mean of the samples of the pixel taken so far
+    double image{};  // mean over the whole film at the start of the pass
+};
+
 class Renderer {
   public:
     Renderer(int w, int h) : output{w, h} {};
@@ -37,9 +55,114 @@ class RayTracer : public Renderer {
 
     void render(const Camera& camera) override;
 
+    /// @brief Filter the result with the feature guided denoiser before writing the output. The
+    /// renderer then also records first-hit albedo, normal, depth and per-pixel variance.
+    void set_denoise(bool enabled, const DenoiseOptions& options = {}) {
+        denoise_enabled = enabled;
+        denoise_options = options;
+    }
+
+    /// Write the given AOVs during the next renders
+    void set_aovs(AovType aovs) { enabled_aovs = aovs; }
+
+    /// @brief Render progressive passes of one sample per pixel until 'seconds' of wall time
+    /// have passed, instead of a fixed number of samples. The first pass always completes, and
+    /// samples_per_pixel still caps the number of passes. Zero restores fixed sample counts.
+    void set_time_budget(double seconds) { time_budget = seconds; }
+
+    /// @brief Seed of the counter-based random numbers, see rng.h. Renders with the same seed
+    /// are identical, whatever the thread count.
+    void set_seed(uint64_t seed) { this->seed = seed; }
+
+    uint64_t get_seed() const { return seed; }
+
+    size_t get_samples_per_pixel() const { return samples_per_pixel; }
+
+    /// @brief Number the samples of the next render from 'first', so renders of disjoint sample
+    /// ranges of one image are independent and together equal one larger render
+    void set_first_sample(size_t first) { first_sample = first; }
+
+    /// @brief Render only the pixels inside 'window' of the output, the rest stays black. The film,
+    /// radiance and AOVs then cover just the window. An empty optional renders the full image.
+    void set_crop_window(const std::optional<ImageTile>& window) { crop_window = window; }
+
+    /// Exposure, tone curve and encoding of the 8-bit output
+    void set_display_options(const DisplayOptions& options) { display_options = options; }
+
+    /// @brief Write tonemapped snapshots of the accumulation to options.path while rendering, see
+    /// PreviewWriter. Renders then run in passes of one sample per pixel, like time budget renders.
+    void set_preview(const PreviewOptions& options) { preview = options; }
+
+    /// Sample sums of the last render, before denoising
+    const Film& get_film() const { return film; }
+
+    /// Linear radiance of the last render in the crop window, after denoising if enabled
+    const Buffer2D<RgbColor>& get_radiance() const { return radiance; }
+
+    /// AOVs of the last render. May hold more than requested, the denoiser needs some of them.
+    const AovBuffers& get_aovs() const { return aovs; }
+
+    void save_aovs(const std::string& prefix) const { aovs.save(prefix); }
+
+    /// Counters and stage timings of the last render
+    const RenderStats& get_stats() const { return stats; }
+
+  protected:
+    /// Called once the film of a render is set up, before its first pass
+    virtual void begin_render(const Camera& /*camera*/) {}
+
+    /// Called before every pass
+    virtual void begin_pass() {}
+
+    /// Split a render of 'spp' samples per pixel into passes, a single one by default
+    virtual std::vector<size_t> pass_schedule(size_t spp) const { return {spp}; }
+
+    /// Called after every complete pass with the samples per pixel taken so far
+    virtual void end_pass(size_t /*samples_done*/) {}
+
+    /// Add light gathered outside the film, like splats of light paths, to the resolved radiance
+    virtual void add_splats(Buffer2D<RgbColor>& /*radiance*/) const {}
+
   private:
-    virtual RgbColor compute_radiance(const Ray& ray) const = 0;
+    /// @brief Estimate radiance along a camera ray. If 'record' is not null, it also receives the
+    /// AOV quantities of this sample.
+    virtual RgbColor compute_radiance(const Ray& ray,
+                                      const PixelEstimate& estimate,
+                                      SampleRecord* record) const = 0;
+
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    /// @brief Add 'spp' samples to every pixel of the film. Rows that haven't started when the
+    /// deadline passes are skipped. Returns the number of rows rendered.
+    int render_pass(const Camera& camera, size_t spp, const std::optional<Deadline>& deadline);
+
+    /// Add samples to the pixels of row 'y' inside the film window
+    void render_row(const Camera& camera, int y, size_t spp);
+
+    int material_id(const Material* material) const;
+
+    void collect_render_stats();
 
     std::shared_ptr<PixelSampler> pixel_sampler;
     size_t samples_per_pixel;
+    double time_budget{};
+    uint64_t seed{};
+    size_t first_sample{};
+    std::optional<ImageTile> crop_window;
+    PreviewOptions preview;
+    double image_estimate{};
+
+    Film film;
+    Buffer2D<RgbColor> radiance;
+    AovBuffers aovs;
+    AovType enabled_aovs{AovType::none};
+
+    /// Dense material ids in order of first use by the scene objects
+    std::unordered_map<const Material*, int> material_ids;
+
+    bool denoise_enabled{false};
+    DenoiseOptions denoise_options;
+    DisplayOptions display_options;
+
+    RenderStats stats;
 };
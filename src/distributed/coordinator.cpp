@@ -0,0 +1,204 @@
+#include "coordinator.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include <poll.h>
+
+#include "profiler.h"
+
+Coordinator::Coordinator(const std::string& address, const CoordinatorOptions& options)
+    : options{options}, listener{address} {}
+
+Coordinator::~Coordinator() {
+    shutdown_workers();
+}
+
+void Coordinator::shutdown_workers() {
+    for (auto& worker : workers) {
+        try {
+            send_message(worker.socket, MessageType::shutdown);
+        } catch (const std::exception&) {
+            // Already gone
+        }
+    }
+    workers.clear();
+}
+
+Film Coordinator::render(const RenderSetup& setup, size_t samples_per_pixel) {
+    PROFILE_ZONE("distributed_render");
+    units = make_work_units(setup.image_width, setup.image_height, options.tile_size,
+                            samples_per_pixel, options.sample_splits);
+    attempts.assign(units.size(), 0);
+    done.assign(units.size(), false);
+    pending.clear();
+    for (size_t i{}; i < units.size(); ++i) {
+        pending.push_back(i);
+    }
+    done_count = 0;
+    film       = Film{setup.image_width, setup.image_height, setup.aovs};
+    exhausted.clear();
+
+    for (auto& worker : workers) {
+        worker.in_flight.clear();
+    }
+
+    auto encoded_setup = encode_setup(setup);
+    bool waiting_shown{false};
+    while (done_count < units.size()) {
+        if (!exhausted.empty()) {
+            throw std::runtime_error{exhausted};
+        }
+        dispatch(encoded_setup);
+
+        if (workers.empty() && !waiting_shown) {
+            std::cout << "waiting for workers at " << get_address() << "\n";
+            waiting_shown = true;
+        }
+
+        std::vector<pollfd> fds{{listener.get_fd(), POLLIN, 0}};
+        for (const auto& worker : workers) {
+            fds.push_back({worker.socket.get_fd(), POLLIN, 0});
+        }
+        if (::poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+            throw std::runtime_error{"poll failed"};
+        }
+
+        // Workers first, their indices shift as failed ones are removed
+        for (size_t i{workers.size()}; i-- > 0;) {
+            if (fds[i + 1].revents == 0) {
+                continue;
+            }
+            try {
+                if (!handle_message(workers[i])) {
+                    fail_worker(i, "disconnected");
+                }
+            } catch (const std::exception& e) {
+                fail_worker(i, e.what());
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_worker();
+        }
+
+        if (options.unit_timeout > 0.0) {
+            auto now = Clock::now();
+            for (size_t i{workers.size()}; i-- > 0;) {
+                const auto& worker = workers[i];
+                if (!worker.in_flight.empty() &&
+                    std::chrono::duration<double>(now - worker.started).count() >
+                        options.unit_timeout) {
+                    fail_worker(i, "timed out");
+                }
+            }
+        }
+    }
+    std::cout << "\n";
+    return std::move(film);
+}
+
+void Coordinator::accept_worker() {
+    workers.push_back({listener.accept(), {}, {}, {}});
+    std::cout << "worker connected, " << workers.size() << " workers\n";
+}
+
+void Coordinator::dispatch(const std::string& setup) {
+    // Round robin one unit at a time, so a new render spreads over all workers
+    bool sent{true};
+    while (sent && !pending.empty()) {
+        sent = false;
+        for (size_t i{workers.size()}; i-- > 0 && !pending.empty();) {
+            auto& worker = workers[i];
+            if (worker.in_flight.size() >= options.units_per_worker) {
+                continue;
+            }
+
+            size_t unit = pending.front();
+            try {
+                if (worker.setup != setup) {
+                    send_message(worker.socket, MessageType::setup, setup);
+                    worker.setup = setup;
+                }
+                send_message(worker.socket, MessageType::work, encode_work_unit(units[unit]));
+            } catch (const std::exception& e) {
+                fail_worker(i, e.what());
+                continue;
+            }
+
+            pending.pop_front();
+            ++attempts[unit];
+            if (worker.in_flight.empty()) {
+                worker.started = Clock::now();
+            }
+            worker.in_flight.push_back(unit);
+            sent = true;
+        }
+    }
+}
+
+bool Coordinator::handle_message(Connection& worker) {
+    auto message = receive_message(worker.socket);
+    if (!message) {
+        return false;
+    }
+
+    uint64_t id{};
+    if (message->type == MessageType::result) {
+        auto [unit_id, part] = decode_result(message->payload);
+        id                   = unit_id;
+        if (worker.in_flight.empty() || worker.in_flight.front() != id) {
+            throw std::runtime_error{"unexpected result for unit " + std::to_string(id)};
+        }
+        const auto& tile = units[id].tile;
+        const auto& w    = part.get_window();
+        if (w.x0 != tile.x0 || w.y0 != tile.y0 || w.x1 != tile.x1 || w.y1 != tile.y1) {
+            throw std::runtime_error{"result doesn't match unit " + std::to_string(id)};
+        }
+        if (!done[id]) {
+            film.merge(part);
+            done[id] = true;
+            ++done_count;
+        }
+        std::cout << "units remaining: " << std::setw(5) << units.size() - done_count << "\r"
+                  << std::flush;
+    } else if (message->type == MessageType::failed) {
+        auto [unit_id, error] = decode_failure(message->payload);
+        id                    = unit_id;
+        if (worker.in_flight.empty() || worker.in_flight.front() != id) {
+            throw std::runtime_error{"unexpected failure of unit " + std::to_string(id)};
+        }
+        retry_unit(id, error);
+    } else {
+        throw std::runtime_error{"unexpected message from worker"};
+    }
+
+    worker.in_flight.pop_front();
+    worker.started = Clock::now();
+    return true;
+}
+
+void Coordinator::fail_worker(size_t index, const std::string& reason) {
+    std::cerr << "dropping worker: " << reason << "\n";
+    for (auto unit : workers[index].in_flight) {
+        retry_unit(unit, reason);
+    }
+    workers.erase(workers.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+void Coordinator::retry_unit(size_t unit, const std::string& reason) {
+    if (attempts[unit] >= options.max_attempts) {
+        // Ends the render from its loop, not as a failure of the worker that reported it
+        if (exhausted.empty()) {
+            exhausted = "unit " + std::to_string(unit) + " failed " +
+                        std::to_string(attempts[unit]) + " times: " + reason;
+        }
+        return;
+    }
+    // Retry before the rest, the image is done only once every unit is
+    pending.push_front(unit);
+    ++retry_count;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "film.h"
+#include "protocol.h"
+#include "socket.h"
+
+struct CoordinatorOptions {
+    int tile_size{32};
+
+    /// Units per tile, each taking a share of the samples
+    size_t sample_splits{1};
+
+    /// Units sent to a worker before its first result comes back, hides the network round trip
+    size_t units_per_worker{2};
+
+    /// A worker that takes longer for one unit is dropped and its units retried elsewhere.
+    /// Zero waits forever.
+    double unit_timeout{};
+
+    /// Times a unit is handed out before the render gives up on it
+    size_t max_attempts{3};
+};
+
+// Hands out the work units of an image to worker processes and merges the returned partial films.
+// Workers connect at any time, also during a render, and stay connected for later renders. Each
+// worker pulls units as fast as it finishes them, so faster machines take a larger share. Units of
+// a worker that disconnects, fails a unit or times out are queued again for the others.
+class Coordinator {
+  public:
+    /// @brief Listen for workers at 'address', see socket.h for the format
+    explicit Coordinator(const std::string& address, const CoordinatorOptions& options = {});
+
+    /// Tells the connected workers to exit
+    ~Coordinator();
+
+    Coordinator(const Coordinator&)            = delete;
+    Coordinator& operator=(const Coordinator&) = delete;
+
+    /// Address workers connect to
+    const std::string& get_address() const { return listener.get_address(); }
+
+    size_t worker_count() const { return workers.size(); }
+
+    /// Units queued again after a failure, over all renders
+    size_t get_retry_count() const { return retry_count; }
+
+    /// @brief Render every unit of the image and return the merged film. Blocks until all units
+    /// are done. Throws std::runtime_error once a unit failed max_attempts times.
+    Film render(const RenderSetup& setup, size_t samples_per_pixel);
+
+    void shutdown_workers();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection {
+        Socket socket;
+        std::deque<size_t> in_flight;  // unit indices in the order they were sent
+        Clock::time_point started;     // of the oldest unit in flight
+        std::string setup;             // last setup sent
+    };
+
+    void accept_worker();
+
+    /// Send queued units to workers with free slots
+    void dispatch(const std::string& setup);
+
+    /// @brief Read one message of a worker. Returns false if the worker is gone.
+    bool handle_message(Connection& worker);
+
+    /// Drop a worker and queue its units again
+    void fail_worker(size_t index, const std::string& reason);
+
+    void retry_unit(size_t unit, const std::string& reason);
+
+    CoordinatorOptions options;
+    ListenSocket listener;
+    std::vector<Connection> workers;
+
+    // State of the current render
+    std::vector<WorkUnit> units;
+    std::vector<size_t> attempts;
+    std::vector<bool> done;
+    std::deque<size_t> pending;
+    size_t done_count{};
+    std::string exhausted;  // error of a unit out of attempts, ends the render
+    size_t retry_count{};
+    Film film;
+};
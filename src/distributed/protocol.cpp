@@ -0,0 +1,153 @@
+#include "protocol.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t message_magic{0x56334d47};  // "V3MG"
+constexpr uint64_t max_payload_size{uint64_t{1} << 32};
+
+struct MessageHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t size;
+};
+
+// Text payloads, one field per line so paths may contain spaces
+std::istringstream payload_stream(const std::string& payload, const char* what) {
+    std::istringstream in{payload};
+    if (payload.empty()) {
+        throw std::runtime_error{std::string{"empty "} + what + " message"};
+    }
+    return in;
+}
+
+void check(const std::istream& in, const char* what) {
+    if (in.fail()) {
+        throw std::runtime_error{std::string{"malformed "} + what + " message"};
+    }
+}
+
+}  // namespace
+
+void send_message(Socket& socket, MessageType type, const std::string& payload) {
+    MessageHeader header{message_magic, static_cast<uint32_t>(type), payload.size()};
+    socket.send_all(&header, sizeof(header));
+    socket.send_all(payload.data(), payload.size());
+}
+
+std::optional<Message> receive_message(Socket& socket) {
+    MessageHeader header{};
+    if (!socket.receive_all(&header, sizeof(header))) {
+        return std::nullopt;
+    }
+    if (header.magic != message_magic || header.size > max_payload_size) {
+        throw std::runtime_error{"malformed message header"};
+    }
+
+    Message message{static_cast<MessageType>(header.type), {}};
+    message.payload.resize(header.size);
+    if (header.size > 0 && !socket.receive_all(message.payload.data(), header.size)) {
+        throw std::runtime_error{"connection closed mid message"};
+    }
+    return message;
+}
+
+std::string encode_setup(const RenderSetup& setup) {
+    std::ostringstream out;
+    out << setup.scene << "\n"
+        << setup.image_width << " " << setup.image_height << " "
+        << static_cast<unsigned>(setup.aovs) << " " << setup.seed << "\n";
+    out << setup.path_policy << " "
+        << (setup.light_sampling ? static_cast<int>(*setup.light_sampling) : -1) << "\n";
+    return out.str();
+}
+
+RenderSetup decode_setup(const std::string& payload) {
+    auto in = payload_stream(payload, "setup");
+    RenderSetup setup;
+    unsigned aovs{};
+    std::getline(in, setup.scene);
+    in >> setup.image_width >> setup.image_height >> aovs >> setup.seed;
+    int light_sampling{};
+    in >> setup.path_policy >> light_sampling;
+    check(in, "setup");
+    if (light_sampling >= 0) {
+        setup.light_sampling = static_cast<LightSampling>(light_sampling);
+    }
+    setup.aovs = static_cast<AovType>(aovs);
+    return setup;
+}
+
+std::string encode_work_unit(const WorkUnit& unit) {
+    std::ostringstream out;
+    out << unit.id << " " << unit.tile.x0 << " " << unit.tile.y0 << " " << unit.tile.x1 << " "
+        << unit.tile.y1 << " " << unit.samples << " " << unit.first_sample;
+    return out.str();
+}
+
+WorkUnit decode_work_unit(const std::string& payload) {
+    auto in = payload_stream(payload, "work");
+    WorkUnit unit;
+    in >> unit.id >> unit.tile.x0 >> unit.tile.y0 >> unit.tile.x1 >> unit.tile.y1 >>
+        unit.samples >> unit.first_sample;
+    check(in, "work");
+    return unit;
+}
+
+std::string encode_result(uint64_t unit_id, const Film& film) {
+    std::ostringstream out;
+    out << unit_id << "\n";
+    film.write(out);
+    return out.str();
+}
+
+std::pair<uint64_t, Film> decode_result(const std::string& payload) {
+    auto in = payload_stream(payload, "result");
+    uint64_t id{};
+    in >> id;
+    in.ignore(1);
+    check(in, "result");
+    return {id, Film::read(in)};
+}
+
+std::string encode_failure(uint64_t unit_id, const std::string& error) {
+    return std::to_string(unit_id) + "\n" + error;
+}
+
+std::pair<uint64_t, std::string> decode_failure(const std::string& payload) {
+    auto in = payload_stream(payload, "failed");
+    uint64_t id{};
+    std::string error;
+    in >> id;
+    in.ignore(1);
+    check(in, "failed");
+    std::getline(in, error, '\0');
+    return {id, error};
+}
+
+std::vector<WorkUnit> make_work_units(
+    int width, int height, int tile_size, size_t samples_per_pixel, size_t sample_splits) {
+    if (tile_size <= 0 || sample_splits == 0) {
+        throw std::runtime_error{"tile size and sample splits must be positive"};
+    }
+    sample_splits = std::min(sample_splits, samples_per_pixel);
+
+    std::vector<WorkUnit> units;
+    for (int y0{}; y0 < height; y0 += tile_size) {
+        for (int x0{}; x0 < width; x0 += tile_size) {
+            ImageTile tile{x0, y0, std::min(x0 + tile_size, width), std::min(y0 + tile_size, height)};
+            size_t first{};
+            for (size_t i{}; i < sample_splits; ++i) {
+                // Spread the remainder over the first ranges
+                size_t count = samples_per_pixel / sample_splits +
+                               (i < samples_per_pixel % sample_splits ? 1 : 0);
+                units.push_back({units.size(), tile, count, first});
+                first += count;
+            }
+        }
+    }
+    return units;
+}
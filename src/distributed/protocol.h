@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "aov.h"
+#include "camera.h"
+#include "film.h"
+#include "light.h"
+#include "socket.h"
+
+// Coordinator / worker protocol
+// -----------------------------
+// Every message is a fixed header (magic, type, payload size) followed by the payload.
+//
+//   coordinator -> worker: setup     scene to render and the image settings
+//   coordinator -> worker: work      one work unit, answered with result or failed
+//   worker -> coordinator: result    unit id and the partial film of the unit
+//   worker -> coordinator: failed    unit id and an error message
+//   coordinator -> worker: shutdown  the worker exits
+//
+// A worker keeps every scene it has loaded, so later setups for the same scene are cheap.
+
+enum class MessageType : uint32_t { setup = 1, work, result, failed, shutdown };
+
+struct Message {
+    MessageType type{};
+    std::string payload;
+};
+
+/// @brief Send one message. Throws std::runtime_error if the peer has gone away.
+void send_message(Socket& socket, MessageType type, const std::string& payload = {});
+
+/// @brief Receive one message, nullopt if the peer closed the connection. Throws
+/// std::runtime_error on malformed messages.
+std::optional<Message> receive_message(Socket& socket);
+
+// What every work unit of one image renders
+struct RenderSetup {
+    std::string scene;  // path, workers share the file system with the coordinator
+    int image_width{};
+    int image_height{};
+    AovType aovs{AovType::none};
+    uint64_t seed{};
+
+    // Path tracer options, see PathTracer
+    std::string path_policy{"constant"};  // see create_path_policy
+    std::optional<LightSampling> light_sampling;  // else each light's default
+};
+
+// Samples [first_sample, first_sample + samples) of the pixels in 'tile'
+struct WorkUnit {
+    uint64_t id{};
+    ImageTile tile;
+    size_t samples{};
+    size_t first_sample{};
+};
+
+std::string encode_setup(const RenderSetup& setup);
+RenderSetup decode_setup(const std::string& payload);
+
+std::string encode_work_unit(const WorkUnit& unit);
+WorkUnit decode_work_unit(const std::string& payload);
+
+std::string encode_result(uint64_t unit_id, const Film& film);
+std::pair<uint64_t, Film> decode_result(const std::string& payload);
+
+std::string encode_failure(uint64_t unit_id, const std::string& error);
+std::pair<uint64_t, std::string> decode_failure(const std::string& payload);
+
+/// @brief Split an image into square tiles of 'tile_size' pixels, each rendered in
+/// 'sample_splits' units of about spp / sample_splits samples.
+std::vector<WorkUnit> make_work_units(
+    int width, int height, int tile_size, size_t samples_per_pixel, size_t sample_splits = 1);
@@ -0,0 +1,220 @@
+#include "socket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char unix_prefix[] = "unix:";
+
+std::runtime_error socket_error(const std::string& what) {
+    return std::runtime_error{what + ": " + std::strerror(errno)};
+}
+
+bool is_unix_address(const std::string& address) {
+    return address.rfind(unix_prefix, 0) == 0;
+}
+
+sockaddr_un unix_socket_address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error{"invalid unix socket path '" + path + "'"};
+    }
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+std::pair<std::string, std::string> split_host_port(const std::string& address) {
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size()) {
+        throw std::runtime_error{"address '" + address + "' expects host:port or unix:path"};
+    }
+    auto host = address.substr(0, colon);
+    return {host.empty() ? "127.0.0.1" : host, address.substr(colon + 1)};
+}
+
+// Resolved TCP addresses, freed on destruction
+struct AddressList {
+    AddressList(const std::string& address, bool passive) {
+        auto [host, port] = split_host_port(address);
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags    = passive ? AI_PASSIVE : 0;
+        if (int err = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &list); err != 0) {
+            throw std::runtime_error{"can't resolve '" + address + "': " + ::gai_strerror(err)};
+        }
+    }
+
+    ~AddressList() { ::freeaddrinfo(list); }
+
+    addrinfo* list{};
+};
+
+// Work units and results are small messages in a request/response pattern
+void disable_nagle(int fd) {
+    int on{1};
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+}  // namespace
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd       = other.fd;
+        other.fd = -1;
+    }
+    return *this;
+}
+
+Socket Socket::connect(const std::string& address) {
+    if (is_unix_address(address)) {
+        auto addr = unix_socket_address(address.substr(sizeof(unix_prefix) - 1));
+        Socket socket{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        if (!socket.is_open()) {
+            throw socket_error("socket");
+        }
+        if (::connect(socket.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            throw socket_error("can't connect to " + address);
+        }
+        return socket;
+    }
+
+    AddressList addresses{address, false};
+    for (auto* ai = addresses.list; ai; ai = ai->ai_next) {
+        Socket socket{::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)};
+        if (socket.is_open() && ::connect(socket.fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            disable_nagle(socket.fd);
+            return socket;
+        }
+    }
+    throw socket_error("can't connect to " + address);
+}
+
+void Socket::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void Socket::send_all(const void* data, size_t size) {
+    const auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+        // No SIGPIPE for a vanished peer, report it as an error instead
+        auto n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw socket_error("send");
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+bool Socket::receive_all(void* data, size_t size) {
+    auto* p = static_cast<char*>(data);
+    size_t received{};
+    while (received < size) {
+        auto n = ::recv(fd, p + received, size - received, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw socket_error("receive");
+        }
+        if (n == 0) {
+            if (received == 0) {
+                return false;
+            }
+            throw std::runtime_error{"receive: connection closed mid message"};
+        }
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+ListenSocket::ListenSocket(const std::string& address) {
+    if (is_unix_address(address)) {
+        unix_path = address.substr(sizeof(unix_prefix) - 1);
+        auto addr = unix_socket_address(unix_path);
+        fd        = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw socket_error("socket");
+        }
+        // A stale socket file of a previous run would make bind fail
+        ::unlink(unix_path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(fd, SOMAXCONN) != 0) {
+            auto error = socket_error("can't listen on " + address);
+            ::close(fd);
+            throw error;
+        }
+        this->address = address;
+        return;
+    }
+
+    AddressList addresses{address, true};
+    for (auto* ai = addresses.list; ai && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int on{1};
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        throw socket_error("can't listen on " + address);
+    }
+
+    // Report the port actually bound, in case 0 was asked for
+    sockaddr_storage bound{};
+    socklen_t length = sizeof(bound);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &length);
+    int port = bound.ss_family == AF_INET6
+                   ? ntohs(reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port)
+                   : ntohs(reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+    this->address = split_host_port(address).first + ":" + std::to_string(port);
+}
+
+ListenSocket::~ListenSocket() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!unix_path.empty()) {
+        ::unlink(unix_path.c_str());
+    }
+}
+
+Socket ListenSocket::accept() {
+    while (true) {
+        // Close on exec like every socket here, so spawned workers don't inherit connections
+        int client = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client >= 0) {
+            if (unix_path.empty()) {
+                disable_nagle(client);
+            }
+            return Socket{client};
+        }
+        if (errno != EINTR) {
+            throw socket_error("accept");
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Thin wrappers over POSIX stream sockets. Addresses are either "unix:<path>" for a Unix domain
+// socket or "<host>:<port>" for TCP. Errors throw std::runtime_error.
+
+// Connected socket, closed on destruction
+class Socket {
+  public:
+    Socket() = default;
+
+    explicit Socket(int fd) : fd{fd} {}
+
+    ~Socket() { close(); }
+
+    Socket(Socket&& other) noexcept : fd{other.fd} { other.fd = -1; }
+
+    Socket& operator=(Socket&& other) noexcept;
+
+    Socket(const Socket&)            = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    /// @brief Connect to a listening socket. Throws if nobody listens at 'address'.
+    static Socket connect(const std::string& address);
+
+    bool is_open() const { return fd >= 0; }
+
+    int get_fd() const { return fd; }
+
+    void close();
+
+    /// @brief Send all 'size' bytes. Throws if the peer has gone away.
+    void send_all(const void* data, size_t size);
+
+    /// @brief Receive exactly 'size' bytes. Returns false if the peer closed the connection before
+    /// the first byte, throws if it closed in the middle.
+    bool receive_all(void* data, size_t size);
+
+  private:
+    int fd{-1};
+};
+
+// Socket accepting connections, a Unix socket file is removed again on destruction
+class ListenSocket {
+  public:
+    /// @brief Bind and listen. TCP port 0 picks a free port, see get_address().
+    explicit ListenSocket(const std::string& address);
+
+    ~ListenSocket();
+
+    ListenSocket(const ListenSocket&)            = delete;
+    ListenSocket& operator=(const ListenSocket&) = delete;
+
+    /// Address clients connect to, with the actual port
+    const std::string& get_address() const { return address; }
+
+    int get_fd() const { return fd; }
+
+    /// Wait for the next connection
+    Socket accept();
+
+  private:
+    int fd{-1};
+    std::string address;
+    std::string unix_path;
+};
@@ -0,0 +1,71 @@
+#include "worker.h"
+
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+#include "pathtracer.h"
+#include "profiler.h"
+#include "scene_cache.h"
+
+const SceneDescription& Worker::get_scene(const std::string& path) {
+    auto it = scenes.find(path);
+    if (it == scenes.end()) {
+        it = scenes.emplace(path, load_scene_cached(path)).first;
+    }
+    return it->second;
+}
+
+Film Worker::render_unit(const RenderSetup& setup, const WorkUnit& unit) {
+    PROFILE_ZONE("work_unit");
+    const auto& desc = get_scene(setup.scene);
+    // The scene stays loaded across setups, so unset modes restore the defaults
+    desc.scene->set_light_sampling(setup.light_sampling);
+
+    Camera camera = *desc.camera;
+    camera.set_aspect_ratio(static_cast<double>(setup.image_width) / setup.image_height);
+
+    PathTracer renderer{setup.image_width, setup.image_height, std::make_shared<PixelSampler>(),
+                        unit.samples};
+    renderer.load_scene(desc.scene);
+    renderer.set_aovs(setup.aovs);
+    renderer.set_seed(setup.seed);
+    renderer.set_path_policy(create_path_policy(setup.path_policy));
+    renderer.set_first_sample(unit.first_sample);
+    renderer.set_crop_window(unit.tile);
+    renderer.render(camera);
+    return renderer.get_film();
+}
+
+void Worker::run(const std::string& address) {
+    auto socket = Socket::connect(address);
+    std::cout << "worker connected to " << address << "\n";
+
+    std::optional<RenderSetup> setup;
+    while (auto message = receive_message(socket)) {
+        if (message->type == MessageType::shutdown) {
+            break;
+        }
+        if (message->type == MessageType::setup) {
+            setup = decode_setup(message->payload);
+            continue;
+        }
+        if (message->type != MessageType::work) {
+            throw std::runtime_error{"unexpected message from coordinator"};
+        }
+
+        auto unit = decode_work_unit(message->payload);
+        std::string payload;
+        try {
+            if (!setup) {
+                throw std::runtime_error{"work unit before setup"};
+            }
+            payload = encode_result(unit.id, render_unit(*setup, unit));
+        } catch (const std::exception& e) {
+            // Let the coordinator retry elsewhere, this worker stays available
+            send_message(socket, MessageType::failed, encode_failure(unit.id, e.what()));
+            continue;
+        }
+        send_message(socket, MessageType::result, payload);
+    }
+}
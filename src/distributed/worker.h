@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "film.h"
+#include "protocol.h"
+#include "scene_loader.h"
+
+// Renders work units for a Coordinator. Scenes are loaded once on first use and kept, so a worker
+// serves every frame and tile of a scene without loading it again. Renders run on the global
+// thread pool.
+class Worker {
+  public:
+    /// @brief Connect to the coordinator at 'address' and serve work units until it shuts the
+    /// worker down or disconnects. Throws std::runtime_error if the connection fails.
+    void run(const std::string& address);
+
+    /// @brief Render one unit into a film covering its tile
+    Film render_unit(const RenderSetup& setup, const WorkUnit& unit);
+
+  private:
+    const SceneDescription& get_scene(const std::string& path);
+
+    std::unordered_map<std::string, SceneDescription> scenes;
+};
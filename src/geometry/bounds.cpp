@@ -0,0 +1,51 @@
+#include "bounds.h"
+
+#include <algorithm>
+
+double Bounds3::surface_area() const {
+    if (is_empty()) {
+        return 0.0;
+    }
+    auto [dx, dy, dz] = components(extent());
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+}
+
+void Bounds3::expand(const Vec3& p) {
+    for (size_t i{}; i < 3; ++i) {
+        min[i] = std::min(min[i], p[i]);
+        max[i] = std::max(max[i], p[i]);
+    }
+}
+
+void Bounds3::expand(const Bounds3& b) {
+    if (b.is_empty()) {
+        return;
+    }
+    expand(b.min);
+    expand(b.max);
+}
+
+void Bounds3::pad(double margin) {
+    min -= Vec3::all(margin);
+    max += Vec3::all(margin);
+}
+
+Bounds3 merged(const Bounds3& a, const Bounds3& b) {
+    Bounds3 res{a};
+    res.expand(b);
+    return res;
+}
+
+Bounds3 transform_bounds(const Transform& transform, const Bounds3& b) {
+    Bounds3 res;
+    if (b.is_empty()) {
+        return res;
+    }
+    for (int corner{}; corner < 8; ++corner) {
+        Vec3 p{(corner & 1) ? b.max.x() : b.min.x(),
+               (corner & 2) ? b.max.y() : b.min.y(),
+               (corner & 4) ? b.max.z() : b.min.z()};
+        res.expand(transform.on_point(p));
+    }
+    return res;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ray.h"
+#include "transform.h"
+#include "vec.h"
+
+// Axis-aligned bounding box
+struct Bounds3 {
+    Vec3 min{Vec3::all(inf_bound)};
+    Vec3 max{Vec3::all(-inf_bound)};
+
+    bool is_empty() const { return min.x() > max.x() || min.y() > max.y() || min.z() > max.z(); }
+
+    Vec3 centroid() const { return 0.5 * (min + max); }
+
+    Vec3 extent() const { return max - min; }
+
+    double surface_area() const;
+
+    void expand(const Vec3& p);
+
+    void expand(const Bounds3& b);
+
+    // Grow every side by 'margin' so flat shapes still have a volume
+    void pad(double margin);
+
+    static constexpr double inf_bound{1.0e300};
+};
+
+Bounds3 merged(const Bounds3& a, const Bounds3& b);
+
+// Bounding box of the transformed corners of 'b'
+Bounds3 transform_bounds(const Transform& transform, const Bounds3& b);
+
+/// @brief Slab test against a ray. 'inv_d' is the componentwise reciprocal of ray.d
+/// @return true if the ray overlaps the box somewhere in [tmin, tmax]
+inline bool hit_bounds(const double* bmin,
+                       const double* bmax,
+                       const Ray& ray,
+                       const Vec3& inv_d,
+                       double tmin,
+                       double tmax) {
+    for (size_t a{}; a < 3; ++a) {
+        double t0 = (bmin[a] - ray.o[a]) * inv_d[a];
+        double t1 = (bmax[a] - ray.o[a]) * inv_d[a];
+        if (inv_d[a] < 0.0) {
+            std::swap(t0, t1);
+        }
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+        if (tmax < tmin) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,244 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "profiler.h"
+#include "utils.h"
+
+namespace {
+
+constexpr size_t max_leaf_size{4};
+constexpr size_t bucket_count{12};
+
+// Lopsided SAH trees, e.g. over exponentially spaced primitives, may peel off a few primitives
+// per level. Below this depth median splits keep the tree within Bvh::max_depth for any
+// 32 bit primitive count.
+constexpr size_t max_sah_depth{Bvh::max_depth / 2};
+
+void set_node_bounds(BvhNode& node, const Bounds3& b) {
+    for (size_t i{}; i < 3; ++i) {
+        node.bounds_min[i] = b.min[i];
+        node.bounds_max[i] = b.max[i];
+    }
+}
+
+Bounds3 get_node_bounds(const BvhNode& node) {
+    return {{node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]},
+            {node.bounds_max[0], node.bounds_max[1], node.bounds_max[2]}};
+}
+
+}  // namespace
+
+void Bvh::build(const std::vector<Bounds3>& primitive_bounds) {
+    PROFILE_ZONE("bvh_build");
+    clear();
+    if (primitive_bounds.empty()) {
+        return;
+    }
+
+    std::vector<Vec3> centroids;
+    centroids.reserve(primitive_bounds.size());
+    for (const auto& b : primitive_bounds) {
+        centroids.push_back(b.centroid());
+    }
+
+    std::vector<uint32_t> order(primitive_bounds.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    node_storage.reserve(2 * primitive_bounds.size());
+    build_recursive(order, primitive_bounds, centroids, 0, order.size(), 1);
+    index_storage = std::move(order);
+
+    nodes       = node_storage.data();
+    node_count  = node_storage.size();
+    indices     = index_storage.data();
+    index_count = index_storage.size();
+}
+
+void Bvh::assign(const BvhNode* nodes,
+                 size_t node_count,
+                 const uint32_t* indices,
+                 size_t index_count,
+                 std::shared_ptr<const void> owner) {
+    clear();
+    external_owner    = std::move(owner);
+    this->nodes       = nodes;
+    this->node_count  = node_count;
+    this->indices     = indices;
+    this->index_count = index_count;
+}
+
+void Bvh::clear() {
+    node_storage.clear();
+    index_storage.clear();
+    external_owner.reset();
+    nodes       = nullptr;
+    node_count  = 0;
+    indices     = nullptr;
+    index_count = 0;
+}
+
+void Bvh::refit(const std::vector<Bounds3>& primitive_bounds) {
+    PROFILE_ZONE("bvh_refit");
+    if (empty()) {
+        return;
+    }
+    make_owned();
+
+    // Children always follow their parent in the depth first layout, so a reverse sweep visits
+    // them before the parent
+    for (size_t i{node_count}; i-- > 0;) {
+        auto& node = node_storage[i];
+        Bounds3 bounds;
+        if (node.primitive_count > 0) {
+            for (uint32_t j{}; j < node.primitive_count; ++j) {
+                bounds.expand(primitive_bounds[index_storage[node.offset + j]]);
+            }
+        } else {
+            bounds.expand(get_node_bounds(node_storage[i + 1]));
+            bounds.expand(get_node_bounds(node_storage[node.offset]));
+        }
+        set_node_bounds(node, bounds);
+    }
+}
+
+double Bvh::sah_cost() const {
+    if (empty()) {
+        return 0.0;
+    }
+
+    // Same constants as the split selection: traversal 0.125, primitive test 1
+    double root_area = std::max(get_node_bounds(nodes[0]).surface_area(), 1.0e-12);
+    double cost{};
+    for (size_t i{}; i < node_count; ++i) {
+        const auto& node = nodes[i];
+        double weight = node.primitive_count > 0 ? static_cast<double>(node.primitive_count) : 0.125;
+        cost += weight * get_node_bounds(node).surface_area() / root_area;
+    }
+    return cost;
+}
+
+void Bvh::make_owned() {
+    if (!external_owner) {
+        return;
+    }
+    node_storage.assign(nodes, nodes + node_count);
+    index_storage.assign(indices, indices + index_count);
+    external_owner.reset();
+    nodes   = node_storage.data();
+    indices = index_storage.data();
+}
+
+uint32_t Bvh::build_recursive(std::vector<uint32_t>& order,
+                              const std::vector<Bounds3>& primitive_bounds,
+                              const std::vector<Vec3>& centroids,
+                              size_t begin,
+                              size_t end,
+                              size_t depth) {
+    auto node_idx = static_cast<uint32_t>(node_storage.size());
+    node_storage.push_back({});
+
+    Bounds3 bounds;
+    Bounds3 centroid_bounds;
+    for (size_t i{begin}; i < end; ++i) {
+        bounds.expand(primitive_bounds[order[i]]);
+        centroid_bounds.expand(centroids[order[i]]);
+    }
+    set_node_bounds(node_storage[node_idx], bounds);
+
+    auto make_leaf = [&]() {
+        auto& node           = node_storage[node_idx];
+        node.offset          = static_cast<uint32_t>(begin);
+        node.primitive_count = static_cast<uint16_t>(end - begin);
+        node.axis            = 0;
+        return node_idx;
+    };
+
+    size_t count = end - begin;
+    if (count <= 1) {
+        return make_leaf();
+    }
+
+    auto extent = centroid_bounds.extent();
+    size_t axis = vec_absmax_idx(extent);
+    size_t mid  = begin + count / 2;
+
+    if (extent[axis] <= 0.0 || depth >= max_sah_depth) {
+        // All centroids coincide and no split can separate them, or the tree is deep enough
+        // that only median splits are left
+        if (count <= max_leaf_size) {
+            return make_leaf();
+        }
+    } else {
+        // ----------- Binned SAH split -----------
+        struct Bucket {
+            size_t count{};
+            Bounds3 bounds;
+        };
+        Bucket buckets[bucket_count];
+
+        auto bucket_of = [&](uint32_t prim) {
+            double rel = (centroids[prim][axis] - centroid_bounds.min[axis]) / extent[axis];
+            auto b     = static_cast<size_t>(rel * bucket_count);
+            return std::min(b, bucket_count - 1);
+        };
+
+        for (size_t i{begin}; i < end; ++i) {
+            auto& bucket = buckets[bucket_of(order[i])];
+            ++bucket.count;
+            bucket.bounds.expand(primitive_bounds[order[i]]);
+        }
+
+        double best_cost{std::numeric_limits<double>::infinity()};
+        size_t best_split{};
+        for (size_t split{}; split < bucket_count - 1; ++split) {
+            Bounds3 left;
+            Bounds3 right;
+            size_t left_count{};
+            size_t right_count{};
+            for (size_t i{}; i <= split; ++i) {
+                left.expand(buckets[i].bounds);
+                left_count += buckets[i].count;
+            }
+            for (size_t i{split + 1}; i < bucket_count; ++i) {
+                right.expand(buckets[i].bounds);
+                right_count += buckets[i].count;
+            }
+            double cost = 0.125 + (static_cast<double>(left_count) * left.surface_area() +
+                                   static_cast<double>(right_count) * right.surface_area()) /
+                                      bounds.surface_area();
+            if (cost < best_cost) {
+                best_cost  = cost;
+                best_split = split;
+            }
+        }
+
+        if (count <= max_leaf_size && best_cost >= static_cast<double>(count)) {
+            return make_leaf();
+        }
+
+        auto mid_it = std::partition(order.begin() + begin,
+                                     order.begin() + end,
+                                     [&](uint32_t prim) { return bucket_of(prim) <= best_split; });
+        mid         = static_cast<size_t>(mid_it - order.begin());
+    }
+
+    if (mid == begin || mid == end) {
+        mid = begin + count / 2;
+        std::nth_element(order.begin() + begin,
+                         order.begin() + mid,
+                         order.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    build_recursive(order, primitive_bounds, centroids, begin, mid, depth + 1);
+    auto second = build_recursive(order, primitive_bounds, centroids, mid, end, depth + 1);
+
+    auto& node           = node_storage[node_idx];
+    node.offset          = second;
+    node.primitive_count = 0;
+    node.axis            = static_cast<uint16_t>(axis);
+    return node_idx;
+}
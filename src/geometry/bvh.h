@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bounds.h"
+#include "ray.h"
+#include "stats.h"
+
+// Flattened BVH node, laid out depth first. Plain data so a node array can be written to and
+// used straight from a scene cache file.
+struct BvhNode {
+    double bounds_min[3];
+    double bounds_max[3];
+
+    /// Interior: index of the second child (the first child directly follows this node)
+    /// Leaf: index of the first primitive in the primitive index array
+    uint32_t offset;
+
+    /// Number of primitives, zero for interior nodes
+    uint16_t primitive_count;
+
+    /// Split axis of interior nodes, used to visit the nearer child first
+    uint16_t axis;
+};
+
+class Bvh {
+  public:
+    /// Deepest a tree gets, and the size of the traversal stack. Builds switch from SAH to
+    /// median splits halfway down, which halve the primitives each level.
+    static constexpr size_t max_depth{64};
+
+    Bvh() = default;
+
+    // Node pointers may refer to the owned storage, so only moves are allowed
+    Bvh(const Bvh&)                = delete;
+    Bvh& operator=(const Bvh&)     = delete;
+    Bvh(Bvh&&) noexcept            = default;
+    Bvh& operator=(Bvh&&) noexcept = default;
+    ~Bvh()                         = default;
+
+    /// @brief Build over primitives given by their world space bounds. Primitive indices passed to
+    /// the intersection callback are positions in 'primitive_bounds'.
+    void build(const std::vector<Bounds3>& primitive_bounds);
+
+    /// @brief Use externally owned node and index arrays, e.g. mapped from a scene cache. 'owner'
+    /// is kept alive as long as this BVH references the arrays.
+    void assign(const BvhNode* nodes,
+                size_t node_count,
+                const uint32_t* indices,
+                size_t index_count,
+                std::shared_ptr<const void> owner);
+
+    void clear();
+
+    /// @brief Recompute node bounds bottom up after primitives moved, keeping the tree topology.
+    /// 'primitive_bounds' must hold the same primitives as the last build. Mapped arrays are
+    /// copied into owned storage first.
+    void refit(const std::vector<Bounds3>& primitive_bounds);
+
+    /// @brief Surface area heuristic cost of the current tree, relative to the root area. Refits
+    /// keep the topology, so the cost grows as primitives move away from their build positions.
+    double sah_cost() const;
+
+    bool empty() const { return node_count == 0; }
+
+    size_t get_node_count() const { return node_count; }
+
+    size_t get_primitive_count() const { return index_count; }
+
+    const BvhNode* get_nodes() const { return nodes; }
+
+    const uint32_t* get_indices() const { return indices; }
+
+    /// @brief Visit the primitives whose node bounds overlap the ray in [tmin, tmax], nearest
+    /// subtrees first. 'hit_primitive(index, tmax)' returns true and shrinks tmax on a hit.
+    template <typename F>
+    bool intersect(const Ray& ray, double tmin, double tmax, F&& hit_primitive) const;
+
+  private:
+    void make_owned();
+
+    uint32_t build_recursive(std::vector<uint32_t>& order,
+                             const std::vector<Bounds3>& primitive_bounds,
+                             const std::vector<Vec3>& centroids,
+                             size_t begin,
+                             size_t end,
+                             size_t depth);
+
+    std::vector<BvhNode> node_storage;
+    std::vector<uint32_t> index_storage;
+    std::shared_ptr<const void> external_owner;
+
+    const BvhNode* nodes{};
+    size_t node_count{};
+    const uint32_t* indices{};
+    size_t index_count{};
+};
+
+template <typename F>
+bool Bvh::intersect(const Ray& ray, double tmin, double tmax, F&& hit_primitive) const {
+    if (empty()) {
+        return false;
+    }
+
+    Vec3 inv_d{1.0 / ray.d.x(), 1.0 / ray.d.y(), 1.0 / ray.d.z()};
+    bool dir_neg[3] = {inv_d.x() < 0, inv_d.y() < 0, inv_d.z() < 0};
+
+    bool any_hit{false};
+    uint32_t stack[max_depth];
+    size_t stack_size{};
+    uint32_t current{0};
+    uint64_t visited{};
+
+    while (true) {
+        ++visited;
+        const auto& node = nodes[current];
+        if (hit_bounds(node.bounds_min, node.bounds_max, ray, inv_d, tmin, tmax)) {
+            if (node.primitive_count > 0) {
+                for (uint32_t i{}; i < node.primitive_count; ++i) {
+                    if (hit_primitive(indices[node.offset + i], tmax)) {
+                        any_hit = true;
+                    }
+                }
+            } else if (dir_neg[node.axis]) {
+                stack[stack_size++] = current + 1;
+                current             = node.offset;
+                continue;
+            } else {
+                stack[stack_size++] = node.offset;
+                current             = current + 1;
+                continue;
+            }
+        }
+
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+
+    thread_stats().bvh_node_visits += visited;
+    return any_hit;
+}
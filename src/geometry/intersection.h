@@ -27,9 +27,15 @@ struct SurfaceIntersection {
     /// Inverse direction of incident light
     Vec3 incident;
 
+    /// Surface parameterization of the hit shape, for texture lookups
+    Vec2 uv{0, 0};
+
     /// Pointer to the object with which the ray intersect
     std::variant<std::shared_ptr<Geometry>, std::shared_ptr<Light>> intersection;
 
+    /// Index of the hit object in its scene, lights are numbered after all objects
+    size_t scene_index{};
+
     bool is_light() const;
 
     bool is_geometry() const;
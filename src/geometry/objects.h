@@ -34,6 +34,10 @@ class Geometry {
         return transformed_shape->hit(ray, tmin, tmax);
     }
 
+    Bounds3 bounds() const { return transformed_shape->bounds(); }
+
+    void set_transform(const Transform& transform) { transformed_shape->set_transform(transform); }
+
     std::string name() const;
 
     std::shared_ptr<TransformedShape> get_transformed_shape() const { return transformed_shape; }
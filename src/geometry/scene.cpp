@@ -1,10 +1,12 @@
 #include "scene.h"
 
-#include <random>
+
+#include "stats.h"
 
 
 TestScene::TestScene() {
     init_scene3();
+    build_accelerator();
 }
 
 std::optional<SurfaceIntersection> TestScene::hit(const Ray& ray) const {
@@ -12,41 +14,128 @@ std::optional<SurfaceIntersection> TestScene::hit(const Ray& ray) const {
 }
 
 std::optional<SurfaceIntersection> TestScene::hit(const Ray& ray, double tmin, double tmax) const {
+    ++thread_stats().closest_hit_queries;
+    return intersect(ray, tmin, tmax);
+}
+
+std::optional<SurfaceIntersection> TestScene::intersect(const Ray& ray,
+                                                        double tmin,
+                                                        double tmax) const {
+    if (bvh.empty()) {
+        return hit_all(ray, tmin, tmax);
+    }
+
     std::optional<SurfaceIntersection> closest;
-    // ----------- Intersection with Geometry -----------
+    auto object_count = objects.size();
+    uint64_t tests{};
+    bvh.intersect(ray, tmin, tmax, [&](uint32_t idx, double& t_max) {
+        ++tests;
+        std::optional<SurfaceIntersection> rec;
+        if (idx < object_count) {
+            rec = objects[idx]->hit(ray, tmin, t_max);
+            if (rec.has_value()) {
+                rec->intersection = objects[idx];
+                rec->scene_index  = idx;
+            }
+        } else {
+            rec = lights[idx - object_count]->hit(ray, tmin, t_max);
+            if (rec.has_value()) {
+                rec->intersection = lights[idx - object_count];
+                rec->scene_index  = idx;
+            }
+        }
+        if (!rec.has_value()) {
+            return false;
+        }
+        closest = std::move(rec);
+        t_max   = closest->t;
+        return true;
+    });
+    thread_stats().primitive_tests += tests;
+    return closest;
+}
+
+void TestScene::build_accelerator() {
+    bvh.build(primitive_bounds());
+    built_cost = bvh.sah_cost();
+}
+
+bool TestScene::update_accelerator(double max_cost_ratio) {
+    if (bvh.empty()) {
+        build_accelerator();
+        return true;
+    }
+
+    auto bounds = primitive_bounds();
+    bvh.refit(bounds);
+    if (bvh.sah_cost() <= max_cost_ratio * built_cost) {
+        return false;
+    }
+
+    bvh.build(bounds);
+    built_cost = bvh.sah_cost();
+    return true;
+}
+
+Bounds3 TestScene::bounds() const {
+    Bounds3 res;
+    for (const auto& b : primitive_bounds()) {
+        res.expand(b);
+    }
+    return res;
+}
+
+std::vector<Bounds3> TestScene::primitive_bounds() const {
+    std::vector<Bounds3> res;
+    res.reserve(objects.size() + lights.size());
     for (const auto& object : objects) {
-        if (auto rec = object->hit(ray, tmin, tmax); rec.has_value()) {
+        res.push_back(object->bounds());
+    }
+    for (const auto& light : lights) {
+        res.push_back(light->bounds());
+    }
+    return res;
+}
+
+std::optional<SurfaceIntersection> TestScene::hit_all(const Ray& ray, double tmin, double tmax) const {
+    thread_stats().primitive_tests += objects.size() + lights.size();
+
+    std::optional<SurfaceIntersection> closest;
+    // ----------- Intersection with Geometry -----------
+    for (size_t i{}; i < objects.size(); ++i) {
+        if (auto rec = objects[i]->hit(ray, tmin, tmax); rec.has_value()) {
             closest           = rec;
             tmax              = rec->t;
             // closest->geometry = object;
             // closest->light    = nullptr;
-            closest->intersection = object;
+            closest->intersection = objects[i];
+            closest->scene_index  = i;
         }
     }
     // ----------- Intersection with Light -----------
-    for (const auto& light : lights) {
-        if (auto rec = light->hit(ray, tmin, tmax); rec.has_value()) {
+    for (size_t i{}; i < lights.size(); ++i) {
+        if (auto rec = lights[i]->hit(ray, tmin, tmax); rec.has_value()) {
             closest           = rec;
             tmax              = rec->t;
             // closest->light    = light;
             // closest->geometry = nullptr;
-            closest->intersection = light;
+            closest->intersection = lights[i];
+            closest->scene_index  = objects.size() + i;
         }
     }
     return closest;
 }
 
 bool TestScene::mutually_visible(const Vec3& p, const Vec3& q) const {
+    ++thread_stats().shadow_queries;
     Ray r{p, q - p};  // Must not normalize (q - p)
-    return !hit(r, 0.000001, 0.999999);
+    return !intersect(r, 0.000001, 0.999999);
 }
 
-static std::mt19937 g_Gen{};
-
 std::shared_ptr<Light> get_random_light(const TestScene& scene) {
-    auto lights     = scene.get_lights();
-    int light_count = static_cast<int>(scene.light_count());
-    auto idx        = random_int(0, light_count - 1);
+    const auto& lights = scene.get_lights();
+    int light_count    = static_cast<int>(scene.light_count());
+    auto idx           = random_int(0, light_count - 1);
     return lights[idx];
 }
 
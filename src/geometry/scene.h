@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "bvh.h"
 #include "light.h"
 #include "material.h"
 #include "objects.h"
@@ -19,9 +20,9 @@ class TestScene {
 
     std::optional<SurfaceIntersection> hit(const Ray& ray, double tmin, double tmax) const;
 
-    std::vector<std::shared_ptr<Geometry>> get_objects() const { return objects; }
+    const std::vector<std::shared_ptr<Geometry>>& get_objects() const { return objects; }
 
-    std::vector<std::shared_ptr<Light>> get_lights() const { return lights; }
+    const std::vector<std::shared_ptr<Light>>& get_lights() const { return lights; }
 
     size_t object_count() const { return objects.size(); }
 
@@ -31,33 +32,79 @@ class TestScene {
 
     void add(const std::shared_ptr<Light>& light) { add_light(light); }
 
-    void add_geometry(const std::shared_ptr<Geometry>& object) { objects.push_back(object); }
+    void add_geometry(const std::shared_ptr<Geometry>& object) {
+        objects.push_back(object);
+        bvh.clear();
+    }
+
+    void add_light(const std::shared_ptr<Light>& light) {
+        lights.push_back(light);
+        bvh.clear();
+    }
+
+    /// @brief How every light samples points, see Light::set_sampling. An empty optional
+    /// restores the default of each light.
+    void set_light_sampling(std::optional<LightSampling> sampling) {
+        for (const auto& light : lights) {
+            light->set_sampling(sampling.value_or(light->default_sampling()));
+        }
+    }
+
+    /// @brief Build the BVH over all objects and lights. Adding anything afterwards drops it and
+    /// hit() falls back to testing every object until it is built again.
+    void build_accelerator();
+
+    /// @brief Update the BVH after objects or lights moved in place. Refits the node bounds and
+    /// rebuilds only if that makes the tree more than 'max_cost_ratio' times as expensive as
+    /// right after the last build. Returns true if it rebuilt.
+    bool update_accelerator(double max_cost_ratio = 1.5);
+
+    /// @brief Use a prebuilt BVH, e.g. one mapped from a scene cache. Primitive indices must
+    /// refer to objects first and then lights, in the order they were added.
+    void set_accelerator(Bvh accelerator) {
+        bvh        = std::move(accelerator);
+        built_cost = bvh.sah_cost();
+    }
 
-    void add_light(const std::shared_ptr<Light>& light) { lights.push_back(light); }
+    const Bvh& get_accelerator() const { return bvh; }
+
+    /// Bounding box of all objects and lights
+    Bounds3 bounds() const;
 
     bool mutually_visible(const Vec3& p, const Vec3& q) const;
 
     void load_scene1() {
         clear();
         init_scene1();
+        build_accelerator();
     }
 
     void load_scene2() {
         clear();
         init_scene2();
+        build_accelerator();
     }
 
     void load_scene3() {
         clear();
         init_scene3();
+        build_accelerator();
     }
 
-  private:
     void clear() {
         objects.clear();
         lights.clear();
+        bvh.clear();
     }
 
+  private:
+    std::vector<Bounds3> primitive_bounds() const;
+
+    // Closest hit without counting a query, shared by hit() and mutually_visible()
+    std::optional<SurfaceIntersection> intersect(const Ray& ray, double tmin, double tmax) const;
+
+    std::optional<SurfaceIntersection> hit_all(const Ray& ray, double tmin, double tmax) const;
+
     void init_scene1();
     void init_light1();
     void init_geometry1();
@@ -73,6 +120,11 @@ class TestScene {
     std::vector<std::shared_ptr<Geometry>> objects;
     std::vector<std::shared_ptr<Light>> lights;
 
+    Bvh bvh;
+
+    /// SAH cost of the BVH right after it was built, the reference for update_accelerator()
+    double built_cost{};
+
     /// ------------- Predefined materials ------------
     std::shared_ptr<MaterialDiffuse> diffuse_white =
         std::make_shared<MaterialDiffuse>(Color::white, 0.8);
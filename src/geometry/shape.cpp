@@ -1,23 +1,28 @@
 #include "shape.h"
 
+#include <algorithm>
 #include <cmath>
 
 TransformedShape::TransformedShape(std::shared_ptr<Shape> shape,
                                    const Vec3& location,
                                    const Vec3& rotation,
                                    const Vec3& scale)
-    : shape{std::move(shape)},
-      local_to_world{location, rotation, scale} {}
+    : TransformedShape{std::move(shape), Transform{location, rotation, scale}} {}
 
 TransformedShape::TransformedShape(std::shared_ptr<Shape> shape) : shape{std::move(shape)} {}
 
 TransformedShape::TransformedShape(std::shared_ptr<Shape> shape, const Transform& transform)
     : shape{std::move(shape)},
-      local_to_world{transform} {}
+      local_to_world{transform},
+      world_to_local{transform.inverse()} {}
+
+void TransformedShape::set_transform(const Transform& transform) {
+    local_to_world = transform;
+    world_to_local = transform.inverse();
+}
 
 std::optional<SurfaceIntersection> TransformedShape::hit(const Ray& ray, double tmin, double tmax) const {
-    Transform inv_t = local_to_world.inverse();
-    Ray inv_ray     = inv_t.on_ray(ray);
+    Ray inv_ray = world_to_local.on_ray(ray);
 
     std::optional<SurfaceIntersection> rec = shape->hit(inv_ray, tmin, tmax);
     if (!rec.has_value()) {
@@ -42,6 +47,13 @@ ShapeSample TransformedShape::sample_shape() const {
     return sample;
 }
 
+Bounds3 TransformedShape::bounds() const {
+    auto res = transform_bounds(local_to_world, shape->bounds());
+    // Keep flat shapes like RectXZ from producing zero-thickness boxes
+    res.pad(1.0e-6);
+    return res;
+}
+
 double TransformedShape::compute_area() const {
     double s = local_to_world.uniform_scaling_factor();
     return s * s * shape->compute_area();
@@ -72,6 +84,10 @@ std::optional<SurfaceIntersection> Sphere::hit(const Ray& ray, double tmin, doub
     rec.p        = ray.at(t);
     rec.incident = -ray.d;
     rec.frame    = generate_world_shading_frame(rec.p - center);
+
+    // Longitude around y, latitude from the bottom pole
+    auto n = (rec.p - center) / radius;
+    rec.uv = {(std::atan2(-n.z(), n.x()) + pi) * inv_2pi, std::acos(clamp(-n.y(), -1.0, 1.0)) * inv_pi};
     return rec;
 }
 
@@ -97,6 +113,7 @@ std::optional<SurfaceIntersection> RectXZ::hit(const Ray& ray, double tmin, doub
     rec.p        = ray.at(t);
     rec.incident = -ray.d;
     rec.frame    = generate_world_shading_frame({0, 1, 0});
+    rec.uv       = {(x - x0) / (x1 - x0), (z1 - z) / (z1 - z0)};
     return rec;
 }
 
@@ -119,6 +136,11 @@ ShapeSample RectXZ::sample_shape() const {
 }
 
 ShapeSample Sphere::sample_shape() const {
-    // TODO: Implement
-    return {};
+    // Uniform over the surface: z uniform in [-1, 1] by Archimedes' hat-box theorem
+    auto [u1, u2] = Sampler{}.next_2d();
+    double z      = 1.0 - 2.0 * u1;
+    double r      = std::sqrt(std::max(0.0, 1.0 - z * z));
+    double phi    = 2 * pi * u2;
+    Vec3 normal{r * std::cos(phi), r * std::sin(phi), z};
+    return {center + radius * normal, normal, 1.0 / compute_area()};
 }
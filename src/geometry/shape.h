@@ -3,6 +3,7 @@
 #include <optional>
 #include <utility>
 
+#include "bounds.h"
 #include "intersection.h"
 #include "ray.h"
 #include "sampler.h"
@@ -28,6 +29,9 @@ class Shape {
 
     virtual double compute_area() const = 0;
 
+    // Bounds in the local space of the shape
+    virtual Bounds3 bounds() const = 0;
+
     virtual std::string name() const = 0;
 };
 
@@ -48,18 +52,26 @@ class TransformedShape {
 
     double compute_area() const;
 
+    // Bounds in world space
+    Bounds3 bounds() const;
+
     std::shared_ptr<Shape> get_shape() const { return shape; }
 
     Transform get_transform() const { return local_to_world; }
 
+    /// Move the shape in place, e.g. for the next frame of an animation
+    void set_transform(const Transform& transform);
+
     std::string name() const { return shape->name(); }
 
   private:
     std::shared_ptr<Shape> shape;
     Transform local_to_world;
+    Transform world_to_local;  // cached, hit() needs it for every ray
 };
 
-// Unit sphere centered at (0, 0, 0) with radius 1.
+// Unit sphere centered at (0, 0, 0) with radius 1. u runs around the y axis, v from the bottom
+// pole to the top.
 class Sphere : public Shape {
   public:
     Sphere() = default;
@@ -68,7 +80,11 @@ class Sphere : public Shape {
 
     ShapeSample sample_shape() const override;
 
-    double compute_area() const override { return 4 * pi * pi; }
+    double compute_area() const override { return 4 * pi * radius * radius; }
+
+    Bounds3 bounds() const override {
+        return {center - Vec3::all(radius), center + Vec3::all(radius)};
+    }
 
     std::string name() const override { return "Sphere"; }
 
@@ -77,7 +93,7 @@ class Sphere : public Shape {
     double radius{1.0};
 };
 
-// Unit rectangle with side length of 1 centered at (0, 0)
+// Unit rectangle with side length of 1 centered at (0, 0). u runs along x, v along -z.
 class RectXZ : public Shape {
   public:
     RectXZ() = default;
@@ -88,6 +104,8 @@ class RectXZ : public Shape {
 
     double compute_area() const override { return 1.; }
 
+    Bounds3 bounds() const override { return {{x0, 0, z0}, {x1, 0, z1}}; }
+
     bool inside(double x, double z) const { return (x > x0) && (x < x1) && (z > z0) && (z < z1); }
 
     std::string name() const override { return "RectXZ"; }
@@ -1,15 +1,184 @@
 #include "light.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Solid angles below this are sampled by area, the spherical rectangle loses precision there
+constexpr double min_solid_angle{1e-6};
+
+// Rectangle with corner 's' and orthogonal edges 'ex', 'ey' as seen from 'o', after Urena et al.
+// 2013. The local frame has x and y along the edges and z pointing away from the rectangle, with
+// 'o' at the origin.
+class SphericalRectangle {
+  public:
+    SphericalRectangle(const Vec3& o, const Vec3& s, const Vec3& ex, const Vec3& ey) : o{o} {
+        double ex_len = ex.norm();
+        double ey_len = ey.norm();
+        x             = ex / ex_len;
+        y             = ey / ey_len;
+        z             = cross(x, y);
+
+        auto d = s - o;
+        z0     = dot(d, z);
+        if (z0 > 0.0) {
+            z  = -z;
+            z0 = -z0;
+        }
+        if (z0 > -1e-9) {
+            // 'o' lies in the plane of the rectangle and sees none of it
+            return;
+        }
+        x0 = dot(d, x);
+        y0 = dot(d, y);
+        x1 = x0 + ex_len;
+        y1 = y0 + ey_len;
+
+        // Normals of the planes through 'o' and each edge, then the angles between them
+        Vec3 v00{x0, y0, z0};
+        Vec3 v01{x0, y1, z0};
+        Vec3 v10{x1, y0, z0};
+        Vec3 v11{x1, y1, z0};
+        auto n0 = normalized(cross(v00, v10));
+        auto n1 = normalized(cross(v10, v11));
+        auto n2 = normalized(cross(v11, v01));
+        auto n3 = normalized(cross(v01, v00));
+
+        auto angle = [](const Vec3& a, const Vec3& b) {
+            return std::acos(std::clamp(-dot(a, b), -1.0, 1.0));
+        };
+        double g0 = angle(n0, n1);
+        double g1 = angle(n1, n2);
+        double g2 = angle(n2, n3);
+        double g3 = angle(n3, n0);
+
+        b0          = n0.z();
+        b1          = n2.z();
+        k           = 2 * pi - g2 - g3;
+        solid_angle = std::max(0.0, g0 + g1 - k);
+    }
+
+    double get_solid_angle() const { return solid_angle; }
+
+    // Point of the rectangle for (u, v) in [0, 1)^2, uniform over the solid angle
+    Vec3 sample(double u, double v) const {
+        // The x coordinate splits off the fraction u of the solid angle
+        double au = u * solid_angle + k;
+        double fu = (std::cos(au) * b0 - b1) / std::sin(au);
+        double cu = std::clamp(std::copysign(1.0, fu) / std::sqrt(fu * fu + b0 * b0), -1.0, 1.0);
+        double xu = -(cu * z0) / std::sqrt(std::max(1e-12, 1.0 - cu * cu));
+        xu        = std::clamp(xu, x0, x1);
+
+        // Then y, uniform in the sine of the elevation along that line
+        double d  = std::sqrt(xu * xu + z0 * z0);
+        double h0 = y0 / std::sqrt(d * d + y0 * y0);
+        double h1 = y1 / std::sqrt(d * d + y1 * y1);
+        double hv = h0 + v * (h1 - h0);
+        double yv = hv * hv < 1.0 - 1e-12 ? hv * d / std::sqrt(1.0 - hv * hv) : y1;
+        yv        = std::clamp(yv, y0, y1);
+
+        return o + xu * x + yv * y + z0 * z;
+    }
+
+  private:
+    Vec3 o;
+    Vec3 x;
+    Vec3 y;
+    Vec3 z;
+    double z0{};
+    double x0{};
+    double y0{};
+    double x1{};
+    double y1{};
+    double b0{};
+    double b1{};
+    double k{};
+    double solid_angle{};
+};
+
+// The rectangle of a RectXZ light in world space, unless the shape is something else or its
+// transform shears it
+std::optional<SphericalRectangle> spherical_rectangle(const TransformedShape& shape,
+                                                      const Vec3& ref) {
+    if (!std::dynamic_pointer_cast<RectXZ>(shape.get_shape())) {
+        return std::nullopt;
+    }
+    auto transform = shape.get_transform();
+    auto corner    = transform.on_point({-0.5, 0, -0.5});
+    auto ex        = transform.on_vec({1, 0, 0});
+    auto ey        = transform.on_vec({0, 0, 1});
+    if (std::abs(dot(ex, ey)) > 1e-9 * ex.norm() * ey.norm()) {
+        return std::nullopt;
+    }
+    SphericalRectangle rect{ref, corner, ex, ey};
+    if (rect.get_solid_angle() < min_solid_angle) {
+        return std::nullopt;
+    }
+    return rect;
+}
+
+// 1 - cos of the half angle of the cone a sphere of radius 'r' subtends at distance^2 'dist2'.
+// Kept as such, so that distant spheres with tiny cones don't lose it to rounding.
+double cone_one_minus_cos(double r, double dist2) {
+    double sin2_max = r * r / dist2;
+    return sin2_max / (1.0 + std::sqrt(std::max(0.0, 1.0 - sin2_max)));
+}
+
+// Density over the area at 'p' of a density over the solid angle seen from 'ref'
+double solid_angle_to_area(double pdf, const Vec3& ref, const Vec3& p, const Vec3& normal) {
+    auto d    = p - ref;
+    double d2 = dot(d, d);
+    return pdf * absdot(normalized(normal), d) / (std::sqrt(d2) * d2);
+}
+
+}  // namespace
+
+LightSampling parse_light_sampling(const std::string& name) {
+    if (name == "area") {
+        return LightSampling::area;
+    }
+    if (name == "solid-angle") {
+        return LightSampling::solid_angle;
+    }
+    throw std::runtime_error{"unknown light sampling '" + name + "', expected area or solid-angle"};
+}
+
 Light::Light(const TransformedShape& t_shape, const RgbColor& base_color, double intensity)
     : transformed_shape{t_shape},
       base_color{base_color},
       intensity{intensity} {}
 
+double Light::pdf_from(const Vec3& /*ref*/, const Vec3& /*p*/) const {
+    return 1.0 / transformed_shape.compute_area();
+}
+
 std::optional<SurfaceIntersection> Light::hit(const Ray& ray, double tmin, double tmax) const {
     return transformed_shape.hit(ray, tmin, tmax);
 }
 
-TransformedShape Light::get_transformed_shape() const {
+EmissionSample Light::sample_emission() const {
+    auto point = sample();
+    auto n     = point.normal.normalized();
+
+    double side = random_double() < 0.5 ? 1.0 : -1.0;
+    auto frame  = generate_world_shading_frame(side * n);
+    double u1   = random_double();
+    double u2   = random_double();
+    double r    = std::sqrt(u1);
+    double phi  = 2 * pi * u2;
+    Vec3 direction = r * std::cos(phi) * frame.tangent + std::sqrt(1.0 - u1) * frame.normal +
+                     r * std::sin(phi) * frame.bitangent;
+    return {point.p, n, direction, point.pdf_value, emission_pdf(n, direction)};
+}
+
+double Light::emission_pdf(const Vec3& normal, const Vec3& direction) const {
+    // Either side with even odds, then cos / pi
+    return 0.5 * absdot(normal, normalized(direction)) / pi;
+}
+
+const TransformedShape& Light::get_transformed_shape() const {
     return transformed_shape;
 }
 
@@ -28,10 +197,38 @@ ShapeSample AreaLight::sample() const {
     return get_transformed_shape().sample_shape();
 }
 
-RgbColor AreaLight::compute_emitted_radiance(const Vec3& p, const Vec3& direction) const {
+RgbColor AreaLight::compute_emitted_radiance(const Vec3& /*p*/, const Vec3& /*direction*/) const {
     return get_base_color() * get_intensity();
 }
 
+ShapeSample AreaLight::sample_from(const Vec3& ref) const {
+    if (get_sampling() != LightSampling::solid_angle) {
+        return sample();
+    }
+    auto rect = spherical_rectangle(get_transformed_shape(), ref);
+    if (!rect) {
+        return sample();
+    }
+
+    double u    = random_double();
+    double v    = random_double();
+    auto p      = rect->sample(u, v);
+    auto normal = get_transformed_shape().get_transform().on_vec({0, 1, 0}).normalized();
+    return {p, normal, solid_angle_to_area(1.0 / rect->get_solid_angle(), ref, p, normal)};
+}
+
+double AreaLight::pdf_from(const Vec3& ref, const Vec3& p) const {
+    if (get_sampling() != LightSampling::solid_angle) {
+        return Light::pdf_from(ref, p);
+    }
+    auto rect = spherical_rectangle(get_transformed_shape(), ref);
+    if (!rect) {
+        return Light::pdf_from(ref, p);
+    }
+    auto normal = get_transformed_shape().get_transform().on_vec({0, 1, 0});
+    return solid_angle_to_area(1.0 / rect->get_solid_angle(), ref, p, normal);
+}
+
 std::shared_ptr<AreaLight> create_area_light(const Vec3& location,
                                              const Vec3& rotation,
                                              const Vec3& scale,
@@ -40,3 +237,101 @@ std::shared_ptr<AreaLight> create_area_light(const Vec3& location,
     TransformedShape shape{primitives.rect_xz, location, rotation, scale};
     return std::make_shared<AreaLight>(shape, base_color, intensity);
 }
+
+SphereLight::SphereLight(const TransformedShape& t_shape,
+                         const RgbColor& base_color,
+                         double intensity)
+    : Light{t_shape, base_color, intensity} {
+    set_sampling(default_sampling());
+}
+
+Vec3 SphereLight::center() const {
+    return get_transformed_shape().get_transform().on_point(Vec3::zero());
+}
+
+double SphereLight::radius() const {
+    // The unit sphere scaled
+    return get_transformed_shape().get_transform().uniform_scaling_factor();
+}
+
+RgbColor SphereLight::compute_emitted_radiance(const Vec3& p, const Vec3& direction) const {
+    if (dot(p - center(), direction) <= 0.0) {
+        return Color::black;
+    }
+    return get_base_color() * get_intensity();
+}
+
+ShapeSample SphereLight::sample() const {
+    return get_transformed_shape().sample_shape();
+}
+
+ShapeSample SphereLight::sample_from(const Vec3& ref) const {
+    auto c       = center();
+    double r     = radius();
+    auto to_c    = c - ref;
+    double dist2 = dot(to_c, to_c);
+    if (get_sampling() == LightSampling::area || dist2 <= r * r) {
+        // Inside the sphere all of it is in sight
+        return sample();
+    }
+
+    // Uniform direction in the cone around the center
+    double dist              = std::sqrt(dist2);
+    double one_minus_cos_max = cone_one_minus_cos(r, dist2);
+    double one_minus_cos     = random_double() * one_minus_cos_max;
+    double cos_theta         = 1.0 - one_minus_cos;
+    double sin2_theta        = one_minus_cos * (2.0 - one_minus_cos);
+    double phi               = 2 * pi * random_double();
+
+    // Where the direction first meets the sphere, as an angle at the center away from 'ref'
+    double ds        = dist * cos_theta - std::sqrt(std::max(0.0, r * r - dist2 * sin2_theta));
+    double cos_alpha = std::clamp((dist2 + r * r - ds * ds) / (2.0 * dist * r), -1.0, 1.0);
+    double sin_alpha = std::sqrt(1.0 - cos_alpha * cos_alpha);
+
+    auto frame  = generate_world_shading_frame(to_c / dist);
+    Vec3 normal = -(sin_alpha * std::cos(phi) * frame.tangent +
+                    sin_alpha * std::sin(phi) * frame.bitangent + cos_alpha * frame.normal);
+    Vec3 p      = c + r * normal;
+
+    double pdf = 1.0 / (2 * pi * one_minus_cos_max);
+    return {p, normal, solid_angle_to_area(pdf, ref, p, normal)};
+}
+
+double SphereLight::pdf_from(const Vec3& ref, const Vec3& p) const {
+    auto c       = center();
+    double r     = radius();
+    auto to_c    = c - ref;
+    double dist2 = dot(to_c, to_c);
+    if (get_sampling() == LightSampling::area || dist2 <= r * r) {
+        return Light::pdf_from(ref, p);
+    }
+    double pdf = 1.0 / (2 * pi * cone_one_minus_cos(r, dist2));
+    return solid_angle_to_area(pdf, ref, p, p - c);
+}
+
+EmissionSample SphereLight::sample_emission() const {
+    auto point = sample();
+    auto n     = point.normal.normalized();
+
+    auto frame  = generate_world_shading_frame(n);
+    double u1   = random_double();
+    double u2   = random_double();
+    double r    = std::sqrt(u1);
+    double phi  = 2 * pi * u2;
+    Vec3 direction = r * std::cos(phi) * frame.tangent + std::sqrt(1.0 - u1) * frame.normal +
+                     r * std::sin(phi) * frame.bitangent;
+    return {point.p, n, direction, point.pdf_value, emission_pdf(n, direction)};
+}
+
+double SphereLight::emission_pdf(const Vec3& normal, const Vec3& direction) const {
+    // Outwards only, cos / pi
+    return std::max(0.0, dot(normal, normalized(direction))) / pi;
+}
+
+std::shared_ptr<SphereLight> create_sphere_light(const Vec3& location,
+                                                 double radius,
+                                                 const RgbColor& base_color,
+                                                 double intensity) {
+    TransformedShape shape{primitives.sphere, location, Vec3::zero(), Vec3::all(radius)};
+    return std::make_shared<SphereLight>(shape, base_color, intensity);
+}
@@ -1,11 +1,30 @@
 #pragma once
 
 #include <optional>
+#include <string>
 
 #include "intersection.h"
 #include "shape.h"
 #include "utils.h"
 
+// How lights pick the points that light a shading point
+enum class LightSampling {
+    area,         // uniform over the surface of the light
+    solid_angle,  // uniform over the directions in which the shading point sees the light
+};
+
+/// @brief "area" or "solid-angle". Throws std::runtime_error on other names.
+LightSampling parse_light_sampling(const std::string& name);
+
+// A point on a light and a direction it emits towards
+struct EmissionSample {
+    Vec3 p;
+    Vec3 normal;
+    Vec3 direction;
+    double pdf_area{};       // density of the point over the light's area
+    double pdf_direction{};  // density of the direction over solid angle
+};
+
 class Light {
   public:
     Light(const TransformedShape& t_shape, const RgbColor& base_color, double intensity);
@@ -16,9 +35,35 @@ class Light {
 
     virtual ShapeSample sample() const = 0;
 
+    /// @brief Point on the light to light 'ref' from, its pdf_value a density over the light's
+    /// area. Uniform over the area unless a subclass samples what 'ref' can see.
+    virtual ShapeSample sample_from(const Vec3& /*ref*/) const { return sample(); }
+
+    /// Density over the light's area of sample_from(ref) picking 'p', for MIS
+    virtual double pdf_from(const Vec3& ref, const Vec3& p) const;
+
+    /// How sample_from() picks points, lights without solid angle sampling ignore it
+    void set_sampling(LightSampling sampling) { this->sampling = sampling; }
+
+    LightSampling get_sampling() const { return sampling; }
+
+    /// What sample_from() does unless set_sampling() says otherwise
+    virtual LightSampling default_sampling() const { return LightSampling::area; }
+
+    /// @brief Start of a light path. Lights emit from both sides of their surface, cosine
+    /// weighted, unless a subclass says otherwise.
+    virtual EmissionSample sample_emission() const;
+
+    /// Solid angle density of sample_emission() picking 'direction' at a point with 'normal'
+    virtual double emission_pdf(const Vec3& normal, const Vec3& direction) const;
+
     virtual std::optional<SurfaceIntersection> hit(const Ray& ray, double tmin, double tmax) const;
 
-    TransformedShape get_transformed_shape() const;
+    Bounds3 bounds() const { return transformed_shape.bounds(); }
+
+    void set_transform(const Transform& transform) { transformed_shape.set_transform(transform); }
+
+    const TransformedShape& get_transformed_shape() const;
     RgbColor get_base_color() const;
     double get_intensity() const;
 
@@ -26,12 +71,38 @@ class Light {
     TransformedShape transformed_shape;
     RgbColor base_color{Color::white};
     double intensity{1.0};
+    LightSampling sampling{LightSampling::area};
 };
 
+// Sphere that emits outwards from its surface. Lighting samples pick a direction inside the cone
+// the sphere subtends from the shading point by default, so no sample lands on the far side.
 class SphereLight : public Light {
   public:
+    SphereLight(const TransformedShape& t_shape, const RgbColor& base_color, double intensity);
+
+    RgbColor compute_emitted_radiance(const Vec3& p, const Vec3& direction) const override;
+
+    ShapeSample sample() const override;
+
+    ShapeSample sample_from(const Vec3& ref) const override;
+
+    double pdf_from(const Vec3& ref, const Vec3& p) const override;
+
+    LightSampling default_sampling() const override { return LightSampling::solid_angle; }
+
+    EmissionSample sample_emission() const override;
+
+    double emission_pdf(const Vec3& normal, const Vec3& direction) const override;
+
+  private:
+    Vec3 center() const;
+
+    double radius() const;
 };
 
+// Light shaped like its TransformedShape, usually a RectXZ, with constant radiance on both sides.
+// Solid angle sampling of rectangles follows Urena et al. 2013, "An Area-Preserving
+// Parametrization for Spherical Rectangles".
 class AreaLight : public Light {
   public:
     AreaLight(const TransformedShape& t_shape, const RgbColor& base_color, double intensity);
@@ -40,11 +111,18 @@ class AreaLight : public Light {
 
     ShapeSample sample() const override;
 
-  private:
+    ShapeSample sample_from(const Vec3& ref) const override;
+
+    double pdf_from(const Vec3& ref, const Vec3& p) const override;
 };
 
 std::shared_ptr<AreaLight> create_area_light(const Vec3& location,
                                              const Vec3& rotation,
                                              const Vec3& scale,
                                              const RgbColor& base_color = Color::white,
-                                             double intensity = 1.0);
\ No newline at end of file
+                                             double intensity = 1.0);
+
+std::shared_ptr<SphereLight> create_sphere_light(const Vec3& location,
+                                                 double radius,
+                                                 const RgbColor& base_color = Color::white,
+                                                 double intensity = 1.0);
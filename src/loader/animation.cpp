@@ -0,0 +1,16 @@
+#include "animation.h"
+
+#include "scene.h"
+
+void apply_animations(TestScene& scene, const std::vector<ObjectAnimation>& animations, double frame) {
+    const auto& objects = scene.get_objects();
+    const auto& lights  = scene.get_lights();
+    for (const auto& animation : animations) {
+        auto transform = animation.at_frame(frame);
+        if (animation.is_light) {
+            lights.at(animation.index)->set_transform(transform);
+        } else {
+            objects.at(animation.index)->set_transform(transform);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "transform.h"
+#include "vec.h"
+
+class TestScene;
+
+// Linear motion of one object or light, from the 'velocity' and 'spin' attributes of a scene file
+struct ObjectAnimation {
+    bool is_light{false};
+
+    /// Position in the scene's objects or lights
+    size_t index{};
+
+    /// Pose at frame 0
+    Vec3 location{Vec3::zero()};
+    Vec3 rotation{Vec3::zero()};
+    Vec3 scale{Vec3::one()};
+
+    /// Units per frame
+    Vec3 velocity{Vec3::zero()};
+
+    /// Degrees per frame around x, y and z
+    Vec3 spin{Vec3::zero()};
+
+    Transform at_frame(double frame) const {
+        return {location + frame * velocity, rotation + frame * spin, scale};
+    }
+};
+
+/// @brief Move every animated object and light in place to the given frame. The BVH is left as
+/// is, call TestScene::update_accelerator() afterwards.
+void apply_animations(TestScene& scene, const std::vector<ObjectAnimation>& animations, double frame);
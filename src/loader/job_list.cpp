@@ -0,0 +1,106 @@
+#include "job_list.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "statement_parser.h"
+
+namespace {
+
+RenderJob parse_job(const std::vector<std::string>& tokens, const std::string& base_dir) {
+    if (tokens.front() != "job") {
+        throw std::runtime_error{"unknown statement '" + tokens.front() + "'"};
+    }
+    if (tokens.size() < 2) {
+        throw std::runtime_error{"job expects a scene file"};
+    }
+
+    Attributes attr{tokens, 2, {"output", "film"}};
+    attr.expect_only({"output", "width", "height", "spp", "location", "focus", "vfov", "frames",
+                      "crop", "film"});
+
+    RenderJob job;
+    std::filesystem::path scene{tokens[1]};
+    job.scene = scene.is_relative() && !base_dir.empty()
+                    ? (std::filesystem::path{base_dir} / scene).string()
+                    : scene.string();
+
+    if (attr.has("output")) {
+        job.output = attr.get_string("output", "");
+    }
+    if (attr.has("width")) {
+        job.image_width = static_cast<int>(attr.get_double("width", 0));
+    }
+    if (attr.has("height")) {
+        job.image_height = static_cast<int>(attr.get_double("height", 0));
+    }
+    if (attr.has("spp")) {
+        job.samples_per_pixel = static_cast<size_t>(attr.get_double("spp", 0));
+    }
+    if (attr.has("location")) {
+        job.camera_location = attr.get_vec3("location", Vec3::zero());
+    }
+    if (attr.has("focus")) {
+        job.camera_focus = attr.get_vec3("focus", Vec3::zero());
+    }
+    if (attr.has("vfov")) {
+        job.camera_vfov = attr.get_double("vfov", 0);
+    }
+
+    if (attr.has("frames")) {
+        auto values = attr.get_numbers("frames");
+        if (values.size() != 2 || values[0] < 0 || values[1] < 1) {
+            throw std::runtime_error{"'frames' expects a first frame and a positive count"};
+        }
+        job.frames = {static_cast<size_t>(values[0]), static_cast<size_t>(values[1])};
+    }
+
+    if (attr.has("crop")) {
+        auto values = attr.get_numbers("crop");
+        if (values.size() != 4 || values[0] < 0 || values[1] < 0 || values[2] <= values[0] ||
+            values[3] <= values[1]) {
+            throw std::runtime_error{"'crop' expects a non-empty window x0 y0 x1 y1"};
+        }
+        job.crop = ImageTile{static_cast<int>(values[0]), static_cast<int>(values[1]),
+                             static_cast<int>(values[2]), static_cast<int>(values[3])};
+    }
+    if (attr.has("film")) {
+        job.film = attr.get_string("film", "");
+    }
+
+    if (job.image_width.value_or(1) <= 0 || job.image_height.value_or(1) <= 0 ||
+        job.samples_per_pixel.value_or(1) == 0) {
+        throw std::runtime_error{"film size and spp must be positive"};
+    }
+    return job;
+}
+
+}  // namespace
+
+std::vector<RenderJob> parse_job_list(std::istream& in, const std::string& base_dir) {
+    std::vector<RenderJob> jobs;
+    size_t line_number{};
+    for (std::string line; std::getline(in, line);) {
+        ++line_number;
+        auto tokens = tokenize(line);
+        if (tokens.empty()) {
+            continue;
+        }
+
+        try {
+            jobs.push_back(parse_job(tokens, base_dir));
+        } catch (const std::exception& e) {
+            throw std::runtime_error{"line " + std::to_string(line_number) + ": " + e.what()};
+        }
+    }
+    return jobs;
+}
+
+std::vector<RenderJob> load_job_list(const std::string& path) {
+    std::ifstream file{path};
+    if (file.fail()) {
+        throw std::runtime_error{"can't open job list: " + path};
+    }
+    return parse_job_list(file, std::filesystem::path{path}.parent_path().string());
+}
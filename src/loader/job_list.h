@@ -0,0 +1,50 @@
+#pragma once
+
+#include <istream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "vec.h"
+
+// Job list format
+// ---------------
+// Same line syntax as scene files, one job per line:
+//
+//   job <scene file> output a.png width 300 height 200 spp 16 location 0 4 6 focus 0 0 0 vfov 60
+//   job <scene file> frames 0 24
+//   job <scene file> crop 0 0 160 50 film top.film
+//
+// Every attribute is optional and overrides the film or camera statement of the scene file.
+// "frames first count" renders an animation sequence to <output stem>_<frame>.<ext>.
+// "crop x0 y0 x1 y1" renders only that pixel window, "film" also writes the float film, see
+// Film::save. Films of a sequence are numbered like the outputs.
+// Relative scene paths are resolved against the directory of the job list, outputs against the
+// working directory like the output of a scene file.
+
+struct RenderJob {
+    std::string scene;
+
+    std::optional<int> image_width;
+    std::optional<int> image_height;
+    std::optional<size_t> samples_per_pixel;
+    std::optional<std::string> output;
+
+    std::optional<Vec3> camera_location;
+    std::optional<Vec3> camera_focus;
+    std::optional<double> camera_vfov;
+
+    /// First frame and number of frames of an animation sequence, one still image if empty
+    std::optional<std::pair<size_t, size_t>> frames;
+
+    std::optional<ImageTile> crop;
+    std::optional<std::string> film;
+};
+
+/// @brief Parse a job list. Throws std::runtime_error with the offending line number on malformed
+/// input.
+std::vector<RenderJob> parse_job_list(std::istream& in, const std::string& base_dir = "");
+
+std::vector<RenderJob> load_job_list(const std::string& path);
@@ -0,0 +1,534 @@
+#include "scene_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "light.h"
+#include "mapped_file.h"
+#include "objects.h"
+#include "profiler.h"
+#include "shape.h"
+
+namespace {
+
+constexpr char cache_magic[8] = {'V', '3', 'S', 'C', 'E', 'N', 'E', '\0'};
+constexpr uint32_t cache_version{4};  // 4: BVHs within Bvh::max_depth
+constexpr uint32_t endian_tag{0x01020304};
+
+enum class ShapeKind : uint32_t { sphere = 0, rect_xz = 1 };
+enum class MaterialKind : uint32_t { diffuse = 0, glass = 1, mirror = 2 };
+
+struct Section {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    int32_t image_width;
+    int32_t image_height;
+    uint64_t samples_per_pixel;
+    char output[256];
+
+    double camera_location[3];
+    double camera_look_at[3];
+    double camera_vfov;
+    double camera_aspect_ratio;
+
+    Section materials;
+    Section objects;
+    Section lights;
+    Section bvh_nodes;
+    Section bvh_indices;
+    Section animations;
+    Section texture_paths;
+};
+
+struct CachedMaterial {
+    MaterialKind kind;
+    uint32_t texture;  // index + 1 into the texture paths, 0 for none
+    double params[4];
+};
+
+struct CachedPath {
+    char path[256];
+};
+
+struct CachedTransform {
+    double mat[16];
+    double inv_mat[16];
+};
+
+struct CachedObject {
+    ShapeKind shape;
+    uint32_t material;
+    CachedTransform transform;
+};
+
+struct CachedLight {
+    ShapeKind shape;
+    uint32_t padding;
+    double color[3];
+    double intensity;
+    CachedTransform transform;
+};
+
+struct CachedAnimation {
+    uint32_t is_light;
+    uint32_t index;
+    double location[3];
+    double rotation[3];
+    double scale[3];
+    double velocity[3];
+    double spin[3];
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader>);
+static_assert(std::is_trivially_copyable_v<BvhNode>);
+
+struct SourceStamp {
+    uint64_t size;
+    int64_t mtime;
+};
+
+std::optional<SourceStamp> source_stamp(const std::string& path) {
+    std::error_code ec;
+    auto size  = std::filesystem::file_size(path, ec);
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return SourceStamp{size, static_cast<int64_t>(mtime.time_since_epoch().count())};
+}
+
+ShapeKind to_shape_kind(const std::shared_ptr<Shape>& shape) {
+    if (std::dynamic_pointer_cast<Sphere>(shape)) {
+        return ShapeKind::sphere;
+    }
+    if (std::dynamic_pointer_cast<RectXZ>(shape)) {
+        return ShapeKind::rect_xz;
+    }
+    throw std::runtime_error{"scene cache: unsupported shape " + shape->name()};
+}
+
+std::shared_ptr<Shape> to_shape(ShapeKind kind) {
+    switch (kind) {
+        case ShapeKind::sphere:
+            return primitives.sphere;
+        case ShapeKind::rect_xz:
+            return primitives.rect_xz;
+    }
+    throw std::runtime_error{"scene cache: corrupt shape kind"};
+}
+
+CachedMaterial to_cached_material(const std::shared_ptr<Material>& material,
+                                  std::vector<CachedPath>& texture_paths) {
+    CachedMaterial res{};
+    if (auto diffuse = std::dynamic_pointer_cast<MaterialDiffuse>(material)) {
+        if (const auto& texture = diffuse->get_texture()) {
+            CachedPath cached{};
+            if (texture->get_path().size() >= sizeof(cached.path)) {
+                throw std::runtime_error{"scene cache: texture path too long"};
+            }
+            std::strncpy(cached.path, texture->get_path().c_str(), sizeof(cached.path) - 1);
+            texture_paths.push_back(cached);
+            res.texture = static_cast<uint32_t>(texture_paths.size());
+        }
+        auto albedo   = diffuse->get_base_albedo();
+        res.kind      = MaterialKind::diffuse;
+        res.params[0] = albedo.r();
+        res.params[1] = albedo.g();
+        res.params[2] = albedo.b();
+        res.params[3] = diffuse->get_reflectance();
+    } else if (auto glass = std::dynamic_pointer_cast<Glass>(material)) {
+        res.kind      = MaterialKind::glass;
+        res.params[0] = glass->get_ior();
+    } else if (std::dynamic_pointer_cast<PerfectMirror>(material)) {
+        res.kind = MaterialKind::mirror;
+    } else {
+        throw std::runtime_error{"scene cache: unsupported material " + material->name()};
+    }
+    return res;
+}
+
+std::shared_ptr<Material> to_material(const CachedMaterial& m,
+                                      const CachedPath* texture_paths,
+                                      size_t texture_count) {
+    switch (m.kind) {
+        case MaterialKind::diffuse: {
+            std::shared_ptr<ImageTexture> texture;
+            if (m.texture > texture_count) {
+                throw std::runtime_error{"scene cache: corrupt texture index"};
+            }
+            if (m.texture > 0) {
+                const auto& cached = texture_paths[m.texture - 1];
+                texture            = load_image_texture(std::string{
+                    cached.path, std::find(std::begin(cached.path), std::end(cached.path), '\0')});
+            }
+            return std::make_shared<MaterialDiffuse>(
+                RgbColor{m.params[0], m.params[1], m.params[2]}, m.params[3], texture);
+        }
+        case MaterialKind::glass:
+            return std::make_shared<Glass>(m.params[0]);
+        case MaterialKind::mirror:
+            return std::make_shared<PerfectMirror>();
+    }
+    throw std::runtime_error{"scene cache: corrupt material kind"};
+}
+
+CachedTransform to_cached_transform(const Transform& t) {
+    CachedTransform res{};
+    auto mat     = t.get_mat().get_array();
+    auto inv_mat = t.get_inv_mat().get_array();
+    std::copy(mat.begin(), mat.end(), res.mat);
+    std::copy(inv_mat.begin(), inv_mat.end(), res.inv_mat);
+    return res;
+}
+
+Transform to_transform(const CachedTransform& t) {
+    std::array<double, 16> mat{};
+    std::array<double, 16> inv_mat{};
+    std::copy(std::begin(t.mat), std::end(t.mat), mat.begin());
+    std::copy(std::begin(t.inv_mat), std::end(t.inv_mat), inv_mat.begin());
+    return {Mat4{mat}, Mat4{inv_mat}};
+}
+
+class CacheWriter {
+  public:
+    CacheWriter() : buf(sizeof(CacheHeader)) {}
+
+    template <typename T>
+    Section append(const T* items, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        buf.resize((buf.size() + 7) / 8 * 8);  // keep every section 8 byte aligned
+        Section section{buf.size(), count};
+        auto bytes = count * sizeof(T);
+        buf.resize(buf.size() + bytes);
+        // Bounded by the destination, which also tells the compiler the size can't overflow
+        bytes = std::min(bytes, buf.size() - section.offset);
+        if (bytes > 0) {
+            std::memcpy(buf.data() + section.offset, items, bytes);
+        }
+        return section;
+    }
+
+    template <typename T>
+    Section append(const std::vector<T>& items) {
+        return append(items.data(), items.size());
+    }
+
+    void set_header(const CacheHeader& header) { std::memcpy(buf.data(), &header, sizeof(header)); }
+
+    // Written aside and renamed into place, so processes loading the same scene at once, like
+    // distributed workers, never see a half written cache
+    void save(const std::string& path) const {
+        auto temp_path = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+            file.write(reinterpret_cast<const char*>(buf.data()),
+                       static_cast<std::streamsize>(buf.size()));
+            if (file.fail()) {
+                std::filesystem::remove(temp_path);
+                throw std::runtime_error{"scene cache: failed to write " + path};
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp_path, ec);
+            throw std::runtime_error{"scene cache: failed to write " + path};
+        }
+    }
+
+  private:
+    std::vector<std::byte> buf;
+};
+
+template <typename T>
+const T* section_data(const MappedFile& file, const Section& section) {
+    auto end = section.offset + section.count * sizeof(T);
+    if (section.offset % alignof(T) != 0 || end > file.get_size() || end < section.offset) {
+        throw std::runtime_error{"scene cache: corrupt section"};
+    }
+    return reinterpret_cast<const T*>(file.get_data() + section.offset);
+}
+
+const CacheHeader* valid_header(const MappedFile& file) {
+    if (!file.is_open() || file.get_size() < sizeof(CacheHeader)) {
+        return nullptr;
+    }
+    const auto* header = reinterpret_cast<const CacheHeader*>(file.get_data());
+    if (std::memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        header->version != cache_version || header->endian != endian_tag) {
+        return nullptr;
+    }
+    return header;
+}
+
+// Traversal trusts node offsets and the tree depth, so check them once instead of on every ray
+void validate_bvh(const BvhNode* nodes,
+                  size_t node_count,
+                  const uint32_t* indices,
+                  size_t index_count) {
+    // Children follow their parent, so every depth is final when the sweep reaches its node
+    std::vector<size_t> depth(node_count);
+    for (size_t i{}; i < node_count; ++i) {
+        const auto& node = nodes[i];
+        bool valid       = node.primitive_count > 0
+                               ? node.offset + node.primitive_count <= index_count
+                               : node.offset > i && node.offset < node_count && node.axis < 3 &&
+                               depth[i] < Bvh::max_depth;
+        if (!valid) {
+            throw std::runtime_error{"scene cache: corrupt BVH"};
+        }
+        if (node.primitive_count == 0) {
+            depth[i + 1]       = std::max(depth[i + 1], depth[i] + 1);
+            depth[node.offset] = std::max(depth[node.offset], depth[i] + 1);
+        }
+    }
+    for (size_t i{}; i < index_count; ++i) {
+        if (indices[i] >= index_count) {
+            throw std::runtime_error{"scene cache: corrupt BVH"};
+        }
+    }
+}
+
+}  // namespace
+
+std::string scene_cache_path(const std::string& scene_path) {
+    return scene_path + ".cache";
+}
+
+bool is_scene_cache_fresh(const std::string& cache_path, const std::string& scene_path) {
+    auto stamp = source_stamp(scene_path);
+    if (!stamp.has_value()) {
+        return false;
+    }
+
+    MappedFile file{cache_path};
+    const auto* header = valid_header(file);
+    return header && header->source_size == stamp->size && header->source_mtime == stamp->mtime;
+}
+
+void write_scene_cache(const SceneDescription& desc,
+                       const std::string& scene_path,
+                       const std::string& cache_path) {
+    PROFILE_ZONE("scene_cache_write");
+    const auto& scene = *desc.scene;
+    if (scene.get_accelerator().empty() && scene.object_count() + scene.light_count() > 0) {
+        throw std::runtime_error{"scene cache: scene has no BVH"};
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.endian  = endian_tag;
+    if (auto stamp = source_stamp(scene_path)) {
+        header.source_size  = stamp->size;
+        header.source_mtime = stamp->mtime;
+    }
+
+    const auto& settings     = desc.settings;
+    header.image_width       = settings.image_width;
+    header.image_height      = settings.image_height;
+    header.samples_per_pixel = settings.samples_per_pixel;
+    if (settings.output.size() >= sizeof(header.output)) {
+        throw std::runtime_error{"scene cache: output path too long"};
+    }
+    std::strncpy(header.output, settings.output.c_str(), sizeof(header.output) - 1);
+
+    auto location = desc.camera->get_location();
+    auto look_at  = desc.camera->get_look_at();
+    for (size_t i{}; i < 3; ++i) {
+        header.camera_location[i] = location[i];
+        header.camera_look_at[i]  = look_at[i];
+    }
+    header.camera_vfov         = desc.camera->get_vfov();
+    header.camera_aspect_ratio = desc.camera->get_aspect_ratio();
+
+    // ----------- Material table, shared materials are stored once -----------
+    std::vector<CachedMaterial> materials;
+    std::vector<CachedPath> texture_paths;
+    std::unordered_map<const Material*, uint32_t> material_index;
+    std::vector<CachedObject> objects;
+    for (const auto& object : scene.get_objects()) {
+        auto material        = object->get_material();
+        auto [it, inserted]  = material_index.try_emplace(
+            material.get(), static_cast<uint32_t>(materials.size()));
+        if (inserted) {
+            materials.push_back(to_cached_material(material, texture_paths));
+        }
+
+        auto t_shape = object->get_transformed_shape();
+        objects.push_back({to_shape_kind(t_shape->get_shape()),
+                           it->second,
+                           to_cached_transform(t_shape->get_transform())});
+    }
+
+    std::vector<CachedLight> lights;
+    for (const auto& light : scene.get_lights()) {
+        if (!std::dynamic_pointer_cast<AreaLight>(light) &&
+            !std::dynamic_pointer_cast<SphereLight>(light)) {
+            throw std::runtime_error{"scene cache: unsupported light"};
+        }
+        const auto& t_shape = light->get_transformed_shape();
+        auto color          = light->get_base_color();
+        lights.push_back({to_shape_kind(t_shape.get_shape()),
+                          0,
+                          {color.r(), color.g(), color.b()},
+                          light->get_intensity(),
+                          to_cached_transform(t_shape.get_transform())});
+    }
+
+    std::vector<CachedAnimation> animations;
+    for (const auto& a : desc.animations) {
+        CachedAnimation cached{};
+        cached.is_light = a.is_light;
+        cached.index    = static_cast<uint32_t>(a.index);
+        for (size_t i{}; i < 3; ++i) {
+            cached.location[i] = a.location[i];
+            cached.rotation[i] = a.rotation[i];
+            cached.scale[i]    = a.scale[i];
+            cached.velocity[i] = a.velocity[i];
+            cached.spin[i]     = a.spin[i];
+        }
+        animations.push_back(cached);
+    }
+
+    const auto& bvh = scene.get_accelerator();
+
+    CacheWriter writer;
+    header.materials     = writer.append(materials);
+    header.objects       = writer.append(objects);
+    header.lights        = writer.append(lights);
+    header.bvh_nodes     = writer.append(bvh.get_nodes(), bvh.get_node_count());
+    header.bvh_indices   = writer.append(bvh.get_indices(), bvh.get_primitive_count());
+    header.animations    = writer.append(animations);
+    header.texture_paths = writer.append(texture_paths);
+    writer.set_header(header);
+    writer.save(cache_path);
+}
+
+SceneDescription read_scene_cache(const std::string& cache_path) {
+    PROFILE_ZONE("scene_cache_read");
+    auto file          = std::make_shared<MappedFile>(cache_path);
+    const auto* header = valid_header(*file);
+    if (!header) {
+        throw std::runtime_error{"scene cache: invalid or outdated file " + cache_path};
+    }
+
+    SceneDescription desc;
+
+    auto& settings             = desc.settings;
+    settings.image_width       = header->image_width;
+    settings.image_height      = header->image_height;
+    settings.samples_per_pixel = header->samples_per_pixel;
+    settings.output = std::string{
+        header->output, std::find(std::begin(header->output), std::end(header->output), '\0')};
+
+    const auto* loc = header->camera_location;
+    const auto* dir = header->camera_look_at;
+    desc.camera     = create_camera({loc[0], loc[1], loc[2]}, {dir[0], dir[1], dir[2]});
+    desc.camera->set_vfov(header->camera_vfov);
+    desc.camera->set_aspect_ratio(header->camera_aspect_ratio);
+
+    const auto* cached_materials = section_data<CachedMaterial>(*file, header->materials);
+    const auto* texture_paths    = section_data<CachedPath>(*file, header->texture_paths);
+    std::vector<std::shared_ptr<Material>> materials;
+    for (size_t i{}; i < header->materials.count; ++i) {
+        materials.push_back(
+            to_material(cached_materials[i], texture_paths, header->texture_paths.count));
+    }
+
+    desc.scene = std::make_shared<TestScene>();
+    desc.scene->clear();
+
+    const auto* objects = section_data<CachedObject>(*file, header->objects);
+    for (size_t i{}; i < header->objects.count; ++i) {
+        const auto& object = objects[i];
+        if (object.material >= materials.size()) {
+            throw std::runtime_error{"scene cache: corrupt material index"};
+        }
+        desc.scene->add(std::make_shared<Geometry>(
+            to_shape(object.shape), materials[object.material], to_transform(object.transform)));
+    }
+
+    const auto* lights = section_data<CachedLight>(*file, header->lights);
+    for (size_t i{}; i < header->lights.count; ++i) {
+        const auto& light = lights[i];
+        TransformedShape t_shape{to_shape(light.shape), to_transform(light.transform)};
+        RgbColor color{light.color[0], light.color[1], light.color[2]};
+        // The shape tells the kind of light apart
+        if (light.shape == ShapeKind::sphere) {
+            desc.scene->add(std::make_shared<SphereLight>(t_shape, color, light.intensity));
+        } else {
+            desc.scene->add(std::make_shared<AreaLight>(t_shape, color, light.intensity));
+        }
+    }
+
+    // The BVH is used in place, the scene keeps the mapping alive
+    const auto* nodes   = section_data<BvhNode>(*file, header->bvh_nodes);
+    const auto* indices = section_data<uint32_t>(*file, header->bvh_indices);
+    validate_bvh(nodes, header->bvh_nodes.count, indices, header->bvh_indices.count);
+    if (header->bvh_indices.count != header->objects.count + header->lights.count) {
+        throw std::runtime_error{"scene cache: BVH doesn't match the scene"};
+    }
+    Bvh bvh;
+    bvh.assign(nodes, header->bvh_nodes.count, indices, header->bvh_indices.count, file);
+    desc.scene->set_accelerator(std::move(bvh));
+
+    const auto* animations = section_data<CachedAnimation>(*file, header->animations);
+    for (size_t i{}; i < header->animations.count; ++i) {
+        const auto& cached = animations[i];
+        auto limit = cached.is_light ? header->lights.count : header->objects.count;
+        if (cached.index >= limit) {
+            throw std::runtime_error{"scene cache: corrupt animation index"};
+        }
+
+        auto to_vec3 = [](const double* v) { return Vec3{v[0], v[1], v[2]}; };
+        ObjectAnimation animation;
+        animation.is_light = cached.is_light != 0;
+        animation.index    = cached.index;
+        animation.location = to_vec3(cached.location);
+        animation.rotation = to_vec3(cached.rotation);
+        animation.scale    = to_vec3(cached.scale);
+        animation.velocity = to_vec3(cached.velocity);
+        animation.spin     = to_vec3(cached.spin);
+        desc.animations.push_back(animation);
+    }
+
+    return desc;
+}
+
+SceneDescription load_scene_cached(const std::string& scene_path) {
+    PROFILE_ZONE("scene_load");
+    auto cache_path = scene_cache_path(scene_path);
+    if (is_scene_cache_fresh(cache_path, scene_path)) {
+        return read_scene_cache(cache_path);
+    }
+
+    auto desc = load_scene_file(scene_path);
+    try {
+        write_scene_cache(desc, scene_path, cache_path);
+    } catch (const std::exception& e) {
+        // A missing cache only costs startup time next run
+        std::cerr << e.what() << "\n";
+    }
+    return desc;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "scene_loader.h"
+
+// Binary scene cache
+// ------------------
+// A versioned, memory mappable image of a loaded scene: render settings, camera, material table,
+// flattened object and light transforms (matrix and inverse) and the scene BVH. All sections are
+// plain data at 8 byte aligned offsets, so the BVH is used straight from the mapping and objects
+// are created from the tables without any text parsing or matrix inversion.
+//
+// A cache is fresh when its version matches and it records the size and modification time of
+// the scene file it was built from.
+
+std::string scene_cache_path(const std::string& scene_path);
+
+bool is_scene_cache_fresh(const std::string& cache_path, const std::string& scene_path);
+
+/// @brief Serialize a loaded scene. Throws std::runtime_error if the scene contains objects the
+/// format can't describe or the file can't be written.
+void write_scene_cache(const SceneDescription& desc,
+                       const std::string& scene_path,
+                       const std::string& cache_path);
+
+/// @brief Load a scene from a cache file. Throws std::runtime_error on a corrupt or stale format.
+SceneDescription read_scene_cache(const std::string& cache_path);
+
+/// @brief Load a scene file through its cache: use the cache if it is fresh, otherwise parse the
+/// scene, build the BVH and (re)write the cache next to the scene file.
+SceneDescription load_scene_cached(const std::string& scene_path);
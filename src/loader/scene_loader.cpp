@@ -0,0 +1,238 @@
+#include "scene_loader.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "light.h"
+#include "objects.h"
+#include "profiler.h"
+#include "shape.h"
+#include "statement_parser.h"
+
+SceneDescription SceneLoader::load(std::istream& in, const std::string& base_dir) {
+    PROFILE_ZONE("scene_parse");
+    this->base_dir   = base_dir;
+    desc             = {};
+    desc.scene       = std::make_shared<TestScene>();
+    materials        = {};
+    unique_materials = {};
+    camera_location  = {0, 0, 0};
+    camera_focus     = {0, 0, -1};
+    camera_vfov      = 60.0;
+    desc.scene->clear();
+
+    size_t line_number{};
+    for (std::string line; std::getline(in, line);) {
+        ++line_number;
+        auto tokens = tokenize(line);
+        if (tokens.empty()) {
+            continue;
+        }
+
+        try {
+            parse_statement(tokens);
+        } catch (const std::exception& e) {
+            throw std::runtime_error{"line " + std::to_string(line_number) + ": " + e.what()};
+        }
+    }
+
+    desc.scene->build_accelerator();
+
+    const auto& settings = desc.settings;
+    desc.camera          = create_camera(camera_location, {0, 0, -1});
+    desc.camera->set_aspect_ratio(static_cast<double>(settings.image_width) / settings.image_height);
+    desc.camera->focus_on_point(camera_focus);
+    desc.camera->set_vfov(camera_vfov);
+
+    return desc;
+}
+
+SceneDescription SceneLoader::load_file(const std::string& path) {
+    std::ifstream file{path};
+    if (file.fail()) {
+        throw std::runtime_error{"can't open scene file: " + path};
+    }
+    return load(file, std::filesystem::path{path}.parent_path().string());
+}
+
+void SceneLoader::parse_statement(const Tokens& tokens) {
+    const auto& keyword = tokens.front();
+    if (keyword == "film") {
+        parse_film(tokens);
+    } else if (keyword == "camera") {
+        parse_camera(tokens);
+    } else if (keyword == "material") {
+        parse_material(tokens);
+    } else if (keyword == "shape") {
+        parse_shape(tokens);
+    } else if (keyword == "area_light") {
+        parse_area_light(tokens);
+    } else if (keyword == "sphere_light") {
+        parse_sphere_light(tokens);
+    } else {
+        throw std::runtime_error{"unknown statement '" + keyword + "'"};
+    }
+}
+
+void SceneLoader::parse_film(const Tokens& tokens) {
+    Attributes attr{tokens, 1};
+    attr.expect_only({"width", "height", "spp", "output"});
+
+    auto& settings             = desc.settings;
+    settings.image_width       = static_cast<int>(attr.get_double("width", settings.image_width));
+    settings.image_height      = static_cast<int>(attr.get_double("height", settings.image_height));
+    settings.samples_per_pixel = static_cast<size_t>(
+        attr.get_double("spp", static_cast<double>(settings.samples_per_pixel)));
+    settings.output = attr.get_string("output", settings.output);
+
+    if (settings.image_width <= 0 || settings.image_height <= 0 || settings.samples_per_pixel == 0) {
+        throw std::runtime_error{"film size and spp must be positive"};
+    }
+}
+
+void SceneLoader::parse_camera(const Tokens& tokens) {
+    Attributes attr{tokens, 1};
+    attr.expect_only({"location", "focus", "vfov"});
+
+    camera_location = attr.get_vec3("location", camera_location);
+    camera_focus    = attr.get_vec3("focus", camera_focus);
+    camera_vfov     = attr.get_double("vfov", camera_vfov);
+}
+
+void SceneLoader::parse_material(const Tokens& tokens) {
+    if (tokens.size() < 3) {
+        throw std::runtime_error{"material expects a name and a type"};
+    }
+
+    const auto& name = tokens[1];
+    const auto& type = tokens[2];
+    Attributes attr{tokens, 3, {"texture"}};
+
+    std::shared_ptr<Material> material;
+    std::ostringstream key;
+    key.precision(17);
+
+    if (type == "diffuse") {
+        attr.expect_only({"albedo", "reflectance", "texture"});
+        auto albedo      = attr.get_vec3("albedo", Vec3::one());
+        auto reflectance = attr.get_double("reflectance", 0.8);
+        std::shared_ptr<ImageTexture> texture;
+        if (attr.has("texture")) {
+            std::filesystem::path texture_path{attr.get_string("texture", "")};
+            if (texture_path.is_relative() && !base_dir.empty()) {
+                texture_path = std::filesystem::path{base_dir} / texture_path;
+            }
+            texture = load_image_texture(texture_path.string());
+        }
+        key << "diffuse " << albedo.x() << " " << albedo.y() << " " << albedo.z() << " "
+            << reflectance << " " << (texture ? texture->get_path() : "");
+        material = std::make_shared<MaterialDiffuse>(
+            RgbColor{albedo.x(), albedo.y(), albedo.z()}, reflectance, texture);
+    } else if (type == "glass") {
+        attr.expect_only({"ior"});
+        auto ior = attr.get_double("ior", 1.52);
+        key << "glass " << ior;
+        material = std::make_shared<Glass>(ior);
+    } else if (type == "mirror") {
+        attr.expect_only({});
+        key << "mirror";
+        material = std::make_shared<PerfectMirror>();
+    } else {
+        throw std::runtime_error{"unknown material type '" + type + "'"};
+    }
+
+    // Share one instance between identical definitions
+    auto [it, inserted] = unique_materials.try_emplace(key.str(), material);
+    materials[name]     = it->second;
+}
+
+void SceneLoader::parse_shape(const Tokens& tokens) {
+    if (tokens.size() < 2) {
+        throw std::runtime_error{"shape expects a type"};
+    }
+
+    const auto& type = tokens[1];
+    Attributes attr{tokens, 2};
+    attr.expect_only({"material", "location", "rotation", "scale", "velocity", "spin"});
+
+    std::shared_ptr<Shape> shape;
+    if (type == "sphere") {
+        shape = primitives.sphere;
+    } else if (type == "rect_xz") {
+        shape = primitives.rect_xz;
+    } else {
+        throw std::runtime_error{"unknown shape type '" + type + "'"};
+    }
+
+    if (!attr.has("material")) {
+        throw std::runtime_error{"shape without material"};
+    }
+    auto material = find_material(attr.get_string("material", ""));
+
+    auto location = attr.get_vec3("location", Vec3::zero());
+    auto rotation = attr.get_vec3("rotation", Vec3::zero());
+    auto scale    = attr.get_scale("scale", Vec3::one());
+    add_animation(attr, false, desc.scene->object_count());
+    desc.scene->add(create_geometry(shape, material, location, rotation, scale));
+}
+
+void SceneLoader::parse_area_light(const Tokens& tokens) {
+    Attributes attr{tokens, 1};
+    attr.expect_only(
+        {"location", "rotation", "scale", "color", "intensity", "velocity", "spin"});
+
+    auto location  = attr.get_vec3("location", Vec3::zero());
+    auto rotation  = attr.get_vec3("rotation", Vec3::zero());
+    auto scale     = attr.get_scale("scale", Vec3::one());
+    auto color     = attr.get_vec3("color", Vec3::one());
+    auto intensity = attr.get_double("intensity", 1.0);
+    add_animation(attr, true, desc.scene->light_count());
+    desc.scene->add(create_area_light(
+        location, rotation, scale, {color.x(), color.y(), color.z()}, intensity));
+}
+
+void SceneLoader::parse_sphere_light(const Tokens& tokens) {
+    Attributes attr{tokens, 1};
+    attr.expect_only({"location", "scale", "color", "intensity", "velocity", "spin"});
+
+    auto location  = attr.get_vec3("location", Vec3::zero());
+    auto scale     = attr.get_scale("scale", Vec3::one());
+    auto color     = attr.get_vec3("color", Vec3::one());
+    auto intensity = attr.get_double("intensity", 1.0);
+    if (scale.x() != scale.y() || scale.x() != scale.z()) {
+        throw std::runtime_error{"sphere_light needs a uniform scale"};
+    }
+    add_animation(attr, true, desc.scene->light_count());
+    desc.scene->add(
+        create_sphere_light(location, scale.x(), {color.x(), color.y(), color.z()}, intensity));
+}
+
+void SceneLoader::add_animation(const Attributes& attr, bool is_light, size_t index) {
+    if (!attr.has("velocity") && !attr.has("spin")) {
+        return;
+    }
+
+    ObjectAnimation animation;
+    animation.is_light = is_light;
+    animation.index    = index;
+    animation.location = attr.get_vec3("location", Vec3::zero());
+    animation.rotation = attr.get_vec3("rotation", Vec3::zero());
+    animation.scale    = attr.get_scale("scale", Vec3::one());
+    animation.velocity = attr.get_vec3("velocity", Vec3::zero());
+    animation.spin     = attr.get_vec3("spin", Vec3::zero());
+    desc.animations.push_back(animation);
+}
+
+std::shared_ptr<Material> SceneLoader::find_material(const std::string& name) const {
+    auto it = materials.find(name);
+    if (it == materials.end()) {
+        throw std::runtime_error{"undeclared material '" + name + "'"};
+    }
+    return it->second;
+}
+
+SceneDescription load_scene_file(const std::string& path) {
+    return SceneLoader{}.load_file(path);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "animation.h"
+#include "camera.h"
+#include "material.h"
+#include "scene.h"
+
+class Attributes;
+
+// Scene description format
+// ------------------------
+// Line based, one statement per line, '#' starts a comment. Every statement is a keyword followed
+// by "name value..." attributes in any order:
+//
+//   film      width 300 height 200 spp 16 output scene.png
+//   camera    location 0 4 6 focus 0 0 0 vfov 60
+//   material  <name> diffuse albedo 1 0 0 reflectance 0.8 texture wood.png
+//   material  <name> glass ior 1.52
+//   material  <name> mirror
+//   shape     sphere|rect_xz material <name> location x y z rotation x y z scale s|sx sy sz
+//   area_light location x y z rotation x y z scale s|sx sy sz color r g b intensity i
+//   sphere_light location x y z scale radius color r g b intensity i
+//
+// Shapes and lights may also move linearly over an animation: "velocity x y z" in units and
+// "spin x y z" in degrees per frame.
+//
+// A diffuse texture multiplies the albedo. Texture paths are relative to the scene file, see
+// image_texture.h for how they are loaded.
+//
+// Materials must be declared before they are referenced. Materials with identical parameters are
+// shared even if declared under different names, and shapes always refer to the shared
+// 'primitives', so instancing works the same way as in the hard-coded scenes.
+
+struct RenderSettings {
+    int image_width{300};
+    int image_height{200};
+    size_t samples_per_pixel{16};
+    std::string output{"output.png"};
+};
+
+struct SceneDescription {
+    std::shared_ptr<TestScene> scene;
+    std::shared_ptr<Camera> camera;
+    RenderSettings settings;
+
+    /// Objects and lights that move over frames, empty for static scenes
+    std::vector<ObjectAnimation> animations;
+};
+
+class SceneLoader {
+  public:
+    /// @brief Parse a scene statement by statement from a stream. Throws std::runtime_error with
+    /// the offending line number on malformed input. Relative texture paths are resolved against
+    /// 'base_dir'.
+    SceneDescription load(std::istream& in, const std::string& base_dir = "");
+
+    SceneDescription load_file(const std::string& path);
+
+  private:
+    using Tokens = std::vector<std::string>;
+
+    void parse_statement(const Tokens& tokens);
+
+    void parse_film(const Tokens& tokens);
+    void parse_camera(const Tokens& tokens);
+    void parse_material(const Tokens& tokens);
+    void parse_shape(const Tokens& tokens);
+    void parse_area_light(const Tokens& tokens);
+    void parse_sphere_light(const Tokens& tokens);
+
+    std::shared_ptr<Material> find_material(const std::string& name) const;
+
+    void add_animation(const Attributes& attr, bool is_light, size_t index);
+
+    SceneDescription desc;
+    std::string base_dir;
+
+    Vec3 camera_location{0, 0, 0};
+    Vec3 camera_focus{0, 0, -1};
+    double camera_vfov{60.0};
+
+    /// Declared name -> material
+    std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+
+    /// Canonical parameter string -> material, used to share identical definitions
+    std::unordered_map<std::string, std::shared_ptr<Material>> unique_materials;
+};
+
+SceneDescription load_scene_file(const std::string& path);
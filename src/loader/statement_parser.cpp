@@ -0,0 +1,104 @@
+#include "statement_parser.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+bool is_number(const std::string& token) {
+    char* end{};
+    std::strtod(token.c_str(), &end);
+    return end != token.c_str() && *end == '\0';
+}
+
+}  // namespace
+
+std::vector<std::string> tokenize(const std::string& line) {
+    std::vector<std::string> tokens;
+    std::istringstream words{line.substr(0, line.find('#'))};
+    for (std::string word; words >> word;) {
+        tokens.push_back(word);
+    }
+    return tokens;
+}
+
+Attributes::Attributes(const std::vector<std::string>& tokens,
+                       size_t first,
+                       const std::vector<std::string>& string_attributes) {
+    for (size_t i{first}; i < tokens.size(); ++i) {
+        const auto& name = tokens[i];
+        if (is_number(name)) {
+            throw std::runtime_error{"unexpected value '" + name + "'"};
+        }
+
+        auto& values = attributes[name];
+        if (std::find(string_attributes.begin(), string_attributes.end(), name) !=
+            string_attributes.end()) {
+            if (i + 1 >= tokens.size()) {
+                throw std::runtime_error{"missing value for '" + name + "'"};
+            }
+            values.push_back(tokens[++i]);
+            continue;
+        }
+
+        while (i + 1 < tokens.size() && is_number(tokens[i + 1])) {
+            values.push_back(tokens[++i]);
+        }
+    }
+}
+
+std::string Attributes::get_string(const std::string& name, const std::string& fallback) const {
+    auto it = attributes.find(name);
+    return it == attributes.end() ? fallback : it->second.front();
+}
+
+std::vector<double> Attributes::get_numbers(const std::string& name) const {
+    std::vector<double> res;
+    for (const auto& v : attributes.at(name)) {
+        res.push_back(std::stod(v));
+    }
+    return res;
+}
+
+double Attributes::get_double(const std::string& name, double fallback) const {
+    if (!has(name)) {
+        return fallback;
+    }
+    auto values = get_numbers(name);
+    if (values.size() != 1) {
+        throw std::runtime_error{"'" + name + "' expects 1 value"};
+    }
+    return values.front();
+}
+
+Vec3 Attributes::get_vec3(const std::string& name, const Vec3& fallback) const {
+    if (!has(name)) {
+        return fallback;
+    }
+    auto values = get_numbers(name);
+    if (values.size() != 3) {
+        throw std::runtime_error{"'" + name + "' expects 3 values"};
+    }
+    return {values[0], values[1], values[2]};
+}
+
+Vec3 Attributes::get_scale(const std::string& name, const Vec3& fallback) const {
+    if (!has(name)) {
+        return fallback;
+    }
+    auto values = get_numbers(name);
+    if (values.size() == 1) {
+        return Vec3::all(values[0]);
+    }
+    return get_vec3(name, fallback);
+}
+
+void Attributes::expect_only(const std::vector<std::string>& allowed) const {
+    for (const auto& [name, values] : attributes) {
+        if (std::find(allowed.begin(), allowed.end(), name) == allowed.end()) {
+            throw std::runtime_error{"unknown attribute '" + name + "'"};
+        }
+    }
+}
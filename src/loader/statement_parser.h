@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vec.h"
+
+// Helpers shared by the line based formats of the loader, see scene_loader.h
+
+/// Split a line into whitespace separated words, dropping everything after '#'
+std::vector<std::string> tokenize(const std::string& line);
+
+// Attributes of a statement, e.g. "location 0 1 0 scale 2" -> {location: [0, 1, 0], scale: [2]}
+class Attributes {
+  public:
+    /// @brief Parse tokens[first..]. Attributes named in 'string_attributes' take a single word
+    /// instead of a list of numbers.
+    Attributes(const std::vector<std::string>& tokens,
+               size_t first,
+               const std::vector<std::string>& string_attributes = {"material", "output"});
+
+    bool has(const std::string& name) const { return attributes.count(name) > 0; }
+
+    std::string get_string(const std::string& name, const std::string& fallback) const;
+
+    std::vector<double> get_numbers(const std::string& name) const;
+
+    double get_double(const std::string& name, double fallback) const;
+
+    Vec3 get_vec3(const std::string& name, const Vec3& fallback) const;
+
+    // Accept either a single uniform factor or one factor per axis
+    Vec3 get_scale(const std::string& name, const Vec3& fallback) const;
+
+    // Reject typos instead of silently falling back to defaults
+    void expect_only(const std::vector<std::string>& allowed) const;
+
+  private:
+    std::unordered_map<std::string, std::vector<std::string>> attributes;
+};
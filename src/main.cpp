@@ -1,10 +1,256 @@
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "batch_runner.h"
+#include "bdpt.h"
+#include "coordinator.h"
+#include "denoiser.h"
+#include "film.h"
+#include "image.h"
+#include "light.h"
 #include "logger.h"
+#include "mlt.h"
 #include "pathtracer.h"
+#include "profiler.h"
 #include "renderer.h"
 #include "scene.h"
+#include "scene_cache.h"
+#include "texture_cache.h"
 #include "timer.h"
+#include "worker.h"
+
+// Command line settings shared by all render modes
+struct Options {
+    bool denoise{false};
+    AovType aovs{AovType::none};
+    bool print_stats{false};
+    double time_budget{};
+    uint64_t seed{};
+    std::optional<ImageTile> crop;
+    std::string film_path;
+    DisplayOptions display;
+    PreviewOptions preview;
+    std::shared_ptr<const PathPolicy> path_policy;
+    bool guiding{false};
+    bool caustics{false};
+    CausticOptions caustic_options;
+    bool bdpt{false};
+    bool mlt{false};
+    std::optional<LightSampling> light_sampling;  // else each light's default
+
+    /// @brief The path tracer, or the bidirectional or Metropolis one with --bdpt or --mlt, set
+    /// up with these options. Throws std::runtime_error on options the renderer can't honor.
+    std::unique_ptr<RayTracer> create_renderer(int w, int h, size_t spp) const {
+        auto p_sampler = std::make_shared<PixelSampler>();
+        if (bdpt) {
+            // Previews resolve the film alone, without the light tracing splats
+            if (!preview.path.empty()) {
+                throw std::runtime_error{"--bdpt renders have no previews"};
+            }
+            if (has_path_tracer_options()) {
+                throw std::runtime_error{
+                    "--bdpt takes no path policy, guiding or caustics options"};
+            }
+            auto renderer = std::make_unique<BidirectionalPathTracer>(w, h, p_sampler, spp);
+            apply(*renderer);
+            return renderer;
+        }
+        if (mlt && (time_budget > 0.0 || !preview.path.empty())) {
+            throw std::runtime_error{"--mlt renders have neither time budgets nor previews"};
+        }
+        auto renderer = mlt ? std::make_unique<MetropolisRenderer>(w, h, p_sampler, spp)
+                            : std::make_unique<PathTracer>(w, h, p_sampler, spp);
+        apply(*renderer);
+        if (path_policy) {
+            renderer->set_path_policy(path_policy);
+        }
+        renderer->set_guiding(guiding);
+        renderer->set_caustics(caustics, caustic_options);
+        return renderer;
+    }
+
+    // Options only the path tracer and its Metropolis variant honor
+    bool has_path_tracer_options() const {
+        CausticOptions defaults;
+        return path_policy || guiding || caustics || caustic_options.photons != defaults.photons ||
+               caustic_options.radius != defaults.radius;
+    }
+
+    void apply(RayTracer& renderer) const {
+        renderer.set_denoise(denoise);
+        renderer.set_aovs(aovs);
+        renderer.set_time_budget(time_budget);
+        renderer.set_seed(seed);
+        renderer.set_crop_window(crop);
+        renderer.set_display_options(display);
+        renderer.set_preview(preview);
+    }
+
+    void apply(TestScene& scene) const { scene.set_light_sampling(light_sampling); }
+
+    // Time budget renders also write their per-pixel sample counts
+    bool save_aovs() const { return aovs != AovType::none || time_budget > 0.0; }
+};
+
+// "x0,y0,x1,y1" -> pixel window
+ImageTile parse_crop_window(const std::string& text) {
+    std::istringstream in{text};
+    ImageTile tile;
+    char c1{};
+    char c2{};
+    char c3{};
+    if (!(in >> tile.x0 >> c1 >> tile.y0 >> c2 >> tile.x1 >> c3 >> tile.y1) || c1 != ',' ||
+        c2 != ',' || c3 != ',') {
+        throw std::runtime_error{"--crop expects x0,y0,x1,y1"};
+    }
+    return tile;
+}
+
+// Write a film of the full image as the final output, denoised if the film has the features
+void save_film_output(const Film& film, const std::string& output, const Options& options) {
+    auto film_aovs    = film.get_aovs();
+    bool denoise_film = options.denoise && has_aov(film_aovs, AovType::albedo) &&
+                        has_aov(film_aovs, AovType::normal) && has_aov(film_aovs, AovType::depth);
+    if (options.denoise && !denoise_film) {
+        std::cerr << "film lacks the AOVs needed to denoise\n";
+    }
+
+    Buffer2D<RgbColor> radiance;
+    Buffer2D<double> variance;
+    AovBuffers aovs;
+    film.resolve(radiance, aovs, denoise_film ? &variance : nullptr);
+    if (denoise_film) {
+        radiance = denoise(radiance, {aovs.albedo, aovs.normal, aovs.depth, variance});
+    }
+
+    Image image{film.get_width(), film.get_height()};
+    write_display_image(radiance, options.display, image);
+    image.save(output);
+    if (film.get_aovs() != AovType::none) {
+        aovs.save(output.substr(0, output.rfind('.')));
+    }
+    if (!options.film_path.empty()) {
+        film.save(options.film_path);
+    }
+}
+
+// Composite partial films of one image, rendered by tile or by sample range, into the final
+// image
+int merge_films(const std::string& output, const std::vector<std::string>& parts, const Options& options) {
+    if (parts.empty()) {
+        std::cerr << "--merge expects at least one film\n";
+        return 1;
+    }
+
+    save_film_output(merge_film_files(parts), output, options);
+    std::cout << "merged " << parts.size() << " films into " << output << "\n";
+    return 0;
+}
+
+// Render a scene file on worker processes that connect to 'address', optionally starting
+// 'spawn_count' local workers first
+int render_distributed(const std::string& path,
+                       const std::string& address,
+                       size_t spawn_count,
+                       const CoordinatorOptions& coordinator_options,
+                       const Options& options) {
+    // Light paths of these splat outside the film that workers send back
+    if (options.bdpt || options.mlt) {
+        throw std::runtime_error{"--bdpt and --mlt renders can't be distributed"};
+    }
+    // Every work unit renders on a fresh path tracer, which would trace its own photon map and
+    // train its own guiding
+    if (options.guiding || options.caustics) {
+        throw std::runtime_error{"--guiding and --caustics renders can't be distributed"};
+    }
+
+    auto desc            = load_scene_cached(path);
+    const auto& settings = desc.settings;
+
+    RenderSetup setup;
+    setup.scene        = path;
+    setup.image_width  = settings.image_width;
+    setup.image_height = settings.image_height;
+    setup.aovs         = options.aovs;
+    setup.seed         = options.seed;
+    if (options.path_policy) {
+        setup.path_policy = options.path_policy->name();
+    }
+    setup.light_sampling = options.light_sampling;
+    if (options.denoise) {
+        setup.aovs = setup.aovs | AovType::albedo | AovType::normal | AovType::depth;
+    }
 
-int main() {
+    Coordinator coordinator{address, coordinator_options};
+    std::vector<pid_t> children;
+    for (size_t i{}; i < spawn_count; ++i) {
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::execl("/proc/self/exe", "v3", "--worker", coordinator.get_address().c_str(), nullptr);
+            std::_Exit(127);
+        }
+        if (pid > 0) {
+            children.push_back(pid);
+        }
+    }
+
+    std::cout << "render " << path << " distributed:\n";
+    Timer timer;
+    auto film          = coordinator.render(setup, settings.samples_per_pixel);
+    size_t render_time = timer.reset();
+    coordinator.shutdown_workers();
+    for (auto pid : children) {
+        ::waitpid(pid, nullptr, 0);
+    }
+
+    save_film_output(film, settings.output, options);
+    std::cout << "render time: " << format_time(render_time) << "\n";
+    return 0;
+}
+
+// Render a scene description file, see scene_loader.h for the format
+int render_scene_file(const std::string& path, const Options& options) {
+    Timer load_timer;
+    auto [scene, camera, settings, animations] = load_scene_cached(path);
+    double load_time = load_timer.seconds();
+
+    auto renderer_ptr = options.create_renderer(
+        settings.image_width, settings.image_height, settings.samples_per_pixel);
+    auto& renderer = *renderer_ptr;
+    options.apply(*scene);
+    renderer.load_scene(scene);
+
+    std::cout << "render " << path << ":\n";
+    Timer timer;
+    renderer.render(*camera);
+    size_t render_time = timer.reset();
+
+    renderer.save_output(settings.output);
+    if (options.save_aovs()) {
+        renderer.save_aovs(settings.output.substr(0, settings.output.rfind('.')));
+    }
+    if (!options.film_path.empty()) {
+        renderer.get_film().save(options.film_path);
+    }
+    std::cout << "render time: " << format_time(render_time) << "\n";
+
+    if (options.print_stats) {
+        auto stats = renderer.get_stats();
+        stats.stages.insert(stats.stages.begin(), {"load", load_time});
+        stats.add_stage("save", timer.seconds());
+        stats.print(std::cout);
+    }
+    return 0;
+}
+
+// Render the hard coded test scene
+int render_builtin_scene(const Options& options) {
     constexpr bool small_img = true;
     constexpr int image_w    = small_img ? 300 : 600;
     constexpr int image_h    = small_img ? 200 : 400;
@@ -16,9 +262,9 @@ int main() {
     cam1->focus_on_point({0, 0, 0});
     cam1->set_vfov(60);
 
-    size_t spp     = 16;
-    auto p_sampler = std::make_shared<PixelSampler>();
-    PathTracer renderer{image_w, image_h, p_sampler, spp};
+    size_t spp        = 16;
+    auto renderer_ptr = options.create_renderer(image_w, image_h, spp);
+    auto& renderer    = *renderer_ptr;
 
     auto scene = std::make_shared<TestScene>();
     renderer.load_scene(scene);
@@ -54,11 +300,180 @@ int main() {
 
     std::cout << "\nrender scene3:\n";
     scene->load_scene3();
+    options.apply(*scene);
 
     timer.reset();
     renderer.render(*cam1);
     render_time = timer.reset();
 
     renderer.save_output("../../results/scene3.png");
+    if (options.save_aovs()) {
+        renderer.save_aovs("../../results/scene3");
+    }
     std::cout << "render time for scene 3: " << format_time(render_time) << "\n";
-}
\ No newline at end of file
+    if (options.print_stats) {
+        renderer.get_stats().print(std::cout);
+    }
+    return 0;
+}
+
+// Usage: v3 [--denoise] [--aovs depth,normal,...|all] [--time-budget seconds] [--seed n] [--stats]
+//           [--exposure stops] [--tonemap clamp|reinhard|aces|filmic] [--linear] [--dither]
+//           [--preview preview.png] [--preview-interval seconds] [--preview-passes count]
+//           [--path-policy constant|throughput|throughput-split] [--guiding]
+//           [--caustics] [--caustic-photons count] [--caustic-radius r] [--sppm] [--bdpt] [--mlt]
+//           [--light-sampling area|solid-angle] [--texture-cache-mb size]
+//           [--crop x0,y0,x1,y1] [--film partial.film] [--trace trace.json]
+//           [--jobs job list | [--frames count] scene file]
+//        v3 --merge output.png [--denoise] [--film merged.film] part.film...
+//        v3 --coordinator address [--workers count] [--tile size] [--sample-splits count]
+//           [--unit-timeout seconds] [--seed n] [--denoise] [--aovs ...] [--film full.film]
+//           [--path-policy ...] [--light-sampling ...] scene file
+//        v3 --worker address
+int run(int argc, char* argv[]) {
+    Options options;
+    std::string trace_path;
+    std::string jobs_path;
+    std::string merge_output;
+    std::string coordinator_address;
+    std::string worker_address;
+    size_t spawn_count{};
+    CoordinatorOptions coordinator_options;
+    size_t frame_count{};
+    std::vector<std::string> inputs;
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--denoise") {
+            options.denoise = true;
+        } else if (arg == "--time-budget" && i + 1 < argc) {
+            options.time_budget = std::stod(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (arg == "--exposure" && i + 1 < argc) {
+            options.display.exposure = std::stod(argv[++i]);
+        } else if (arg == "--tonemap" && i + 1 < argc) {
+            options.display.tonemapper = parse_tonemapper(argv[++i]);
+        } else if (arg == "--linear") {
+            options.display.srgb = false;
+        } else if (arg == "--dither") {
+            options.display.dither = true;
+        } else if (arg == "--preview" && i + 1 < argc) {
+            options.preview.path = argv[++i];
+        } else if (arg == "--preview-interval" && i + 1 < argc) {
+            options.preview.interval = std::stod(argv[++i]);
+        } else if (arg == "--preview-passes" && i + 1 < argc) {
+            options.preview.passes = std::stoul(argv[++i]);
+        } else if (arg == "--path-policy" && i + 1 < argc) {
+            options.path_policy = create_path_policy(argv[++i]);
+        } else if (arg == "--guiding") {
+            options.guiding = true;
+        } else if (arg == "--caustics") {
+            options.caustics = true;
+        } else if (arg == "--caustic-photons" && i + 1 < argc) {
+            options.caustic_options.photons = std::stoul(argv[++i]);
+        } else if (arg == "--caustic-radius" && i + 1 < argc) {
+            options.caustic_options.radius = std::stod(argv[++i]);
+        } else if (arg == "--sppm") {
+            options.caustics                    = true;
+            options.caustic_options.progressive = true;
+        } else if (arg == "--bdpt") {
+            options.bdpt = true;
+        } else if (arg == "--mlt") {
+            options.mlt = true;
+        } else if (arg == "--light-sampling" && i + 1 < argc) {
+            options.light_sampling = parse_light_sampling(argv[++i]);
+        } else if (arg == "--texture-cache-mb" && i + 1 < argc) {
+            TextureCache::global().set_budget(std::stoull(argv[++i]) << 20);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs_path = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frame_count = std::stoul(argv[++i]);
+        } else if (arg == "--stats") {
+            options.print_stats = true;
+        } else if (arg == "--aovs" && i + 1 < argc) {
+            options.aovs = parse_aov_list(argv[++i]);
+        } else if (arg == "--crop" && i + 1 < argc) {
+            options.crop = parse_crop_window(argv[++i]);
+        } else if (arg == "--film" && i + 1 < argc) {
+            options.film_path = argv[++i];
+        } else if (arg == "--merge" && i + 1 < argc) {
+            merge_output = argv[++i];
+        } else if (arg == "--coordinator" && i + 1 < argc) {
+            coordinator_address = argv[++i];
+        } else if (arg == "--worker" && i + 1 < argc) {
+            worker_address = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            spawn_count = std::stoul(argv[++i]);
+        } else if (arg == "--tile" && i + 1 < argc) {
+            coordinator_options.tile_size = std::stoi(argv[++i]);
+        } else if (arg == "--sample-splits" && i + 1 < argc) {
+            coordinator_options.sample_splits = std::stoul(argv[++i]);
+        } else if (arg == "--unit-timeout" && i + 1 < argc) {
+            coordinator_options.unit_timeout = std::stod(argv[++i]);
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    std::string scene_path = inputs.empty() ? "" : inputs.back();
+
+    Profiler::set_enabled(!trace_path.empty());
+
+    int res{};
+    if (!merge_output.empty()) {
+        res = merge_films(merge_output, inputs, options);
+    } else if (!worker_address.empty()) {
+        Worker{}.run(worker_address);
+    } else if (!coordinator_address.empty() && !scene_path.empty()) {
+        res = render_distributed(
+            scene_path, coordinator_address, spawn_count, coordinator_options, options);
+    } else if (!jobs_path.empty() || (frame_count > 0 && !scene_path.empty())) {
+        BatchRunner runner;
+        runner.set_denoise(options.denoise);
+        runner.set_aovs(options.aovs);
+        runner.set_time_budget(options.time_budget);
+        runner.set_seed(options.seed);
+        runner.set_display_options(options.display);
+        if (options.path_policy) {
+            runner.set_path_policy(options.path_policy);
+        }
+        runner.set_guiding(options.guiding);
+        runner.set_caustics(options.caustics, options.caustic_options);
+        runner.set_bidirectional(options.bdpt);
+        runner.set_metropolis(options.mlt);
+        runner.set_light_sampling(options.light_sampling);
+        runner.set_print_stats(options.print_stats);
+        if (jobs_path.empty()) {
+            RenderJob sequence;
+            sequence.scene  = scene_path;
+            sequence.frames = {0, frame_count};
+            sequence.crop   = options.crop;
+            if (!options.film_path.empty()) {
+                sequence.film = options.film_path;
+            }
+            runner.run({sequence});
+        } else {
+            runner.run(load_job_list(jobs_path));
+        }
+    } else if (!scene_path.empty()) {
+        res = render_scene_file(scene_path, options);
+    } else {
+        res = render_builtin_scene(options);
+    }
+
+    if (!trace_path.empty()) {
+        Profiler::write_chrome_trace(trace_path);
+    }
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    // Bad flags, scene files and job lists end the program with their message
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -74,6 +74,11 @@ RgbColor BsdfDiffuse::evaluate(const Vec3& shading_wo, const Vec3& shading_wi) c
     return albedo * (reflecance / pi);
 }
 
+double BsdfDiffuse::pdf(const Vec3& shading_wo, const Vec3& shading_wi) const {
+    // Uniform over the upper hemisphere, like HemisphericalSampler
+    return shading_wi.y() > 0.0 ? inv_2pi : 0.0;
+}
+
 std::optional<BsdfSample> BsdfPerfectMirror::sample(const Vec3& shading_wo) const {
     BsdfSample res{};
     Vec3 wo        = shading_wo.normalized();
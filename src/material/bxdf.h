@@ -30,6 +30,9 @@ class Bsdf {
 
     virtual RgbColor evaluate(const Vec3& shading_wo, const Vec3& shading_wi) const = 0;
 
+    /// Solid angle density of sample() returning 'shading_wi', zero for specular BSDFs
+    virtual double pdf(const Vec3& shading_wo, const Vec3& shading_wi) const = 0;
+
     virtual BsdfType type() const = 0;
 };
 
@@ -38,6 +41,8 @@ class BsdfPerfectMirror : public Bsdf {
 
     RgbColor evaluate(const Vec3& shading_wo, const Vec3& shading_wi) const override;
 
+    double pdf(const Vec3&, const Vec3&) const override { return 0.0; }
+
     BsdfType type() const override { return BsdfType::specular; }
 };
 
@@ -51,6 +56,8 @@ class BsdfPerfectSpecular : public Bsdf {
 
     RgbColor evaluate(const Vec3& shading_wo, const Vec3& shading_wi) const override;
 
+    double pdf(const Vec3&, const Vec3&) const override { return 0.0; }
+
     BsdfType type() const override { return BsdfType::specular; }
 
   private:
@@ -69,6 +76,8 @@ class BsdfDiffuse : public Bsdf {
 
     RgbColor evaluate(const Vec3& shading_wo, const Vec3& shading_wi) const override;
 
+    double pdf(const Vec3& shading_wo, const Vec3& shading_wi) const override;
+
     BsdfType type() const override { return BsdfType::diffuse; }
 
   private:
@@ -1,14 +1,27 @@
 #include "material.h"
 
+#include <utility>
+
 MaterialDiffuse::MaterialDiffuse(const RgbColor& albedo, double reflectance)
     : albedo{albedo},
       reflectance{reflectance} {}
 
-std::shared_ptr<Bsdf> MaterialDiffuse::compute_bsdf() const {
-    return std::make_shared<BsdfDiffuse>(albedo, reflectance);
+MaterialDiffuse::MaterialDiffuse(const RgbColor& albedo,
+                                 double reflectance,
+                                 std::shared_ptr<ImageTexture> texture)
+    : albedo{albedo},
+      reflectance{reflectance},
+      texture{std::move(texture)} {}
+
+std::shared_ptr<Bsdf> MaterialDiffuse::compute_bsdf(const Vec2& uv) const {
+    return std::make_shared<BsdfDiffuse>(get_albedo(uv), reflectance);
+}
+
+RgbColor MaterialDiffuse::get_albedo(const Vec2& uv) const {
+    return texture ? albedo * texture->lookup(uv) : albedo;
 }
 
-std::shared_ptr<Bsdf> Glass::compute_bsdf() const {
+std::shared_ptr<Bsdf> Glass::compute_bsdf(const Vec2&) const {
     auto fresnel{std::make_shared<FresnelDielectrics>()};
     return std::make_shared<BsdfPerfectSpecular>(fresnel, ior_out, ior_glass);
 }
@@ -3,14 +3,20 @@
 #include <memory>
 
 #include "bxdf.h"
+#include "image_texture.h"
+#include "vec.h"
 
 class Material {
   public:
     virtual ~Material() = default;
 
-    virtual std::shared_ptr<Bsdf> compute_bsdf() const = 0;
+    /// BSDF at the surface point with texture coordinates 'uv'
+    virtual std::shared_ptr<Bsdf> compute_bsdf(const Vec2& uv) const = 0;
 
     virtual std::string name() const = 0;
+
+    // Surface color used to guide denoising, white for specular materials
+    virtual RgbColor get_albedo(const Vec2& /*uv*/) const { return Color::white; }
 };
 
 class MaterialDiffuse : public Material {
@@ -18,23 +24,39 @@ class MaterialDiffuse : public Material {
     MaterialDiffuse() = default;
     MaterialDiffuse(const RgbColor& albedo, double reflectance);
 
-    std::shared_ptr<Bsdf> compute_bsdf() const override;
+    /// Albedo is 'albedo' times the texture color
+    MaterialDiffuse(const RgbColor& albedo, double reflectance, std::shared_ptr<ImageTexture> texture);
+
+    std::shared_ptr<Bsdf> compute_bsdf(const Vec2& uv) const override;
 
     std::string name() const override { return "diffuse"; }
 
+    RgbColor get_albedo(const Vec2& uv) const override;
+
+    /// Albedo without the texture
+    RgbColor get_base_albedo() const { return albedo; }
+
+    const std::shared_ptr<ImageTexture>& get_texture() const { return texture; }
+
+    double get_reflectance() const { return reflectance; }
+
   private:
     RgbColor albedo{Color::white};
     double reflectance{1.0};
+    std::shared_ptr<ImageTexture> texture;
 };
 
 class Glass : public Material {
   public:
     Glass() = default;
+    Glass(double ior) : ior_glass{ior} {}
 
-    std::shared_ptr<Bsdf> compute_bsdf() const override;
+    std::shared_ptr<Bsdf> compute_bsdf(const Vec2& uv) const override;
 
     std::string name() const override { return "glass"; }
 
+    double get_ior() const { return ior_glass; }
+
   private:
     double ior_glass{1.52};
     double ior_out{1.0};
@@ -42,7 +64,7 @@ class Glass : public Material {
 
 class PerfectMirror : public Material {
   public:
-    std::shared_ptr<Bsdf> compute_bsdf() const override {
+    std::shared_ptr<Bsdf> compute_bsdf(const Vec2&) const override {
         return std::make_shared<BsdfPerfectMirror>();
     }
 
@@ -3,7 +3,7 @@
 #include "utils.h"
 
 std::tuple<double, double> PixelSampler::sample() const {
-    return sampler->next_2d();
+    return Sampler{}.next_2d();
 }
 
 std::tuple<double, double, double> HemisphericalSampler::sample() const {
@@ -1,32 +1,28 @@
 #pragma once
 
-#include <chrono>
 #include <cstddef>
 #include <memory>
-#include <random>
+#include <tuple>
 #include <utility>
 
+#include "rng.h"
+
 /**
- * @brief Generating uniform real random variable in [0, 1]^inf space,
- *        that is, sequence (x0, x1, x2, x3, ...) where each x is in [0, 1].
+ * @brief Generating uniform real random variable in [0, 1)^inf space,
+ *        that is, sequence (x0, x1, x2, x3, ...) where each x is in [0, 1).
+ *        Values are the next dimensions of the current sample's RandomStream, so a sampler is
+ *        free to construct and renders are reproducible.
  */
 class Sampler {
   public:
-    Sampler()
-        : seed{std::chrono::high_resolution_clock::now().time_since_epoch().count()},
-          gen{static_cast<unsigned int>(seed)},
-          dist{0.0, 1.0} {}
-
-    double next_1d() { return dist(gen); }
+    double next_1d() { return RandomStream::next(); }
 
-    std::tuple<double, double> next_2d() { return {dist(gen), dist(gen)}; }
+    std::tuple<double, double> next_2d() {
+        double x = RandomStream::next();
+        return {x, RandomStream::next()};
+    }
 
-    void discard() { dist(gen); }
-
-  private:
-    long long seed;
-    std::mt19937 gen;
-    std::uniform_real_distribution<double> dist;  // FIXME: This is [0, 1)
+    void discard() { RandomStream::next(); }
 };
 
 class SquareSampler {
@@ -64,12 +60,9 @@ class HemisphericalSampler {
     std::shared_ptr<Sampler> sampler;
 };
 
+// Offsets inside a pixel, drawn from the calling thread's stream. Safe to share between render
+// threads.
 class PixelSampler {
   public:
-    PixelSampler() : sampler{std::make_shared<Sampler>()} {}
-
     std::tuple<double, double> sample() const;
-
-  private:
-    std::shared_ptr<Sampler> sampler{};
 };
\ No newline at end of file
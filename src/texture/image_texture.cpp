@@ -0,0 +1,340 @@
+#include "image_texture.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "profiler.h"
+#include "rng.h"
+#include "stb_image.h"
+
+namespace {
+
+constexpr char tiled_magic[8] = {'V', '3', 'T', 'I', 'L', 'E', 'D', '\0'};
+constexpr uint32_t tiled_version{1};
+constexpr uint32_t endian_tag{0x01020304};
+
+constexpr int tile_size{TextureTile::size};
+constexpr size_t tile_bytes{tile_size * tile_size * 3};
+
+struct TiledHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int32_t tile_size;
+    int32_t level_count;
+};
+
+struct TiledLevel {
+    int32_t width;
+    int32_t height;
+    int32_t tiles_x;
+    int32_t tiles_y;
+    uint64_t offset;
+};
+
+struct SourceStamp {
+    uint64_t size;
+    int64_t mtime;
+};
+
+std::optional<SourceStamp> source_stamp(const std::string& path) {
+    std::error_code ec;
+    auto size  = std::filesystem::file_size(path, ec);
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return SourceStamp{size, static_cast<int64_t>(mtime.time_since_epoch().count())};
+}
+
+// 8-bit sRGB to linear, textures are stored encoded to keep tiled files small
+const std::array<float, 256>& srgb_table() {
+    static const auto table = [] {
+        std::array<float, 256> res{};
+        for (size_t i{}; i < res.size(); ++i) {
+            res[i] = static_cast<float>(srgb_to_linear(i / 255.0));
+        }
+        return res;
+    }();
+    return table;
+}
+
+unsigned char encode_srgb(double linear) {
+    return static_cast<unsigned char>(std::lround(std::clamp(linear_to_srgb(linear), 0.0, 1.0) * 255.0));
+}
+
+struct LevelImage {
+    int width;
+    int height;
+    std::vector<unsigned char> rgb;
+
+    const unsigned char* at(int x, int y) const {
+        return rgb.data() + (static_cast<size_t>(y) * width + x) * 3;
+    }
+};
+
+// Box filter in linear space, odd sizes clamp at the edge
+LevelImage downsample(const LevelImage& src) {
+    const auto& to_linear = srgb_table();
+    LevelImage dst{std::max(1, src.width / 2), std::max(1, src.height / 2), {}};
+    dst.rgb.resize(static_cast<size_t>(dst.width) * dst.height * 3);
+    for (int y{}; y < dst.height; ++y) {
+        for (int x{}; x < dst.width; ++x) {
+            for (int c{}; c < 3; ++c) {
+                double sum{};
+                for (int dy{}; dy < 2; ++dy) {
+                    for (int dx{}; dx < 2; ++dx) {
+                        int sx = std::min(2 * x + dx, src.width - 1);
+                        int sy = std::min(2 * y + dy, src.height - 1);
+                        sum += to_linear[src.at(sx, sy)[c]];
+                    }
+                }
+                dst.rgb[(static_cast<size_t>(y) * dst.width + x) * 3 + c] = encode_srgb(sum / 4.0);
+            }
+        }
+    }
+    return dst;
+}
+
+// Decode the image once and write every level tile by tile. Partial tiles at the right and
+// bottom edges repeat the last texel.
+void convert_to_tiled(const std::string& image_path, const std::string& tiled_path) {
+    PROFILE_ZONE("texture_convert");
+    int w{};
+    int h{};
+    int channels{};
+    auto* pixels = stbi_load(image_path.c_str(), &w, &h, &channels, 3);
+    if (!pixels) {
+        throw std::runtime_error{"can't load texture: " + image_path};
+    }
+    LevelImage level{w, h, {pixels, pixels + static_cast<size_t>(w) * h * 3}};
+    stbi_image_free(pixels);
+
+    std::vector<LevelImage> images;
+    images.push_back(std::move(level));
+    while (images.back().width > 1 || images.back().height > 1) {
+        images.push_back(downsample(images.back()));
+    }
+
+    TiledHeader header{};
+    std::memcpy(header.magic, tiled_magic, sizeof(tiled_magic));
+    header.version     = tiled_version;
+    header.endian      = endian_tag;
+    header.tile_size   = tile_size;
+    header.level_count = static_cast<int32_t>(images.size());
+    if (auto stamp = source_stamp(image_path)) {
+        header.source_size  = stamp->size;
+        header.source_mtime = stamp->mtime;
+    }
+
+    std::vector<TiledLevel> table;
+    uint64_t offset = sizeof(TiledHeader) + images.size() * sizeof(TiledLevel);
+    for (const auto& image : images) {
+        TiledLevel l{image.width, image.height, (image.width + tile_size - 1) / tile_size,
+                     (image.height + tile_size - 1) / tile_size, offset};
+        offset += static_cast<uint64_t>(l.tiles_x) * l.tiles_y * tile_bytes;
+        table.push_back(l);
+    }
+
+    // Written aside and renamed into place like scene caches
+    auto temp_path = tiled_path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table.data()),
+                   static_cast<std::streamsize>(table.size() * sizeof(TiledLevel)));
+
+        std::vector<unsigned char> tile(tile_bytes);
+        for (size_t i{}; i < images.size(); ++i) {
+            const auto& image = images[i];
+            for (int ty{}; ty < table[i].tiles_y; ++ty) {
+                for (int tx{}; tx < table[i].tiles_x; ++tx) {
+                    for (int y{}; y < tile_size; ++y) {
+                        int sy = std::min(ty * tile_size + y, image.height - 1);
+                        for (int x{}; x < tile_size; ++x) {
+                            int sx = std::min(tx * tile_size + x, image.width - 1);
+                            std::memcpy(&tile[(static_cast<size_t>(y) * tile_size + x) * 3],
+                                        image.at(sx, sy), 3);
+                        }
+                    }
+                    file.write(reinterpret_cast<const char*>(tile.data()),
+                               static_cast<std::streamsize>(tile.size()));
+                }
+            }
+        }
+        if (file.fail()) {
+            std::filesystem::remove(temp_path);
+            throw std::runtime_error{"failed to write tiled texture: " + tiled_path};
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, tiled_path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        throw std::runtime_error{"failed to write tiled texture: " + tiled_path};
+    }
+}
+
+// Header of a tiled file that is complete and matches its source image, null otherwise
+const TiledHeader* valid_header(const MappedFile& file, const std::string& image_path) {
+    if (!file.is_open() || file.get_size() < sizeof(TiledHeader)) {
+        return nullptr;
+    }
+    const auto* header = reinterpret_cast<const TiledHeader*>(file.get_data());
+    auto stamp         = source_stamp(image_path);
+    if (std::memcmp(header->magic, tiled_magic, sizeof(tiled_magic)) != 0 ||
+        header->version != tiled_version || header->endian != endian_tag ||
+        header->tile_size != tile_size || header->level_count <= 0 || header->level_count > 32 ||
+        (stamp && (header->source_size != stamp->size || header->source_mtime != stamp->mtime))) {
+        return nullptr;
+    }
+
+    auto table_end = sizeof(TiledHeader) + header->level_count * sizeof(TiledLevel);
+    if (file.get_size() < table_end) {
+        return nullptr;
+    }
+    const auto* table = reinterpret_cast<const TiledLevel*>(file.get_data() + sizeof(TiledHeader));
+    for (int i{}; i < header->level_count; ++i) {
+        const auto& l = table[i];
+        auto end      = l.offset + static_cast<uint64_t>(l.tiles_x) * l.tiles_y * tile_bytes;
+        if (l.width <= 0 || l.height <= 0 || l.tiles_x != (l.width + tile_size - 1) / tile_size ||
+            l.tiles_y != (l.height + tile_size - 1) / tile_size || end > file.get_size()) {
+            return nullptr;
+        }
+    }
+    return header;
+}
+
+int wrap(int i, int n) {
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+}  // namespace
+
+std::string tiled_texture_path(const std::string& image_path) {
+    return image_path + ".tiled";
+}
+
+ImageTexture::ImageTexture(const std::string& path, TextureCache& cache)
+    : path{path}, cache{cache}, id{TextureCache::new_texture_id()} {
+    auto tiled_path = tiled_texture_path(path);
+    file            = std::make_unique<MappedFile>(tiled_path);
+    if (!valid_header(*file, path)) {
+        convert_to_tiled(path, tiled_path);
+        file = std::make_unique<MappedFile>(tiled_path);
+    }
+
+    const auto* header = valid_header(*file, path);
+    if (!header) {
+        throw std::runtime_error{"corrupt tiled texture: " + tiled_path};
+    }
+    const auto* table = reinterpret_cast<const TiledLevel*>(file->get_data() + sizeof(TiledHeader));
+    for (int i{}; i < header->level_count; ++i) {
+        levels.push_back({table[i].width, table[i].height, table[i].tiles_x, table[i].tiles_y,
+                          table[i].offset});
+    }
+}
+
+TextureTile ImageTexture::load_tile(int level, int tile_x, int tile_y) const {
+    const auto& l     = levels[level];
+    const auto& table = srgb_table();
+    const auto* src   = file->get_data() + l.offset +
+                      (static_cast<uint64_t>(tile_y) * l.tiles_x + tile_x) * tile_bytes;
+
+    TextureTile tile;
+    tile.texels.resize(tile_bytes);
+    for (size_t i{}; i < tile_bytes; ++i) {
+        tile.texels[i] = table[static_cast<unsigned char>(src[i])];
+    }
+    return tile;
+}
+
+const TextureTile& ImageTexture::get_tile(int level, int tile_x, int tile_y) const {
+    // Small per-thread cache in front of the shared one: neighboring lookups mostly hit the same
+    // few tiles, and this keeps them off the shard locks
+    struct Slot {
+        uint64_t key{~uint64_t{0}};
+        TextureCache::TilePtr tile;
+    };
+    thread_local std::array<Slot, 16> slots;
+
+    auto key   = TextureCache::tile_key(id, level, tile_x, tile_y);
+    auto& slot = slots[mix_bits(key) % slots.size()];
+    if (slot.key != key) {
+        slot.tile = cache.get(key, [&] { return load_tile(level, tile_x, tile_y); });
+        slot.key  = key;
+    }
+    return *slot.tile;
+}
+
+RgbColor ImageTexture::texel(int level, int x, int y) const {
+    const auto& l = levels[level];
+    x             = wrap(x, l.width);
+    y             = wrap(y, l.height);
+
+    const auto& tile = get_tile(level, x / tile_size, y / tile_size);
+    const float* rgb = &tile.texels[((y % tile_size) * tile_size + x % tile_size) * 3];
+    return {rgb[0], rgb[1], rgb[2]};
+}
+
+RgbColor ImageTexture::bilinear(int level, double u, double v) const {
+    const auto& l = levels[level];
+    double x      = u * l.width - 0.5;
+    double y      = (1.0 - v) * l.height - 0.5;
+    double x0     = std::floor(x);
+    double y0     = std::floor(y);
+    double fx     = x - x0;
+    double fy     = y - y0;
+    int ix        = static_cast<int>(x0);
+    int iy        = static_cast<int>(y0);
+
+    return (1 - fy) * ((1 - fx) * texel(level, ix, iy) + fx * texel(level, ix + 1, iy)) +
+           fy * ((1 - fx) * texel(level, ix, iy + 1) + fx * texel(level, ix + 1, iy + 1));
+}
+
+RgbColor ImageTexture::lookup(const Vec2& uv, double lod) const {
+    // Keep coordinates small so the float to int conversion can't overflow
+    double u = uv.x() - std::floor(uv.x());
+    double v = uv.y() - std::floor(uv.y());
+
+    lod       = std::clamp(lod, 0.0, static_cast<double>(level_count() - 1));
+    int level = static_cast<int>(lod);
+    double t  = lod - level;
+    auto res  = bilinear(level, u, v);
+    if (t > 0.0) {
+        res = (1 - t) * res + t * bilinear(level + 1, u, v);
+    }
+    return res;
+}
+
+std::shared_ptr<ImageTexture> load_image_texture(const std::string& path) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<ImageTexture>> textures;
+
+    std::error_code ec;
+    auto key = std::filesystem::weakly_canonical(path, ec).string();
+    if (ec) {
+        key = path;
+    }
+
+    std::lock_guard lock{mutex};
+    if (auto texture = textures[key].lock()) {
+        return texture;
+    }
+    auto texture  = std::make_shared<ImageTexture>(path);
+    textures[key] = texture;
+    return texture;
+}
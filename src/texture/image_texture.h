@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "color.h"
+#include "mapped_file.h"
+#include "texture_cache.h"
+#include "vec.h"
+
+// Image texture read through the TextureCache. On first use the image is converted to a tiled,
+// MIP-mapped file next to it ("<image>.tiled"), and later loads only map that file, so textures
+// never need to be resident as a whole. Lookups wrap around in u and v, v = 0 is the bottom row.
+class ImageTexture {
+  public:
+    /// @brief Open 'path', converting it first if its tiled file is missing or stale. Throws
+    /// std::runtime_error if the image can't be read.
+    explicit ImageTexture(const std::string& path, TextureCache& cache = TextureCache::global());
+
+    const std::string& get_path() const { return path; }
+
+    int get_width() const { return levels.front().width; }
+
+    int get_height() const { return levels.front().height; }
+
+    int level_count() const { return static_cast<int>(levels.size()); }
+
+    /// @brief Trilinear lookup, 'lod' 0 is the full resolution and each step halves it
+    RgbColor lookup(const Vec2& uv, double lod = 0.0) const;
+
+    /// Linear color of one texel of 'level', coordinates wrap around
+    RgbColor texel(int level, int x, int y) const;
+
+  private:
+    struct Level {
+        int width;
+        int height;
+        int tiles_x;
+        int tiles_y;
+        uint64_t offset;  // of the first tile in the file
+    };
+
+    RgbColor bilinear(int level, double u, double v) const;
+
+    /// Valid until the calling thread's next get_tile()
+    const TextureTile& get_tile(int level, int tile_x, int tile_y) const;
+
+    TextureTile load_tile(int level, int tile_x, int tile_y) const;
+
+    std::string path;
+    TextureCache& cache;
+    uint32_t id;
+    std::unique_ptr<MappedFile> file;
+    std::vector<Level> levels;
+};
+
+/// @brief Texture for 'path', shared with every other user of the same file while any of them
+/// holds it
+std::shared_ptr<ImageTexture> load_image_texture(const std::string& path);
+
+/// Path of the tiled file of an image
+std::string tiled_texture_path(const std::string& image_path);
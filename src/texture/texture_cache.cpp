@@ -0,0 +1,86 @@
+#include "texture_cache.h"
+
+#include "rng.h"
+
+TextureCache::TextureCache(size_t budget_bytes) : budget{budget_bytes} {}
+
+TextureCache& TextureCache::global() {
+    static TextureCache cache{size_t{256} << 20};
+    return cache;
+}
+
+uint32_t TextureCache::new_texture_id() {
+    static std::atomic<uint32_t> next{0};
+    return next++;
+}
+
+void TextureCache::set_budget(size_t budget_bytes) {
+    budget = budget_bytes;
+    for (auto& shard : shards) {
+        std::lock_guard lock{shard.mutex};
+        evict(shard);
+    }
+}
+
+TextureCache::Shard& TextureCache::shard_of(uint64_t key) {
+    return shards[mix_bits(key) % shard_count];
+}
+
+TextureCache::TilePtr TextureCache::get(uint64_t key, const std::function<TextureTile()>& load) {
+    auto& shard = shard_of(key);
+    {
+        std::lock_guard lock{shard.mutex};
+        if (auto it = shard.index.find(key); it != shard.index.end()) {
+            ++shard.hits;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->second;
+        }
+        ++shard.misses;
+    }
+
+    auto tile = std::make_shared<const TextureTile>(load());
+
+    std::lock_guard lock{shard.mutex};
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        // Another thread loaded it meanwhile
+        return it->second->second;
+    }
+    shard.lru.emplace_front(key, tile);
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += tile->bytes();
+    evict(shard);
+    return tile;
+}
+
+void TextureCache::evict(Shard& shard) {
+    auto limit = get_budget() / shard_count;
+    // Keep the tile just added even if it alone is over the limit
+    while (shard.bytes > limit && shard.lru.size() > 1) {
+        auto& [key, tile] = shard.lru.back();
+        shard.bytes -= tile->bytes();
+        shard.index.erase(key);
+        shard.lru.pop_back();
+        ++shard.evictions;
+    }
+}
+
+void TextureCache::clear() {
+    for (auto& shard : shards) {
+        std::lock_guard lock{shard.mutex};
+        shard.lru.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+TextureCache::Stats TextureCache::get_stats() const {
+    Stats stats{};
+    for (const auto& shard : shards) {
+        std::lock_guard lock{shard.mutex};
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.resident_bytes += shard.bytes;
+    }
+    return stats;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Square block of linear RGB texels of one MIP level, row-major
+struct TextureTile {
+    static constexpr int size{64};
+
+    std::vector<float> texels;  // size * size * 3
+
+    size_t bytes() const { return texels.size() * sizeof(float); }
+};
+
+// Decoded texture tiles of every texture, bounded by a global memory budget. Tiles are kept in
+// independently locked shards, each evicting its least recently used tiles, so render threads
+// looking up different tiles rarely wait on each other. Evicted tiles stay valid for readers that
+// still hold them.
+class TextureCache {
+  public:
+    using TilePtr = std::shared_ptr<const TextureTile>;
+
+    static constexpr size_t shard_count{16};
+
+    explicit TextureCache(size_t budget_bytes);
+
+    /// Cache shared by every texture, 256 MB unless changed
+    static TextureCache& global();
+
+    /// @brief Change the budget, evicting tiles right away if it shrinks
+    void set_budget(size_t budget_bytes);
+
+    size_t get_budget() const { return budget.load(std::memory_order_relaxed); }
+
+    /// @brief Unique key of a tile. Texture ids come from new_texture_id().
+    static uint64_t tile_key(uint32_t texture, int level, int tile_x, int tile_y) {
+        return (uint64_t{texture} << 40) | (uint64_t(level & 0xff) << 32) |
+               (uint64_t(tile_x & 0xffff) << 16) | uint64_t(tile_y & 0xffff);
+    }
+
+    static uint32_t new_texture_id();
+
+    /// @brief Tile with 'key', calling 'load' on a miss. Loads run outside the shard lock, so
+    /// two threads missing the same tile at once may both load it.
+    TilePtr get(uint64_t key, const std::function<TextureTile()>& load);
+
+    /// Drop every tile
+    void clear();
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t resident_bytes;
+    };
+
+    Stats get_stats() const;
+
+  private:
+    struct Shard {
+        using Entry = std::pair<uint64_t, TilePtr>;
+
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // most recently used first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes{};
+        uint64_t hits{};
+        uint64_t misses{};
+        uint64_t evictions{};
+    };
+
+    Shard& shard_of(uint64_t key);
+
+    /// Evict from the back until the shard fits its share of the budget. Needs the shard lock.
+    void evict(Shard& shard);
+
+    std::atomic<size_t> budget;
+    std::array<Shard, shard_count> shards;
+};
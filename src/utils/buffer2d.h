@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+// Row-major 2D array of per-pixel values, with the same orientation as Image
+// Origin: top-left
+// x-axis: right
+// y-axis: down
+template <typename T>
+class Buffer2D {
+  public:
+    Buffer2D() = default;
+
+    Buffer2D(int w, int h, const T& value = T{}) : width{w}, height{h}, buf(w * h, value) {}
+
+    int get_width() const { return width; }
+
+    int get_height() const { return height; }
+
+    bool empty() const { return buf.empty(); }
+
+    T& at(int x, int y) { return buf[y * width + x]; }
+
+    const T& at(int x, int y) const { return buf[y * width + x]; }
+
+    void fill(const T& value) { std::fill(buf.begin(), buf.end(), value); }
+
+    T* data() { return buf.data(); }
+
+    const T* data() const { return buf.data(); }
+
+    size_t size() const { return buf.size(); }
+
+  private:
+    int width{};
+    int height{};
+    std::vector<T> buf{};
+};
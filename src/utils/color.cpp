@@ -27,6 +27,14 @@ RgbColor to_rgb(const RgbColorU8& color) {
     return {r, g, b};
 }
 
+double srgb_to_linear(double encoded) {
+    return encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+}
+
+double linear_to_srgb(double linear) {
+    return linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
 RgbColor& RgbColor::operator+=(const RgbColor& rhs) {
     red += rhs.r();
     green += rhs.g();
@@ -76,6 +84,10 @@ RgbColor operator/(const RgbColor& color, double x) {
     return res;
 }
 
+double luminance(const RgbColor& color) {
+    return 0.2126 * color.r() + 0.7152 * color.g() + 0.0722 * color.b();
+}
+
 bool is_nearly_black(const RgbColor& color, double tolerance) {
     return color.r() < tolerance && color.g() < tolerance && color.b() < tolerance;
 }
@@ -76,12 +76,18 @@ const RgbColor skyblue{0.5, 0.7, 1.0};
 RgbColor to_rgb(const RgbColorU8& color);
 RgbColorU8 to_rgb_u8(const RgbColor& color);
 
+/// sRGB transfer function, for 8-bit images like textures that store encoded values
+double srgb_to_linear(double encoded);
+double linear_to_srgb(double linear);
+
 RgbColor operator+(const RgbColor& color1, const RgbColor& color2);
 RgbColor operator*(const RgbColor& color1, const RgbColor& color2);
 RgbColor operator*(double x, const RgbColor& color);
 RgbColor operator*(const RgbColor& color, double x);
 RgbColor operator/(const RgbColor& color, double x);
 
+double luminance(const RgbColor& color);
+
 bool is_nearly_black(const RgbColor& color, double tolerance = 1e-6);
 
 std::ostream& operator<<(std::ostream& os, const RgbColor& color);
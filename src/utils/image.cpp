@@ -1,7 +1,10 @@
 #include "image.h"
 
+#include <fstream>
 #include <iostream>
 
+#include "profiler.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -11,6 +14,7 @@ void Image::load(const std::string& path) {
     auto* img = stbi_load(path.c_str(), &width, &height, &channelCount, channelCount);
     if (!img) {
         std::cerr << "failed to load image file: " << path << "\n";
+        return;
     }
     auto sz = width * height * channelCount;
     buf.resize(sz);
@@ -19,6 +23,7 @@ void Image::load(const std::string& path) {
 }
 
 void Image::save(const std::string& path) const {
+    PROFILE_ZONE("image_save");
     if (!stbi_write_png(path.c_str(), width, height, 3, buf.data(), width * 3)) {
         std::cerr << "failed to write to png\n";
     }
@@ -37,9 +42,9 @@ void Image::set_pixel_value(int x, int y, const RgbColor& color) {
 }
 
 void Image::fill_u(const RgbColorU8& color) {
-    for (int i{}; i < width; ++i) {
-        for (int j{}; j < height; ++j) {
-            set_pixel_value_u(i, j, color);
+    for (int y{}; y < height; ++y) {
+        for (int x{}; x < width; ++x) {
+            set_pixel_value_u(x, y, color);
         }
     }
 }
@@ -55,3 +60,40 @@ void Image::set_pixel_value_u(int x, int y, const RgbColorU8& color) {
     buf[start + 1] = color.g();
     buf[start + 2] = color.b();
 }
+
+namespace {
+
+// PFM stores rows bottom to top, a negative scale marks little endian data
+void write_pfm(const std::string& path, int w, int h, int channels, const std::vector<float>& data) {
+    std::ofstream file{path, std::ios::binary};
+    file << (channels == 3 ? "PF" : "Pf") << "\n" << w << " " << h << "\n-1.0\n";
+    for (int y{h - 1}; y >= 0; --y) {
+        const auto* row = data.data() + static_cast<size_t>(y) * w * channels;
+        file.write(reinterpret_cast<const char*>(row),
+                   static_cast<std::streamsize>(sizeof(float) * w * channels));
+    }
+    if (file.fail()) {
+        std::cerr << "failed to write to pfm: " << path << "\n";
+    }
+}
+
+}  // namespace
+
+void save_pfm(const std::string& path, const Buffer2D<RgbColor>& img) {
+    PROFILE_ZONE("image_save");
+    std::vector<float> data;
+    data.reserve(img.size() * 3);
+    for (size_t i{}; i < img.size(); ++i) {
+        const auto& c = img.data()[i];
+        data.push_back(static_cast<float>(c.r()));
+        data.push_back(static_cast<float>(c.g()));
+        data.push_back(static_cast<float>(c.b()));
+    }
+    write_pfm(path, img.get_width(), img.get_height(), 3, data);
+}
+
+void save_pfm(const std::string& path, const Buffer2D<double>& img) {
+    PROFILE_ZONE("image_save");
+    std::vector<float> data(img.data(), img.data() + img.size());
+    write_pfm(path, img.get_width(), img.get_height(), 1, data);
+}
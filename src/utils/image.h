@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 
+#include "buffer2d.h"
 #include "color.h"
 
 // Origin: top-left
@@ -28,9 +29,16 @@ class Image {
     void set_pixel_value(int x, int y, const RgbColor& color);
     void set_pixel_value_u(int x, int y, const RgbColorU8& color);
 
+    /// Interleaved RGB bytes of row 'y', for writers that fill whole rows
+    unsigned char* row(int y) { return buf.data() + static_cast<size_t>(y) * width * channelCount; }
+
   private:
     int width{};
     int height{};
     int channelCount{3};
     std::vector<unsigned char> buf{};
 };
+
+// Write linear values as 32-bit float Portable Float Map, color ("PF") or grayscale ("Pf")
+void save_pfm(const std::string& path, const Buffer2D<RgbColor>& img);
+void save_pfm(const std::string& path, const Buffer2D<double>& img);
@@ -0,0 +1,206 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Single producer, single consumer ring of lines. The owning thread pushes, the writer thread
+// pops, and the ring outlives its thread until the writer has drained it.
+class LogRing {
+  public:
+    static constexpr size_t capacity{256};  // power of two
+
+    bool push(const LogLine& line) {
+        auto tail = write_index.load(std::memory_order_relaxed);
+        if (tail - read_index.load(std::memory_order_acquire) == capacity) {
+            return false;
+        }
+        slots[tail & (capacity - 1)] = line;
+        write_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename F>
+    size_t drain(F&& consume) {
+        auto head = read_index.load(std::memory_order_relaxed);
+        auto tail = write_index.load(std::memory_order_acquire);
+        for (auto i = head; i != tail; ++i) {
+            consume(slots[i & (capacity - 1)]);
+        }
+        read_index.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    bool empty() const {
+        return read_index.load(std::memory_order_acquire) ==
+               write_index.load(std::memory_order_acquire);
+    }
+
+    std::atomic<bool> retired{false};
+
+  private:
+    LogLine slots[capacity];
+    alignas(64) std::atomic<size_t> write_index{0};
+    alignas(64) std::atomic<size_t> read_index{0};
+};
+
+class LogBackend {
+  public:
+    LogBackend() : writer{[this] { writer_main(); }} {}
+
+    ~LogBackend() {
+        {
+            std::lock_guard lock{mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+        close_file();
+    }
+
+    std::shared_ptr<LogRing> create_ring() {
+        auto ring = std::make_shared<LogRing>();
+        std::lock_guard lock{mutex};
+        rings.push_back(ring);
+        return ring;
+    }
+
+    void notify() { wake.notify_one(); }
+
+    void set_file(const std::string& path) {
+        flush();
+        std::lock_guard lock{file_mutex};
+        close_file();
+        filename    = path;
+        open_failed = false;
+    }
+
+    void flush() {
+        std::unique_lock lock{mutex};
+        auto target = ++flush_requests;
+        wake.notify_all();
+        flushed.wait(lock, [&] { return flush_done >= target || stopping; });
+    }
+
+    std::atomic<size_t> dropped{0};
+
+  private:
+    void writer_main() {
+        std::unique_lock lock{mutex};
+        while (true) {
+            wake.wait_for(lock, std::chrono::milliseconds{5});
+
+            // Snapshot the requests first, so everything logged before flush() is written
+            auto requested = flush_requests;
+            bool stop      = stopping;
+            auto snapshot  = rings;
+            lock.unlock();
+
+            write_all(snapshot);
+
+            lock.lock();
+            // Drop rings of exited threads once they are empty
+            rings.erase(std::remove_if(rings.begin(), rings.end(),
+                                       [](const auto& r) { return r->retired && r->empty(); }),
+                        rings.end());
+            flush_done = requested;
+            flushed.notify_all();
+            if (stop) {
+                break;
+            }
+        }
+    }
+
+    void write_all(const std::vector<std::shared_ptr<LogRing>>& snapshot) {
+        std::lock_guard lock{file_mutex};
+        for (const auto& ring : snapshot) {
+            ring->drain([this](const LogLine& line) {
+                if (auto* f = get_file()) {
+                    auto text = line.view();
+                    std::fwrite(text.data(), 1, text.size(), f);
+                    std::fputc('\n', f);
+                }
+            });
+        }
+        if (file) {
+            std::fflush(file);
+        }
+    }
+
+    std::FILE* get_file() {
+        if (!file && !open_failed) {
+            file = std::fopen(filename.c_str(), "a");
+            if (!file) {
+                open_failed = true;
+                std::cerr << "Can't open log file\n";
+            }
+        }
+        return file;
+    }
+
+    void close_file() {
+        if (file) {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    size_t flush_requests{};
+    size_t flush_done{};
+    bool stopping{false};
+
+    std::mutex file_mutex;
+    std::string filename{"../../log/debug_log.txt"};
+    std::FILE* file{};
+    bool open_failed{false};
+
+    std::thread writer;
+};
+
+LogBackend& backend() {
+    static LogBackend instance;
+    return instance;
+}
+
+// Ring of the calling thread, handed over to the writer when the thread exits
+struct ThreadRing {
+    ThreadRing() : ring{backend().create_ring()} {}
+
+    ~ThreadRing() { ring->retired = true; }
+
+    std::shared_ptr<LogRing> ring;
+};
+
+}  // namespace
+
+void Logger::push(const LogLine& line) {
+    thread_local ThreadRing local;
+    if (!local.ring->push(line)) {
+        ++backend().dropped;
+        backend().notify();
+    }
+}
+
+void Logger::set_file(const std::string& path) {
+    backend().set_file(path);
+}
+
+void Logger::flush() {
+    backend().flush();
+}
+
+size_t Logger::dropped_count() {
+    return backend().dropped.load();
+}
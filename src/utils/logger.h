@@ -1,51 +1,118 @@
 #pragma once
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 #define STR(x) #x
 
+enum class LogLevel : uint8_t { debug, info, warning, error, off };
+
+// One formatted log line. Lines longer than the capacity are truncated.
+class LogLine {
+  public:
+    static constexpr size_t capacity{240};
+
+    void append(std::string_view s) {
+        auto n = std::min(s.size(), capacity - length);
+        s.copy(text + length, n);
+        length += n;
+    }
+
+    void append(const char* s) { append(std::string_view{s}); }
+
+    void append(const std::string& s) { append(std::string_view{s}); }
+
+    void append(char c) { append(std::string_view{&c, 1}); }
+
+    void append(bool b) { append(b ? "true" : "false"); }
+
+    template <typename T>
+    void append(const T& value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            auto [end, ec] = std::to_chars(text + length, text + capacity, value);
+            length         = ec == std::errc{} ? static_cast<size_t>(end - text) : capacity;
+        } else {
+            // Vectors, colors and other types with operator<<
+            std::ostringstream os;
+            os << value;
+            append(os.str());
+        }
+    }
+
+    std::string_view view() const { return {text, length}; }
+
+  private:
+    char text[capacity];
+    size_t length{};
+};
+
+// Asynchronous logger. Each thread formats lines into its own lock-free ring buffer and a
+// background thread writes them to the log file, so logging never blocks on IO and lines of
+// different threads never interleave. If a ring is full the line is dropped and counted.
 class Logger {
   public:
-    static void set_logging(bool is_enabled) { enabled = is_enabled; }
+    static void set_logging(bool is_enabled) {
+        set_level(is_enabled ? LogLevel::debug : LogLevel::off);
+    }
+
+    static bool is_enabled() { return should_log(LogLevel::debug); }
+
+    static void set_level(LogLevel level) { min_level.store(level, std::memory_order_relaxed); }
+
+    static LogLevel get_level() { return min_level.load(std::memory_order_relaxed); }
+
+    /// Checked before any formatting happens
+    static bool should_log(LogLevel level) {
+        return level != LogLevel::off && level >= get_level();
+    }
+
+    /// @brief Redirect the output. Lines already queued are written to the previous file first.
+    static void set_file(const std::string& path);
+
+    /// Wait until every line logged so far has been written
+    static void flush();
 
-    static bool is_enabled() { return enabled; }
+    /// Number of lines dropped because a ring buffer was full
+    static size_t dropped_count();
 
     template <typename... Ts>
     static void log(const Ts&... args) {
-        if (!enabled) {
-            return;
-        }
+        log_at(LogLevel::debug, args...);
+    }
 
-        std::ofstream logfile{filename, std::ios_base::app};
-        if (logfile.fail()) {
-            std::cerr << "Can't open log file\n";
+    template <typename... Ts>
+    static void log_at(LogLevel level, const Ts&... args) {
+        if (!should_log(level)) {
             return;
         }
 
-        ((logfile << args), ...);
-        logfile << "\n";
+        LogLine line;
+        (line.append(args), ...);
+        push(line);
     }
 
     template <typename... Ts>
     static void log_with_name(const Ts&... args) {
-        if (!enabled) {
+        if (!should_log(LogLevel::debug)) {
             return;
         }
 
-        std::ofstream logfile{filename, std::ios_base::app};
-        if (logfile.fail()) {
-            std::cerr << "Can't open log file\n";
-            return;
-        }
-
-        ((logfile << STR(args) << ":" << args << "\t"), ...);
-        logfile << "\n";
+        LogLine line;
+        ((line.append(STR(args)), line.append(':'), line.append(args), line.append('\t')), ...);
+        push(line);
     }
 
   private:
-    static inline const std::string filename{"../../log/debug_log.txt"};
-    static inline bool enabled{true};
+    static void push(const LogLine& line);
+
+    static inline std::atomic<LogLevel> min_level{LogLevel::debug};
 };
 
 #ifdef NDEBUG
@@ -54,4 +121,4 @@ class Logger {
 #define LOG(...) Logger::log("[", __func__, "] ", __VA_ARGS__)
 #endif
 
-#define FORCE_LOG(...) Logger::log("[", __func__, "]  ", __VA_ARGS__)
\ No newline at end of file
+#define FORCE_LOG(...) Logger::log("[", __func__, "]  ", __VA_ARGS__)
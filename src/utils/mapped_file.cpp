@@ -0,0 +1,53 @@
+#include "mapped_file.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define V3_HAS_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef V3_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data   = static_cast<const std::byte*>(p);
+            size   = static_cast<size_t>(st.st_size);
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (file.fail()) {
+        return;
+    }
+    auto sz = static_cast<size_t>(file.tellg());
+    if (sz == 0) {
+        return;
+    }
+    fallback.resize(sz);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(fallback.data()), static_cast<std::streamsize>(sz));
+    data = fallback.data();
+    size = sz;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef V3_HAS_MMAP
+    if (mapped) {
+        ::munmap(const_cast<std::byte*>(data), size);
+    }
+#endif
+}
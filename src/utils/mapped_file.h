@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. Memory mapped where the platform supports it, otherwise the
+// file is read into an owned buffer.
+class MappedFile {
+  public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const { return data != nullptr; }
+
+    const std::byte* get_data() const { return data; }
+
+    size_t get_size() const { return size; }
+
+  private:
+    const std::byte* data{};
+    size_t size{};
+    bool mapped{false};
+    std::vector<std::byte> fallback;
+};
@@ -0,0 +1,154 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct ZoneEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct EventBuffer {
+    size_t thread_index{};
+    std::vector<ZoneEvent> events;
+};
+
+// Buffers of live threads, and the events left behind by threads that have exited
+struct ProfilerRegistry {
+    std::mutex mutex;
+    std::vector<EventBuffer*> live;
+    std::vector<EventBuffer> retired;
+    size_t next_thread_index{};
+};
+
+ProfilerRegistry& registry() {
+    static ProfilerRegistry instance;
+    return instance;
+}
+
+struct ThreadEvents {
+    ThreadEvents() {
+        auto& reg = registry();
+        std::lock_guard lock{reg.mutex};
+        buffer.thread_index = reg.next_thread_index++;
+        buffer.events.reserve(1024);
+        reg.live.push_back(&buffer);
+    }
+
+    ~ThreadEvents() {
+        auto& reg = registry();
+        std::lock_guard lock{reg.mutex};
+        reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), &buffer), reg.live.end());
+        if (!buffer.events.empty()) {
+            reg.retired.push_back(std::move(buffer));
+        }
+    }
+
+    EventBuffer buffer;
+};
+
+// Zone names are literals, but escape them anyway to always produce valid JSON
+void write_json_string(std::ostream& os, const char* s) {
+    os << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            os << '\\';
+        }
+        os << *s;
+    }
+    os << '"';
+}
+
+}  // namespace
+
+uint64_t Profiler::now() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+    thread_local ThreadEvents events;
+    events.buffer.events.push_back({name, start, end});
+}
+
+size_t Profiler::event_count() {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    size_t count{};
+    for (const auto* buffer : reg.live) {
+        count += buffer->events.size();
+    }
+    for (const auto& buffer : reg.retired) {
+        count += buffer.events.size();
+    }
+    return count;
+}
+
+void Profiler::clear() {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    for (auto* buffer : reg.live) {
+        buffer->events.clear();
+    }
+    reg.retired.clear();
+}
+
+bool Profiler::write_chrome_trace(const std::string& path) {
+    std::ofstream file{path};
+    if (file.fail()) {
+        std::cerr << "can't open trace file: " << path << "\n";
+        return false;
+    }
+
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+
+    std::vector<const EventBuffer*> buffers(reg.live.begin(), reg.live.end());
+    for (const auto& buffer : reg.retired) {
+        buffers.push_back(&buffer);
+    }
+
+    // Timestamps relative to the first zone keep the numbers short
+    uint64_t origin{UINT64_MAX};
+    for (const auto* buffer : buffers) {
+        for (const auto& e : buffer->events) {
+            origin = std::min(origin, e.start);
+        }
+    }
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first{true};
+    for (const auto* buffer : buffers) {
+        if (buffer->events.empty()) {
+            continue;
+        }
+
+        file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+             << "\"tid\": " << buffer->thread_index << ", \"args\": {\"name\": \"thread "
+             << buffer->thread_index << "\"}}";
+        first = false;
+
+        for (const auto& e : buffer->events) {
+            // Chrome trace times are in microseconds
+            file << ",\n{\"name\": ";
+            write_json_string(file, e.name);
+            file << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << buffer->thread_index
+                 << ", \"ts\": " << static_cast<double>(e.start - origin) / 1000.0
+                 << ", \"dur\": " << static_cast<double>(e.end - e.start) / 1000.0 << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    if (file.fail()) {
+        std::cerr << "failed to write trace file: " << path << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped profiling zones, written as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+// Every thread appends completed zones to its own buffer, so recording takes no locks. Zones
+// only record while the profiler is enabled, and PROFILE_ZONE compiles to nothing unless the
+// build defines V3_PROFILING (CMake option V3_ENABLE_PROFILING).
+class Profiler {
+  public:
+    static void set_enabled(bool is_enabled) { enabled.store(is_enabled, std::memory_order_relaxed); }
+
+    static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /// Monotonic timestamp in nanoseconds
+    static uint64_t now();
+
+    /// @brief Append a completed zone to the buffer of the calling thread. 'name' must outlive
+    /// the profiler, in practice it is a string literal.
+    static void record(const char* name, uint64_t start, uint64_t end);
+
+    /// Number of zones recorded by all threads. Only call while no zones are being recorded.
+    static size_t event_count();
+
+    /// Drop all recorded zones. Only call while no zones are being recorded.
+    static void clear();
+
+    /// @brief Write all recorded zones as Chrome trace JSON. Only call while no zones are being
+    /// recorded.
+    static bool write_chrome_trace(const std::string& path);
+
+  private:
+    static inline std::atomic<bool> enabled{false};
+};
+
+class ProfileZone {
+  public:
+    explicit ProfileZone(const char* name) : name{name} {
+        if (Profiler::is_enabled()) {
+            start = Profiler::now();
+        }
+    }
+
+    ~ProfileZone() {
+        if (start != 0) {
+            Profiler::record(name, start, Profiler::now());
+        }
+    }
+
+    ProfileZone(const ProfileZone&)            = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+  private:
+    const char* name;
+    uint64_t start{};
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef V3_PROFILING
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__){name}
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
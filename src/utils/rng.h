@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+/// SplitMix64 finalizer, a bijective mix of all 64 bits
+constexpr uint64_t mix_bits(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+}
+
+/// Uniform double in [0, 1) from the high 53 bits
+constexpr double bits_to_unit(uint64_t bits) {
+    return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+
+// Values of a stream kept in memory rather than hashed, so they can be edited and replayed. See
+// RandomStream::replay().
+class SampleSource {
+  public:
+    virtual ~SampleSource() = default;
+
+    /// Value in [0, 1) at 'dimension'
+    virtual double value(uint64_t dimension) = 0;
+};
+
+// Counter-based random numbers. Value number 'dimension' of sample 'sample' in pixel 'pixel' is a
+// hash of (seed, pixel, sample, dimension), so any sample can be recomputed on its own and a
+// render doesn't depend on the thread count or on which thread took which pixel.
+//
+// Each thread has a current stream, started by the renderer for every camera sample. Samplers,
+// random_double() and random_int() draw the next dimension of it. A thread can also replay a
+// SampleSource instead, which is how Metropolis sampling mutates the numbers a path consumes.
+class RandomStream {
+  public:
+    static constexpr uint64_t golden_gamma{0x9e3779b97f4a7c15};
+
+    /// Key of the stream of one sample
+    static constexpr uint64_t key(uint64_t seed, uint64_t pixel, uint64_t sample) {
+        return mix_bits(mix_bits(mix_bits(seed + golden_gamma) ^ pixel) ^ sample);
+    }
+
+    /// Value at 'dimension' of the stream with 'key'
+    static constexpr double value(uint64_t key, uint64_t dimension) {
+        return bits_to_unit(mix_bits(key + (dimension + 1) * golden_gamma));
+    }
+
+    /// @brief Make (seed, pixel, sample) the stream of this thread, the next draw returns
+    /// 'dimension'
+    static void start(uint64_t seed, uint64_t pixel, uint64_t sample, uint64_t dimension = 0) {
+        auto& s     = current();
+        s.key       = key(seed, pixel, sample);
+        s.dimension = dimension;
+        s.source    = nullptr;
+    }
+
+    /// @brief Make 'source' the stream of this thread until end_replay() or the next start(),
+    /// the next draw returns its 'dimension'
+    static void replay(SampleSource& source, uint64_t dimension = 0) {
+        auto& s     = current();
+        s.dimension = dimension;
+        s.source    = &source;
+    }
+
+    /// Return to the hashed stream that was current before replay()
+    static void end_replay() { current().source = nullptr; }
+
+    /// Next value in [0, 1) of this thread's stream
+    static double next() {
+        auto& s = current();
+        if (s.source) {
+            return s.source->value(s.dimension++);
+        }
+        return value(s.key, s.dimension++);
+    }
+
+    /// Dimensions drawn from this thread's stream since it started
+    static uint64_t dimension() { return current().dimension; }
+
+  private:
+    struct State {
+        // Threads that never start a stream, like loaders and tests, draw from a fixed one
+        uint64_t key{RandomStream::key(0, ~uint64_t{0}, 0)};
+        uint64_t dimension{};
+        SampleSource* source{};
+    };
+
+    static State& current() {
+        thread_local State state;
+        return state;
+    }
+};
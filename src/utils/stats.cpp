@@ -0,0 +1,79 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Keeps track of the counters of all live threads and the sum of the exited ones
+struct StatsRegistry {
+    std::mutex mutex;
+    std::vector<StatCounters*> live;
+    StatCounters retired;
+};
+
+StatsRegistry& registry() {
+    static StatsRegistry instance;
+    return instance;
+}
+
+// Thread local counters that register themselves on first use
+struct ThreadStats {
+    ThreadStats() {
+        auto& reg = registry();
+        std::lock_guard lock{reg.mutex};
+        reg.live.push_back(&counters);
+    }
+
+    ~ThreadStats() {
+        auto& reg = registry();
+        std::lock_guard lock{reg.mutex};
+        reg.retired += counters;
+        reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), &counters), reg.live.end());
+    }
+
+    StatCounters counters;
+};
+
+}  // namespace
+
+StatCounters& StatCounters::operator+=(const StatCounters& other) {
+    camera_rays += other.camera_rays;
+    closest_hit_queries += other.closest_hit_queries;
+    shadow_queries += other.shadow_queries;
+    primitive_tests += other.primitive_tests;
+    bvh_node_visits += other.bvh_node_visits;
+    rr_terminations += other.rr_terminations;
+    for (size_t i{}; i < path_lengths.size(); ++i) {
+        path_lengths[i] += other.path_lengths[i];
+    }
+    for (const auto& [material, count] : other.bsdf_samples) {
+        bsdf_samples[material] += count;
+    }
+    return *this;
+}
+
+StatCounters& thread_stats() {
+    thread_local ThreadStats stats;
+    return stats.counters;
+}
+
+StatCounters collect_stats() {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    StatCounters total = reg.retired;
+    for (const auto* counters : reg.live) {
+        total += *counters;
+    }
+    return total;
+}
+
+void reset_stats() {
+    auto& reg = registry();
+    std::lock_guard lock{reg.mutex};
+    reg.retired = {};
+    for (auto* counters : reg.live) {
+        *counters = {};
+    }
+}
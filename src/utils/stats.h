@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// Render statistics. Every thread increments its own counters without synchronization, and
+// collect_stats() sums them up. Only collect or reset while no render is running.
+struct StatCounters {
+    static constexpr size_t max_path_length{16};
+
+    uint64_t camera_rays{};
+    uint64_t closest_hit_queries{};
+    uint64_t shadow_queries{};
+    uint64_t primitive_tests{};
+    uint64_t bvh_node_visits{};
+    uint64_t rr_terminations{};
+
+    /// Number of paths by surface vertex count. The last bucket also counts all longer paths.
+    std::array<uint64_t, max_path_length + 1> path_lengths{};
+
+    /// BSDF samples keyed by material
+    std::unordered_map<const void*, uint64_t> bsdf_samples;
+
+    void record_path_length(size_t length) {
+        ++path_lengths[length < max_path_length ? length : max_path_length];
+    }
+
+    StatCounters& operator+=(const StatCounters& other);
+};
+
+/// Counters of the calling thread
+StatCounters& thread_stats();
+
+/// Sum of the counters of all threads, including threads that have exited
+StatCounters collect_stats();
+
+void reset_stats();
@@ -0,0 +1,110 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t worker_count) {
+    workers.reserve(worker_count);
+    for (size_t i{}; i < worker_count; ++i) {
+        workers.emplace_back([this] { worker_main(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+    return pool;
+}
+
+void ThreadPool::parallel_for(size_t begin,
+                              size_t end,
+                              const std::function<void(size_t)>& fn,
+                              size_t grain) {
+    if (begin >= end) {
+        return;
+    }
+
+    std::lock_guard loop_lock{loop_mutex};
+
+    Loop loop;
+    loop.end   = end;
+    loop.grain = std::max<size_t>(grain, 1);
+    loop.fn    = &fn;
+    loop.next  = begin;
+
+    {
+        std::lock_guard lock{mutex};
+        current = &loop;
+        ++generation;
+    }
+    wake.notify_all();
+
+    run_chunks(loop);
+
+    // Wait until no worker is still inside this loop before it goes out of scope
+    {
+        std::unique_lock lock{mutex};
+        current = nullptr;
+        done.wait(lock, [&] { return loop.active == 0; });
+    }
+
+    if (loop.error) {
+        std::rethrow_exception(loop.error);
+    }
+}
+
+void ThreadPool::worker_main() {
+    size_t seen_generation{};
+    while (true) {
+        Loop* loop{};
+        {
+            std::unique_lock lock{mutex};
+            wake.wait(lock, [&] { return stopping || (current && generation != seen_generation); });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+            loop            = current;
+            ++loop->active;
+        }
+
+        run_chunks(*loop);
+
+        {
+            std::lock_guard lock{mutex};
+            --loop->active;
+        }
+        done.notify_all();
+    }
+}
+
+void ThreadPool::run_chunks(Loop& loop) {
+    while (true) {
+        size_t first = loop.next.fetch_add(loop.grain);
+        if (first >= loop.end) {
+            return;
+        }
+        size_t last = std::min(first + loop.grain, loop.end);
+        try {
+            for (size_t i{first}; i < last; ++i) {
+                (*loop.fn)(i);
+            }
+        } catch (...) {
+            std::lock_guard lock{loop.error_mutex};
+            if (!loop.error) {
+                loop.error = std::current_exception();
+            }
+            // Skip the remaining work
+            loop.next = loop.end;
+        }
+    }
+}
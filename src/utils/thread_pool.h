@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run parallel loops. The calling thread joins in, so a pool
+// of N workers runs loops on N + 1 threads.
+class ThreadPool {
+  public:
+    explicit ThreadPool(size_t worker_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Number of threads taking part in a loop, including the caller
+    size_t thread_count() const { return workers.size() + 1; }
+
+    /// @brief Call fn(i) for every i in [begin, end) and wait for all of them. Indices are handed
+    /// out in chunks of 'grain'. The first exception thrown by fn is rethrown here.
+    void parallel_for(size_t begin,
+                      size_t end,
+                      const std::function<void(size_t)>& fn,
+                      size_t grain = 1);
+
+    /// Pool shared by the renderer and post processing, sized to the hardware
+    static ThreadPool& global();
+
+  private:
+    struct Loop {
+        size_t end{};
+        size_t grain{1};
+        const std::function<void(size_t)>* fn{};
+        std::atomic<size_t> next{};
+        std::atomic<size_t> active{};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+    };
+
+    void worker_main();
+    void run_chunks(Loop& loop);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex loop_mutex;  // one loop at a time
+    Loop* current{};
+    size_t generation{};
+    bool stopping{false};
+};
@@ -23,9 +23,13 @@ class Timer {
         return duration.count();
     }
 
+    /// Elapsed time with sub-millisecond resolution
+    double seconds() const { return std::chrono::duration<double>(Clock::now() - start).count(); }
+
   private:
-    using Clock = std::chrono::system_clock;
-    std::chrono::time_point<std::chrono::system_clock> start;
+    // Monotonic, so wall clock adjustments can't produce negative durations
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start;
 };
 
 inline double to_seconds(size_t milliseconds) {
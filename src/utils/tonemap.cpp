@@ -0,0 +1,187 @@
+#include "tonemap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "profiler.h"
+#include "rng.h"
+#include "thread_pool.h"
+
+namespace {
+
+constexpr int srgb_table_size{4096};
+constexpr int noise_size{64};  // power of two
+
+// 255 * sRGB encoding of linear i / (size - 1). The curve is smooth enough that interpolating
+// between entries stays within 0.01 of the exact value. The last entry is repeated, so the
+// interpolation at 1 can read one past it. A polynomial would avoid the gather, but the few
+// square roots it needs cost more than the lookups.
+const std::array<float, srgb_table_size + 1>& srgb_encode_table() {
+    static const auto table = [] {
+        std::array<float, srgb_table_size + 1> res{};
+        for (int i{}; i < srgb_table_size; ++i) {
+            res[i] = static_cast<float>(255.0 * linear_to_srgb(i / (srgb_table_size - 1.0)));
+        }
+        res[srgb_table_size] = res[srgb_table_size - 1];
+        return res;
+    }();
+    return table;
+}
+
+// Tile of uniform noise in [-0.5, 0.5), repeated over the image
+const std::array<float, noise_size * noise_size>& dither_noise() {
+    static const auto noise = [] {
+        std::array<float, noise_size * noise_size> res{};
+        for (size_t i{}; i < res.size(); ++i) {
+            res[i] = static_cast<float>(bits_to_unit(mix_bits(i)) - 0.5);
+        }
+        return res;
+    }();
+    return noise;
+}
+
+float hable(float x) {
+    constexpr float a{0.15f};
+    constexpr float b{0.50f};
+    constexpr float c{0.10f};
+    constexpr float d{0.20f};
+    constexpr float e{0.02f};
+    constexpr float f{0.30f};
+    return (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f;
+}
+
+// Exposure, tone curve and clamp to [0, 1] in place. Kept free of branches, apart from the
+// curve chosen at compile time, so the loop vectorizes.
+template <Tonemapper T>
+void apply_curve(float* values, size_t count, float scale) {
+    const float inv_white = 1.0f / hable(11.2f);
+    for (size_t i{}; i < count; ++i) {
+        float x = values[i] * scale;
+        x       = x > 0.0f ? x : 0.0f;  // also maps NaN to black
+        if constexpr (T == Tonemapper::reinhard) {
+            x = x / (1.0f + x);
+        } else if constexpr (T == Tonemapper::aces) {
+            x = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+        } else if constexpr (T == Tonemapper::filmic) {
+            x = hable(2.0f * x) * inv_white;  // Hable's exposure bias of 2
+        }
+        values[i] = x < 1.0f ? x : 1.0f;
+    }
+}
+
+void apply_curve(Tonemapper tonemapper, float* values, size_t count, float scale) {
+    switch (tonemapper) {
+        case Tonemapper::clamp: apply_curve<Tonemapper::clamp>(values, count, scale); break;
+        case Tonemapper::reinhard: apply_curve<Tonemapper::reinhard>(values, count, scale); break;
+        case Tonemapper::aces: apply_curve<Tonemapper::aces>(values, count, scale); break;
+        case Tonemapper::filmic: apply_curve<Tonemapper::filmic>(values, count, scale); break;
+    }
+}
+
+// Values in [0, 1] to code values in [0, 255], still unrounded
+void encode(float* values, size_t count, bool srgb) {
+    if (!srgb) {
+        for (size_t i{}; i < count; ++i) {
+            values[i] *= 255.0f;
+        }
+        return;
+    }
+
+    const auto& table = srgb_encode_table();
+    for (size_t i{}; i < count; ++i) {
+        float f   = values[i] * (srgb_table_size - 1);
+        auto idx  = static_cast<int>(f);
+        float t   = f - static_cast<float>(idx);
+        values[i] = table[idx] + t * (table[idx + 1] - table[idx]);
+    }
+}
+
+// Round to the nearest code value, after adding 'noise' if not null
+void quantize(float* values, const float* noise, size_t count) {
+    for (size_t i{}; i < count; ++i) {
+        float v   = values[i] + 0.5f + (noise ? noise[i] : 0.0f);
+        v         = v > 0.0f ? v : 0.0f;
+        values[i] = v < 255.0f ? v : 255.0f;
+    }
+}
+
+}  // namespace
+
+Tonemapper parse_tonemapper(const std::string& name) {
+    if (name == "clamp") {
+        return Tonemapper::clamp;
+    } else if (name == "reinhard") {
+        return Tonemapper::reinhard;
+    } else if (name == "aces") {
+        return Tonemapper::aces;
+    } else if (name == "filmic") {
+        return Tonemapper::filmic;
+    }
+    throw std::runtime_error{"unknown tonemapper '" + name + "'"};
+}
+
+void write_display_image(const Buffer2D<RgbColor>& radiance,
+                         const DisplayOptions& options,
+                         Image& image,
+                         int x0,
+                         int y0,
+                         bool parallel) {
+    PROFILE_ZONE("display_encode");
+    int w       = radiance.get_width();
+    auto scale  = static_cast<float>(std::exp2(options.exposure));
+    auto srgb   = options.srgb;
+    auto dither = options.dither;
+    auto curve  = options.tonemapper;
+
+    auto encode_row = [&](size_t row) {
+        int y = static_cast<int>(row);
+        // Channel planes of one row, and the dither noise lined up with them
+        thread_local std::vector<float> planes;
+        thread_local std::vector<float> noise;
+        planes.resize(static_cast<size_t>(w) * 3);
+        float* r = planes.data();
+        float* g = r + w;
+        float* b = g + w;
+
+        const auto* src = &radiance.at(0, y);
+        for (int x{}; x < w; ++x) {
+            r[x] = static_cast<float>(src[x].r());
+            g[x] = static_cast<float>(src[x].g());
+            b[x] = static_cast<float>(src[x].b());
+        }
+
+        apply_curve(curve, planes.data(), planes.size(), scale);
+        encode(planes.data(), planes.size(), srgb);
+
+        if (dither) {
+            // Every channel reads its own row of the noise tile
+            const auto& tile = dither_noise();
+            noise.resize(planes.size());
+            for (int c{}; c < 3; ++c) {
+                const float* tile_row = &tile[((y0 + y + 21 * c) & (noise_size - 1)) * noise_size];
+                for (int x{}; x < w; ++x) {
+                    noise[c * w + x] = tile_row[(x0 + x) & (noise_size - 1)];
+                }
+            }
+        }
+        quantize(planes.data(), dither ? noise.data() : nullptr, planes.size());
+
+        auto* dst = image.row(y0 + y) + static_cast<size_t>(x0) * 3;
+        for (int x{}; x < w; ++x) {
+            dst[x * 3]     = static_cast<unsigned char>(r[x]);
+            dst[x * 3 + 1] = static_cast<unsigned char>(g[x]);
+            dst[x * 3 + 2] = static_cast<unsigned char>(b[x]);
+        }
+    };
+
+    if (parallel) {
+        ThreadPool::global().parallel_for(0, radiance.get_height(), encode_row, 4);
+    } else {
+        for (int y{}; y < radiance.get_height(); ++y) {
+            encode_row(y);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "buffer2d.h"
+#include "color.h"
+#include "image.h"
+
+enum class Tonemapper : uint8_t {
+    clamp,     // clip at 1
+    reinhard,  // x / (1 + x) per channel
+    aces,      // Narkowicz's fit of the ACES filmic curve
+    filmic,    // Hable's Uncharted 2 curve, white point 11.2
+};
+
+/// @brief "clamp", "reinhard", "aces" or "filmic". Throws std::runtime_error on other names.
+Tonemapper parse_tonemapper(const std::string& name);
+
+// How linear radiance becomes 8-bit display values
+struct DisplayOptions {
+    double exposure{0.0};  // in stops
+    Tonemapper tonemapper{Tonemapper::clamp};
+    bool srgb{true};     // sRGB transfer function, otherwise linear values are quantized
+    bool dither{false};  // break up banding in smooth gradients with +-0.5 LSB of noise
+};
+
+/// @brief Write 'radiance' into 'image' with its top-left pixel at (x0, y0). Rows are converted
+/// as float channel arrays the compiler can vectorize, with the sRGB curve read from a lookup
+/// table. They run in parallel on the global thread pool unless 'parallel' is false, as for
+/// background threads that must not wait for the pool.
+void write_display_image(const Buffer2D<RgbColor>& radiance,
+                         const DisplayOptions& options,
+                         Image& image,
+                         int x0        = 0,
+                         int y0        = 0,
+                         bool parallel = true);
@@ -10,12 +10,13 @@ class Transform {
     Transform() = default;
     Transform(const Vec3& t, const Vec3& r, const Vec3& s);
     Transform(const Mat4& mat);
+    Transform(const Mat4& mat, const Mat4& inv_mat) : mat{mat}, inv_mat{inv_mat} {}
 
     Transform operator*(const Transform& rhs) const;
 
     Mat4 get_mat() const { return mat; }
     Mat4 get_inv_mat() const { return inv_mat; }
-    Transform inverse() const { return {inv_mat}; }
+    Transform inverse() const { return {inv_mat, mat}; }
 
     [[nodiscard]] Vec3 on_point(const Vec3& p) const;
     [[nodiscard]] Vec3 on_vec(const Vec3& v) const;
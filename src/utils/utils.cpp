@@ -1,7 +1,8 @@
 #include "utils.h"
 
-#include <chrono>
-#include <random>
+#include <algorithm>
+
+#include "rng.h"
 
 bool is_nearly_zero(double x, double tolerance) {
     return std::abs(x) < tolerance;
@@ -136,17 +137,14 @@ RgbColor visualize_normal(const Vec3& normal) {
     return {n.x(), n.y(), n.z()};
 }
 
-const static auto g_Seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-static std::mt19937 g_Gen{static_cast<unsigned long>(g_Seed)};
-
+// Draw from the counter-based stream of the current sample, see rng.h
 double random_double(double a, double b) {
-    std::uniform_real_distribution<double> dist{a, b};
-    return dist(g_Gen);
+    return a + (b - a) * RandomStream::next();
 }
 
 int random_int(int a, int b) {
-    std::uniform_int_distribution<int> dist{a, b};
-    return dist(g_Gen);
+    auto range = static_cast<double>(b) - a + 1.0;
+    return std::min(b, a + static_cast<int>(RandomStream::next() * range));
 }
 
 Vec3 random_vec3(double a, double b) {
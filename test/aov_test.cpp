@@ -0,0 +1,54 @@
+#include "aov.h"
+
+#include <gtest/gtest.h>
+
+#include "pathtracer.h"
+#include "scene.h"
+#include "utils.h"
+
+TEST(Aov, ParseList) {
+    EXPECT_EQ(parse_aov_list("depth"), AovType::depth);
+    EXPECT_EQ(parse_aov_list("normal,albedo"), AovType::normal | AovType::albedo);
+    EXPECT_EQ(parse_aov_list("all"), AovType::all);
+    EXPECT_THROW(parse_aov_list("depth,colour"), std::runtime_error);
+}
+
+TEST(Aov, WrittenWithBeautyPass) {
+    int w{12};
+    int h{8};
+    size_t spp{4};
+
+    auto scene = std::make_shared<TestScene>();
+    scene->load_scene3();
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+    renderer.load_scene(scene);
+    renderer.set_aovs(AovType::all);
+    renderer.render(*camera);
+
+    const auto& aovs     = renderer.get_aovs();
+    const auto& radiance = renderer.get_radiance();
+    auto object_count    = static_cast<double>(scene->object_count() + scene->light_count());
+
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            auto sum = aovs.direct.at(x, y) + aovs.indirect.at(x, y);
+            EXPECT_NEAR(sum.r(), radiance.at(x, y).r(), 1e-9);
+            EXPECT_NEAR(sum.g(), radiance.at(x, y).g(), 1e-9);
+            EXPECT_NEAR(sum.b(), radiance.at(x, y).b(), 1e-9);
+
+            EXPECT_GE(aovs.object_id.at(x, y), -1.0);
+            EXPECT_LT(aovs.object_id.at(x, y), object_count);
+            EXPECT_GE(aovs.depth.at(x, y), 0.0);
+            EXPECT_EQ(aovs.sample_count.at(x, y), static_cast<double>(spp));
+        }
+    }
+
+    // The center of the image looks at the glass sphere
+    EXPECT_GT(aovs.depth.at(w / 2, h / 2), 0.0);
+    EXPECT_NEAR(aovs.normal.at(w / 2, h / 2).norm(), 1.0, 1e-6);
+}
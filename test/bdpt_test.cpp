@@ -0,0 +1,63 @@
+#include "bdpt.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "pathtracer.h"
+#include "render_test_helpers.h"
+#include "scene.h"
+
+TEST(Bdpt, MatchesPathTracer) {
+    constexpr int w{16};
+    constexpr int h{8};
+
+    PathTracer reference{w, h, std::make_shared<PixelSampler>(), 512};
+    auto expected = render_diffuse_quadrants(reference);
+
+    // The splatted light tracing strategies carry part of the image
+    BidirectionalPathTracer renderer{w, h, std::make_shared<PixelSampler>(), 128};
+    expect_quadrants_near(render_diffuse_quadrants(renderer), expected, 0.05);
+}
+
+TEST(Bdpt, ShortPathsOnlySeeDirectLight) {
+    BidirectionalPathTracer direct{16, 8, std::make_shared<PixelSampler>(), 64};
+    direct.set_max_depth(1);
+    BidirectionalPathTracer full{16, 8, std::make_shared<PixelSampler>(), 64};
+    auto direct_luminance = render_diffuse_quadrants(direct);
+    auto full_luminance   = render_diffuse_quadrants(full);
+    for (size_t i{}; i < 4; ++i) {
+        EXPECT_LT(direct_luminance[i], full_luminance[i]);
+    }
+}
+
+TEST(Bdpt, WeighsNextEventEstimationBySolidAngle) {
+    // A large light just above the floor, seen at a grazing angle. Sampling its solid angle
+    // only pays off if the MIS weights know that next event estimation did.
+    auto scene = std::make_shared<TestScene>();
+    scene->clear();
+    auto white = std::make_shared<MaterialDiffuse>(Color::white, 0.8);
+    scene->add(create_geometry(primitives.rect_xz, white, {0, 0, 0}, {0, 0, 0}, Vec3::all(8)));
+    scene->add(create_area_light({0, 0.5, 0}, {0, 0, 0}, Vec3::all(6), Color::white, 1.0));
+    scene->build_accelerator();
+
+    auto camera = create_camera({0, 0.25, 3.9}, {0, 0, -1});
+    camera->set_aspect_ratio(2.0);
+    camera->focus_on_point({0, 0.1, 0});
+
+    auto render = [&](LightSampling sampling, double& mean) {
+        scene->set_light_sampling(sampling);
+        BidirectionalPathTracer renderer{16, 8, std::make_shared<PixelSampler>(), 64};
+        renderer.set_max_depth(1);
+        renderer.load_scene(scene);
+        renderer.render(*camera);
+        mean = mean_luminance(renderer.get_radiance());
+        return renderer.get_stats().mean_variance;
+    };
+    double area_mean{};
+    double solid_angle_mean{};
+    double area_variance        = render(LightSampling::area, area_mean);
+    double solid_angle_variance = render(LightSampling::solid_angle, solid_angle_mean);
+    EXPECT_NEAR(solid_angle_mean, area_mean, 0.02 * area_mean);
+    EXPECT_LT(solid_angle_variance, 0.8 * area_variance);
+}
@@ -0,0 +1,130 @@
+#include "bvh.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "scene.h"
+#include "utils.h"
+
+TEST(Bvh, MatchesLinearSearch) {
+    auto material = std::make_shared<MaterialDiffuse>();
+
+    TestScene linear;
+    TestScene accelerated;
+    linear.clear();
+    accelerated.clear();
+
+    for (size_t i{}; i < 200; ++i) {
+        auto location = random_vec3(-20, 20);
+        auto rotation = random_vec3(0, 180);
+        auto scale    = Vec3::all(random_double(0.2, 2.0));
+        std::shared_ptr<Shape> shape = primitives.sphere;
+        if (i % 2) {
+            shape = primitives.rect_xz;
+        }
+        auto object   = create_geometry(shape, material, location, rotation, scale);
+        linear.add(object);
+        accelerated.add(object);
+    }
+    accelerated.build_accelerator();
+    ASSERT_FALSE(accelerated.get_accelerator().empty());
+    ASSERT_TRUE(linear.get_accelerator().empty());
+
+    for (size_t i{}; i < 2000; ++i) {
+        Ray ray{random_vec3(-30, 30), random_vec3(-1, 1)};
+        auto expected = linear.hit(ray);
+        auto actual   = accelerated.hit(ray);
+        ASSERT_EQ(expected.has_value(), actual.has_value());
+        if (expected.has_value()) {
+            EXPECT_NEAR(expected->t, actual->t, 1e-9);
+            EXPECT_EQ(expected->get_geometry(), actual->get_geometry());
+        }
+    }
+}
+
+TEST(Bvh, AddingObjectDropsAccelerator) {
+    TestScene scene;
+    EXPECT_FALSE(scene.get_accelerator().empty());
+
+    scene.add(create_geometry(
+        primitives.sphere, std::make_shared<Glass>(), {0, 0, 0}, {0, 0, 0}, Vec3::one()));
+    EXPECT_TRUE(scene.get_accelerator().empty());
+}
+
+TEST(Bvh, RefitAfterMovingObjects) {
+    auto material = std::make_shared<MaterialDiffuse>();
+
+    // Both scenes share the objects, so moving one moves it in both
+    TestScene linear;
+    TestScene accelerated;
+    linear.clear();
+    accelerated.clear();
+
+    std::vector<std::shared_ptr<Geometry>> objects;
+    for (size_t i{}; i < 100; ++i) {
+        auto object = create_geometry(
+            primitives.sphere, material, random_vec3(-20, 20), {0, 0, 0}, Vec3::all(1));
+        objects.push_back(object);
+        linear.add(object);
+        accelerated.add(object);
+    }
+    accelerated.build_accelerator();
+    auto built_cost = accelerated.get_accelerator().sah_cost();
+
+    for (size_t i{}; i < objects.size(); i += 3) {
+        objects[i]->set_transform({random_vec3(-20, 20), {0, 0, 0}, Vec3::all(1)});
+    }
+    EXPECT_FALSE(accelerated.update_accelerator(inf));
+    EXPECT_GT(accelerated.get_accelerator().sah_cost(), built_cost);
+
+    for (size_t i{}; i < 2000; ++i) {
+        Ray ray{random_vec3(-30, 30), random_vec3(-1, 1)};
+        auto expected = linear.hit(ray);
+        auto actual   = accelerated.hit(ray);
+        ASSERT_EQ(expected.has_value(), actual.has_value());
+        if (expected.has_value()) {
+            EXPECT_NEAR(expected->t, actual->t, 1e-9);
+            EXPECT_EQ(expected->get_geometry(), actual->get_geometry());
+        }
+    }
+
+    // A tree that degraded past the threshold is rebuilt
+    EXPECT_TRUE(accelerated.update_accelerator(1.0));
+}
+
+TEST(Bvh, DepthStaysWithinTraversalStack) {
+    // Exponentially spaced boxes, binned SAH splits off only the largest few per level and
+    // would go hundreds of levels deep
+    constexpr size_t count{400};
+    std::vector<Bounds3> boxes;
+    for (size_t i{}; i < count; ++i) {
+        double x = std::pow(2.0, static_cast<double>(i));
+        boxes.push_back({{x, -1, -1}, {x * 1.01, 1, 1}});
+    }
+    Bvh bvh;
+    bvh.build(boxes);
+
+    // Nodes are depth first, a node's depth is its parent's plus one
+    std::vector<size_t> depth(bvh.get_node_count(), 1);
+    size_t max_depth{};
+    for (size_t i{}; i < bvh.get_node_count(); ++i) {
+        const auto& node = bvh.get_nodes()[i];
+        max_depth        = std::max(max_depth, depth[i]);
+        if (node.primitive_count == 0) {
+            depth[i + 1]       = depth[i] + 1;
+            depth[node.offset] = depth[i] + 1;
+        }
+    }
+    EXPECT_LE(max_depth, Bvh::max_depth);
+
+    // A ray along the row meets every box
+    size_t hits{};
+    bvh.intersect({{0, 0, 0}, {1, 0, 0}}, 0.0, inf, [&](uint32_t, double&) {
+        ++hits;
+        return false;
+    });
+    EXPECT_EQ(hits, count);
+}
@@ -0,0 +1,94 @@
+#include "camera.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+TEST(Camera, TileRaysMatchSingleRays) {
+    constexpr int w{32};
+    constexpr int h{16};
+    constexpr size_t spp{3};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+    camera->set_vfov(50);
+
+    ImageTile tile{4, 2, 12, 7};
+    std::vector<double> u(tile.pixel_count() * spp);
+    std::vector<double> v(u.size());
+    for (size_t i{}; i < u.size(); ++i) {
+        u[i] = random_double();
+        v[i] = random_double();
+    }
+
+    RayBatch rays;
+    camera->generate_tile_rays(w, h, tile, spp, u.data(), v.data(), rays);
+    ASSERT_EQ(rays.size(), u.size());
+
+    size_t i{};
+    for (int y{tile.y0}; y < tile.y1; ++y) {
+        for (int x{tile.x0}; x < tile.x1; ++x) {
+            for (size_t s{}; s < spp; ++s, ++i) {
+                auto [u_img, v_img] = camera->to_image_plane_uv(w, h, x, y, u[i], v[i]);
+                auto expected       = camera->generate_ray(u_img, v_img);
+                auto actual         = rays.get(i);
+                EXPECT_TRUE(are_nearly_equal(expected.o, actual.o));
+                EXPECT_TRUE(are_nearly_equal(expected.d, actual.d, 1e-9));
+            }
+        }
+    }
+}
+
+TEST(Camera, BasisFollowsSetters) {
+    Camera camera{{0, 0, 0}, {0, 0, -1}};
+    auto center = camera.generate_ray(0.5, 0.5);
+    EXPECT_TRUE(are_nearly_equal(center.d.normalized(), {0, 0, -1}));
+
+    camera.set_location({1, 2, 3});
+    camera.focus_on_point({1, 2, 10});
+    center = camera.generate_ray(0.5, 0.5);
+    EXPECT_TRUE(are_nearly_equal(center.o, {1, 2, 3}));
+    EXPECT_TRUE(are_nearly_equal(center.d.normalized(), {0, 0, 1}));
+
+    // Wider field of view moves the corner rays further out
+    auto narrow = camera.generate_ray(0, 0).d.normalized();
+    camera.set_vfov(90);
+    auto wide = camera.generate_ray(0, 0).d.normalized();
+    EXPECT_LT(dot(wide, {0, 0, 1}), dot(narrow, {0, 0, 1}));
+}
+
+TEST(Camera, ProjectInvertsGenerateRay) {
+    Camera camera{{0, 4, 6}, {0, 0, -1}};
+    camera.set_aspect_ratio(1.5);
+    camera.focus_on_point({0, 0, 0});
+    for (auto [u, v] : {std::pair{0.5, 0.5}, std::pair{0.1, 0.8}, std::pair{0.95, 0.02}}) {
+        auto ray = camera.generate_ray(u, v);
+        auto uv  = camera.project(ray.o + 3.0 * ray.d);
+        ASSERT_TRUE(uv.has_value());
+        EXPECT_NEAR(uv->first, u, 1e-9);
+        EXPECT_NEAR(uv->second, v, 1e-9);
+    }
+    EXPECT_FALSE(camera.project({0, 4, 10}).has_value());
+    EXPECT_EQ(camera.direction_pdf(-camera.generate_ray(0.5, 0.5).d), 0.0);
+}
+
+TEST(Camera, DirectionPdfIntegratesToOne) {
+    Camera camera{{0, 0, 0}, {0, 0, -1}};
+    camera.set_aspect_ratio(1.5);
+
+    // Uniform directions over the sphere, density 1 / 4pi
+    constexpr int n{200000};
+    double sum{};
+    for (int i{}; i < n; ++i) {
+        double z   = random_double(-1, 1);
+        double phi = random_double(0, 2 * pi);
+        double r   = std::sqrt(1 - z * z);
+        sum += camera.direction_pdf({r * std::cos(phi), r * std::sin(phi), z});
+    }
+    EXPECT_NEAR(4 * pi * sum / n, 1.0, 0.02);
+}
@@ -0,0 +1,66 @@
+#include "denoiser.h"
+
+#include <gtest/gtest.h>
+
+#include "utils.h"
+
+namespace {
+
+// Noisy image of two flat halves with different normals
+struct TestImage {
+    Buffer2D<RgbColor> radiance;
+    FeatureBuffers features;
+};
+
+TestImage make_test_image(int w, int h, double noise) {
+    TestImage img{Buffer2D<RgbColor>{w, h}, FeatureBuffers{w, h}};
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            bool left     = x < w / 2;
+            double base   = left ? 0.2 : 0.8;
+            double sample = base + random_double(-noise, noise);
+
+            img.radiance.at(x, y)          = {sample, sample, sample};
+            img.features.albedo.at(x, y)   = Color::white;
+            img.features.normal.at(x, y)   = left ? Vec3{1, 0, 0} : Vec3{0, 1, 0};
+            img.features.depth.at(x, y)    = 5.0;
+            img.features.variance.at(x, y) = noise * noise / 3.0;
+        }
+    }
+    return img;
+}
+
+double mean_squared_error(const Buffer2D<RgbColor>& img, int w) {
+    double sum{};
+    for (int y{}; y < img.get_height(); ++y) {
+        for (int x{}; x < img.get_width(); ++x) {
+            double expected = x < w / 2 ? 0.2 : 0.8;
+            double d        = img.at(x, y).r() - expected;
+            sum += d * d;
+        }
+    }
+    return sum / static_cast<double>(img.size());
+}
+
+}  // namespace
+
+TEST(Denoiser, ReducesNoise) {
+    int w{64};
+    int h{32};
+    auto img      = make_test_image(w, h, 0.1);
+    auto filtered = denoise(img.radiance, img.features);
+
+    EXPECT_LT(mean_squared_error(filtered, w), 0.2 * mean_squared_error(img.radiance, w));
+}
+
+TEST(Denoiser, KeepsNormalEdges) {
+    int w{64};
+    int h{32};
+    auto img      = make_test_image(w, h, 0.0);
+    auto filtered = denoise(img.radiance, img.features);
+
+    for (int y{}; y < h; ++y) {
+        EXPECT_NEAR(filtered.at(w / 2 - 1, y).r(), 0.2, 1e-3);
+        EXPECT_NEAR(filtered.at(w / 2, y).r(), 0.8, 1e-3);
+    }
+}
@@ -0,0 +1,185 @@
+#include "coordinator.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+
+#include "protocol.h"
+#include "scene_cache.h"
+#include "socket.h"
+#include "worker.h"
+
+namespace {
+
+const char* test_scene = R"(
+film width 24 height 16 spp 4
+camera location 0 4 6 focus 0 0 0
+material white diffuse albedo 1 1 1
+shape sphere material white location 0 1 0
+shape rect_xz material white scale 20 1 20
+area_light location 0 6 0 scale 4 1 4 intensity 5
+)";
+
+}  // namespace
+
+TEST(Distributed, WorkUnits) {
+    auto units = make_work_units(70, 40, 32, 10, 3);
+
+    // 3 x 2 tiles, each in 3 sample ranges
+    ASSERT_EQ(units.size(), 18);
+    std::vector<double> samples(70 * 40, 0.0);
+    for (size_t i{}; i < units.size(); ++i) {
+        const auto& unit = units[i];
+        EXPECT_EQ(unit.id, i);
+        for (int y{unit.tile.y0}; y < unit.tile.y1; ++y) {
+            for (int x{unit.tile.x0}; x < unit.tile.x1; ++x) {
+                samples[y * 70 + x] += static_cast<double>(unit.samples);
+            }
+        }
+    }
+    for (auto count : samples) {
+        EXPECT_EQ(count, 10.0);
+    }
+    EXPECT_EQ(units[1].first_sample, 4);
+    EXPECT_EQ(units[2].first_sample, 7);
+}
+
+TEST(Distributed, Messages) {
+    auto path = (std::filesystem::temp_directory_path() / "v3_messages_test.sock").string();
+    ListenSocket listener{"unix:" + path};
+    auto client = Socket::connect(listener.get_address());
+    auto server = listener.accept();
+
+    // Not inherited by the workers a coordinator spawns
+    EXPECT_TRUE(::fcntl(listener.get_fd(), F_GETFD) & FD_CLOEXEC);
+    EXPECT_TRUE(::fcntl(server.get_fd(), F_GETFD) & FD_CLOEXEC);
+
+    RenderSetup setup;
+    setup.scene          = "dir with spaces/a.scene";
+    setup.image_width    = 64;
+    setup.image_height   = 32;
+    setup.aovs           = AovType::depth;
+    setup.path_policy    = "throughput-split";
+    setup.light_sampling = LightSampling::solid_angle;
+    send_message(client, MessageType::setup, encode_setup(setup));
+    auto message = receive_message(server);
+    ASSERT_TRUE(message.has_value());
+    EXPECT_EQ(message->type, MessageType::setup);
+    auto decoded = decode_setup(message->payload);
+    EXPECT_EQ(decoded.scene, setup.scene);
+    EXPECT_EQ(decoded.image_height, 32);
+    EXPECT_EQ(decoded.aovs, AovType::depth);
+    EXPECT_EQ(decoded.path_policy, "throughput-split");
+    EXPECT_EQ(decoded.light_sampling, LightSampling::solid_angle);
+
+    Film film{64, 32, {8, 0, 16, 8}, AovType::none};
+    film.sample_count.at(1, 1) = 3;
+    send_message(server, MessageType::result, encode_result(7, film));
+    message = receive_message(client);
+    ASSERT_TRUE(message.has_value());
+    auto [id, part] = decode_result(message->payload);
+    EXPECT_EQ(id, 7);
+    EXPECT_EQ(part.get_window().x0, 8);
+    EXPECT_DOUBLE_EQ(part.sample_count.at(1, 1), 3.0);
+
+    server.close();
+    EXPECT_FALSE(receive_message(client).has_value());
+}
+
+TEST(Distributed, RenderWithFailingWorkers) {
+    auto dir        = std::filesystem::temp_directory_path();
+    auto scene_path = (dir / "v3_distributed_test.scene").string();
+    std::ofstream{scene_path} << test_scene;
+
+    CoordinatorOptions options;
+    options.tile_size     = 8;
+    options.sample_splits = 2;
+    options.unit_timeout  = 0.5;
+    Coordinator coordinator{"127.0.0.1:0", options};
+
+    // Connected first, so they are accepted and get work before the healthy workers
+    auto crashing = Socket::connect(coordinator.get_address());
+    std::thread crashing_worker{[&] {
+        // Disconnects on its first unit
+        while (auto message = receive_message(crashing)) {
+            if (message->type != MessageType::setup) {
+                break;
+            }
+        }
+        crashing.close();
+    }};
+    auto hanging = Socket::connect(coordinator.get_address());
+    std::thread hanging_worker{[&] {
+        // Never answers, until the coordinator drops it
+        while (auto message = receive_message(hanging)) {
+            if (message->type == MessageType::shutdown) {
+                break;
+            }
+        }
+    }};
+
+    std::vector<std::thread> workers;
+    for (int i{}; i < 2; ++i) {
+        workers.emplace_back([&] { Worker{}.run(coordinator.get_address()); });
+    }
+
+    RenderSetup setup;
+    setup.scene        = scene_path;
+    setup.image_width  = 24;
+    setup.image_height = 16;
+    setup.aovs         = AovType::depth;
+    auto film = coordinator.render(setup, 4);
+    coordinator.shutdown_workers();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    crashing_worker.join();
+    hanging_worker.join();
+
+    EXPECT_GE(coordinator.get_retry_count(), 2);
+    ASSERT_EQ(film.get_width(), 24);
+    ASSERT_EQ(film.get_height(), 16);
+    for (int y{}; y < 16; ++y) {
+        for (int x{}; x < 24; ++x) {
+            EXPECT_EQ(film.sample_count.at(x, y), 4.0);
+        }
+    }
+
+    std::filesystem::remove(scene_path);
+    std::filesystem::remove(scene_cache_path(scene_path));
+}
+
+TEST(Distributed, RenderEndsOnExhaustedUnit) {
+    CoordinatorOptions options;
+    options.max_attempts = 2;
+    Coordinator coordinator{"127.0.0.1:0", options};
+
+    // Answers every unit with a failure, but stays connected
+    auto failing = Socket::connect(coordinator.get_address());
+    std::thread failing_worker{[&] {
+        while (auto message = receive_message(failing)) {
+            if (message->type == MessageType::shutdown) {
+                break;
+            }
+            if (message->type == MessageType::work) {
+                auto unit = decode_work_unit(message->payload);
+                send_message(failing, MessageType::failed, encode_failure(unit.id, "broken"));
+            }
+        }
+    }};
+
+    RenderSetup setup;
+    setup.scene        = "unused.scene";
+    setup.image_width  = 8;
+    setup.image_height = 8;
+    EXPECT_THROW(coordinator.render(setup, 1), std::runtime_error);
+    EXPECT_EQ(coordinator.worker_count(), 1);
+    coordinator.shutdown_workers();
+    failing_worker.join();
+}
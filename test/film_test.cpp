@@ -0,0 +1,209 @@
+#include "film.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+
+#include "pathtracer.h"
+#include "scene.h"
+
+TEST(Film, ResolveAveragesSums) {
+    Film film{2, 1, AovType::depth};
+    film.radiance.at(0, 0)     = {3, 6, 9};
+    film.sample_count.at(0, 0) = 3;
+    film.aovs.depth.at(0, 0)   = 6;
+
+    Buffer2D<RgbColor> radiance;
+    AovBuffers aovs;
+    film.resolve(radiance, aovs, nullptr);
+
+    EXPECT_DOUBLE_EQ(radiance.at(0, 0).r(), 1.0);
+    EXPECT_DOUBLE_EQ(radiance.at(0, 0).b(), 3.0);
+    EXPECT_DOUBLE_EQ(aovs.depth.at(0, 0), 2.0);
+
+    // No samples resolve to zero
+    EXPECT_DOUBLE_EQ(radiance.at(1, 0).g(), 0.0);
+}
+
+TEST(Film, TimeBudgetRender) {
+    constexpr int w{16};
+    constexpr int h{8};
+    constexpr size_t max_passes{3};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), max_passes};
+    renderer.load_scene(std::make_shared<TestScene>());
+    renderer.set_time_budget(10.0);
+    renderer.render(*camera);
+
+    // A tiny image finishes every pass well within the budget, spp caps the passes
+    const auto& counts = renderer.get_film().sample_count;
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            EXPECT_EQ(counts.at(x, y), static_cast<double>(max_passes));
+        }
+    }
+    EXPECT_EQ(renderer.get_stats().counters.camera_rays, w * h * max_passes);
+}
+
+TEST(Film, FirstPassAlwaysCompletes) {
+    constexpr int w{8};
+    constexpr int h{4};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->focus_on_point({0, 0, 0});
+
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), 100};
+    renderer.load_scene(std::make_shared<TestScene>());
+    renderer.set_time_budget(1e-9);
+    renderer.render(*camera);
+
+    const auto& counts = renderer.get_film().sample_count;
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            EXPECT_GE(counts.at(x, y), 1.0);
+        }
+    }
+}
+
+TEST(Film, MergeTilesAndSampleRanges) {
+    Film top{4, 2, {0, 0, 4, 1}, AovType::object_id};
+    Film bottom{4, 2, {1, 1, 4, 2}, AovType::object_id};
+    top.radiance.at(3, 0)        = {2, 2, 2};
+    top.sample_count.at(3, 0)    = 2;
+    top.aovs.object_id.at(3, 0)  = 5;
+    bottom.radiance.at(0, 0)     = {1, 0, 0};
+    bottom.sample_count.at(0, 0) = 1;
+
+    Film full{4, 2, AovType::object_id};
+    full.merge(top);
+    full.merge(bottom);
+    EXPECT_DOUBLE_EQ(full.radiance.at(3, 0).r(), 2.0);
+    EXPECT_DOUBLE_EQ(full.sample_count.at(1, 1), 1.0);
+    EXPECT_DOUBLE_EQ(full.aovs.object_id.at(3, 0), 5.0);
+
+    // A second sample range of the same tile adds its weights, ids stay with the first
+    top.aovs.object_id.at(3, 0) = 7;
+    full.merge(top);
+    EXPECT_DOUBLE_EQ(full.sample_count.at(3, 0), 4.0);
+    EXPECT_DOUBLE_EQ(full.aovs.object_id.at(3, 0), 5.0);
+
+    Film other_size{4, 3, AovType::object_id};
+    EXPECT_THROW(full.merge(other_size), std::runtime_error);
+    Film other_aovs{4, 2, AovType::none};
+    EXPECT_THROW(full.merge(other_aovs), std::runtime_error);
+    EXPECT_THROW(top.merge(bottom), std::runtime_error);
+    EXPECT_THROW((Film{4, 2, {2, 0, 5, 1}, AovType::none}), std::runtime_error);
+}
+
+TEST(Film, SaveLoad) {
+    auto path = (std::filesystem::temp_directory_path() / "v3_film_test.film").string();
+
+    Film film{8, 6, {2, 3, 5, 6}, AovType::depth | AovType::normal};
+    film.radiance.at(1, 2)     = {0.5, 1.5, 2.5};
+    film.sample_count.at(1, 2) = 3;
+    film.aovs.depth.at(0, 0)   = 4;
+    film.aovs.normal.at(2, 1)  = {0, 1, 0};
+    film.save(path);
+
+    auto loaded = Film::load(path);
+    EXPECT_EQ(loaded.get_full_width(), 8);
+    EXPECT_EQ(loaded.get_full_height(), 6);
+    EXPECT_EQ(loaded.get_window().x0, 2);
+    EXPECT_EQ(loaded.get_window().y1, 6);
+    EXPECT_EQ(loaded.get_aovs(), film.get_aovs());
+    EXPECT_DOUBLE_EQ(loaded.radiance.at(1, 2).g(), 1.5);
+    EXPECT_DOUBLE_EQ(loaded.sample_count.at(1, 2), 3.0);
+    EXPECT_DOUBLE_EQ(loaded.aovs.depth.at(0, 0), 4.0);
+    EXPECT_DOUBLE_EQ(loaded.aovs.normal.at(2, 1).y(), 1.0);
+
+    std::filesystem::remove(path);
+    EXPECT_THROW(Film::load(path), std::runtime_error);
+}
+
+TEST(Film, CropWindowRender) {
+    constexpr int w{16};
+    constexpr int h{8};
+    constexpr size_t spp{2};
+    const ImageTile crop{4, 2, 12, 5};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+    renderer.load_scene(std::make_shared<TestScene>());
+    renderer.set_crop_window(crop);
+    renderer.render(*camera);
+
+    const auto& film = renderer.get_film();
+    EXPECT_EQ(film.get_width(), 8);
+    EXPECT_EQ(film.get_height(), 3);
+    EXPECT_EQ(film.get_window().x0, crop.x0);
+    EXPECT_EQ(renderer.get_radiance().get_width(), 8);
+    EXPECT_EQ(renderer.get_stats().counters.camera_rays, crop.pixel_count() * spp);
+}
+
+namespace {
+
+PathTracer make_renderer(int w, int h, size_t spp, uint64_t seed) {
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+    renderer.load_scene(std::make_shared<TestScene>());
+    renderer.set_seed(seed);
+    return renderer;
+}
+
+}  // namespace
+
+TEST(Film, ReproducibleRenders) {
+    constexpr int w{16};
+    constexpr int h{8};
+    constexpr size_t spp{4};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    auto full = make_renderer(w, h, spp, 42);
+    full.render(*camera);
+    auto again = make_renderer(w, h, spp, 42);
+    again.render(*camera);
+    auto other_seed = make_renderer(w, h, spp, 43);
+    other_seed.render(*camera);
+
+    // Tiles rendered separately, in any order, give the same pixels
+    Film merged{w, h, AovType::none};
+    for (auto tile : {ImageTile{8, 4, 16, 8}, ImageTile{0, 0, 8, 4}, ImageTile{8, 0, 16, 4},
+                      ImageTile{0, 4, 8, 8}}) {
+        auto part = make_renderer(w, h, spp, 42);
+        part.set_crop_window(tile);
+        part.render(*camera);
+        merged.merge(part.get_film());
+    }
+
+    // Two sample ranges add up to the full render, up to summation order
+    Film ranges{w, h, AovType::none};
+    for (size_t first : {size_t{0}, size_t{2}}) {
+        auto part = make_renderer(w, h, 2, 42);
+        part.set_first_sample(first);
+        part.render(*camera);
+        ranges.merge(part.get_film());
+    }
+
+    bool seed_changes_image{false};
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            auto expected = full.get_film().radiance.at(x, y);
+            EXPECT_EQ(again.get_film().radiance.at(x, y).r(), expected.r());
+            EXPECT_EQ(merged.radiance.at(x, y).g(), expected.g());
+            EXPECT_NEAR(ranges.radiance.at(x, y).b(), expected.b(), 1e-9 * (1 + expected.b()));
+            seed_changes_image |= other_seed.get_film().radiance.at(x, y).r() != expected.r();
+        }
+    }
+    EXPECT_TRUE(seed_changes_image);
+}
@@ -0,0 +1,98 @@
+#include "guiding.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "pathtracer.h"
+#include "render_test_helpers.h"
+#include "rng.h"
+#include "scene.h"
+
+TEST(Guiding, DirectionMapping) {
+    for (const auto& d : {Vec3{0, 0, 1}, Vec3{0, -1, 0}, Vec3{0.6, -0.48, -0.64}}) {
+        auto back = square_to_direction(direction_to_square(d));
+        EXPECT_NEAR(back.x(), d.x(), 1e-6);
+        EXPECT_NEAR(back.y(), d.y(), 1e-6);
+        EXPECT_NEAR(back.z(), d.z(), 1e-6);
+    }
+}
+
+TEST(Guiding, QuadtreeFollowsRecordedRadiance) {
+    DirectionalQuadtree tree;
+    EXPECT_DOUBLE_EQ(tree.pdf({0.3, 0.8}), 1.0);
+
+    // Most light from one small patch of directions, a little from everywhere. The patch is
+    // aligned to the grid below, so the midpoint sum integrates the density exactly.
+    RandomStream::start(7, 0, 0);
+    DirectionalQuadtree learned;
+    for (int round{}; round < 4; ++round) {
+        for (int i{}; i < 20000; ++i) {
+            learned.record({random_double(), random_double()}, 0.1);
+            learned.record({(11 + random_double()) / 16, (3 + random_double()) / 16}, 1.0);
+        }
+        if (round < 3) {
+            learned = learned.refined();
+        }
+    }
+    EXPECT_GT(learned.node_count(), 4);
+
+    // The density integrates to one over the square
+    constexpr int n{1024};
+    double integral{};
+    for (int y{}; y < n; ++y) {
+        for (int x{}; x < n; ++x) {
+            integral += learned.pdf({(x + 0.5) / n, (y + 0.5) / n});
+        }
+    }
+    EXPECT_NEAR(integral / (n * n), 1.0, 1e-6);
+
+    // Samples land in the bright patch about as often as it holds light
+    int inside{};
+    constexpr int samples{20000};
+    for (int i{}; i < samples; ++i) {
+        auto p = learned.sample(random_double(), random_double());
+        EXPECT_GT(learned.pdf(p), 0.0);
+        inside += static_cast<int>(16 * p.x()) == 11 && static_cast<int>(16 * p.y()) == 3;
+    }
+    EXPECT_GT(static_cast<double>(inside) / samples, 0.8);
+}
+
+TEST(Guiding, FieldSplitsBusyRegions) {
+    Bounds3 bounds;
+    bounds.expand(Vec3{-1, -1, -1});
+    bounds.expand(Vec3{1, 1, 1});
+    GuidingField field{bounds};
+    EXPECT_EQ(field.sampling_tree({0, 0, 0}), nullptr);
+
+    for (int i{}; i < 50000; ++i) {
+        field.record({0.5, 0.5, 0.5}, {0, 1, 0}, 1.0);
+    }
+    field.refine(0);
+    EXPECT_GT(field.region_count(), 1);
+    ASSERT_NE(field.sampling_tree({0.5, 0.5, 0.5}), nullptr);
+    EXPECT_GT(field.sampling_tree({0.5, 0.5, 0.5})->pdf(direction_to_square({0, 1, 0})), 1.0);
+}
+
+TEST(Guiding, GuidedRenderMatchesUnguided) {
+    constexpr int w{8};
+    constexpr int h{4};
+    constexpr size_t spp{256};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    auto rendered_luminance = [&](bool guiding) {
+        PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+        renderer.load_scene(std::make_shared<TestScene>());
+        renderer.set_guiding(guiding);
+        renderer.render(*camera);
+        EXPECT_EQ(renderer.get_stats().counters.camera_rays, w * h * spp);
+        return mean_luminance(renderer.get_radiance());
+    };
+
+    // Guiding only changes where the paths go, not what they estimate
+    auto expected = rendered_luminance(false);
+    EXPECT_NEAR(rendered_luminance(true), expected, 0.05 * expected);
+}
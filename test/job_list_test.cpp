@@ -0,0 +1,53 @@
+#include "job_list.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+
+#include "utils.h"
+
+TEST(JobList, Parse) {
+    std::istringstream in{R"(
+        # comment
+        job a.scene output a.png width 64 height 32 spp 4
+        job /abs/b.scene location 1 2 3 focus 0 0 0 vfov 45
+        job c.scene crop 0 16 64 32 film bottom.film
+    )"};
+    auto jobs = parse_job_list(in, "jobs");
+    ASSERT_EQ(jobs.size(), 3);
+
+    EXPECT_EQ(jobs[0].scene, "jobs/a.scene");
+    EXPECT_EQ(jobs[0].output, "a.png");
+    EXPECT_EQ(jobs[0].image_width, 64);
+    EXPECT_EQ(jobs[0].image_height, 32);
+    EXPECT_EQ(jobs[0].samples_per_pixel, 4);
+    EXPECT_FALSE(jobs[0].camera_location.has_value());
+
+    EXPECT_EQ(jobs[1].scene, "/abs/b.scene");
+    EXPECT_FALSE(jobs[1].output.has_value());
+    EXPECT_TRUE(are_nearly_equal(*jobs[1].camera_location, Vec3{1, 2, 3}));
+    EXPECT_DOUBLE_EQ(*jobs[1].camera_vfov, 45);
+    EXPECT_FALSE(jobs[1].crop.has_value());
+
+    ASSERT_TRUE(jobs[2].crop.has_value());
+    EXPECT_EQ(jobs[2].crop->y0, 16);
+    EXPECT_EQ(jobs[2].crop->x1, 64);
+    EXPECT_EQ(jobs[2].film, "bottom.film");
+}
+
+TEST(JobList, Errors) {
+    std::istringstream missing_scene{"job"};
+    EXPECT_THROW(parse_job_list(missing_scene), std::runtime_error);
+
+    std::istringstream empty_crop{"job a.scene crop 0 0 0 8"};
+    EXPECT_THROW(parse_job_list(empty_crop), std::runtime_error);
+
+    std::istringstream unknown{"job a.scene\njob a.scene sp 4"};
+    try {
+        parse_job_list(unknown);
+        FAIL();
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ(std::string{e.what()}.rfind("line 2:", 0), 0);
+    }
+}
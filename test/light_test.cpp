@@ -0,0 +1,150 @@
+#include "light.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "scene.h"
+
+TEST(Light, SphereLightSamplesVisibleCap) {
+    auto light = create_sphere_light({0, 0, 0}, 1.0, Color::white, 2.0);
+    Vec3 ref{0, 0, 4};
+    EXPECT_NEAR(light->get_transformed_shape().compute_area(), 4 * pi, 1e-9);
+
+    // Irradiance at 'ref' facing the sphere is pi L sin^2 of the cone's half angle
+    constexpr int n{20000};
+    double irradiance{};
+    for (int i{}; i < n; ++i) {
+        auto [p, normal, pdf] = light->sample_from(ref);
+        auto d = ref - p;
+        ASSERT_NEAR(p.norm(), 1.0, 1e-9);
+        ASSERT_GT(dot(normal, d), 0.0);
+        ASSERT_GT(pdf, 0.0);
+
+        auto wi   = normalized(-d);
+        double g  = absdot(wi, {0, 0, 1}) * absdot(normal, wi) / dot(d, d);
+        irradiance += luminance(light->compute_emitted_radiance(p, d)) * g / pdf / n;
+    }
+    EXPECT_NEAR(irradiance, pi * 2.0 / 16.0, 0.01 * pi * 2.0 / 16.0);
+
+    // Cheaper than sampling the whole area, where half the points face away
+    auto variance = [&](bool cone) {
+        double sum{};
+        double sum_sq{};
+        for (int i{}; i < n; ++i) {
+            auto [p, normal, pdf] = cone ? light->sample_from(ref) : light->sample();
+            auto d   = ref - p;
+            auto wi  = normalized(-d);
+            double g = absdot(wi, {0, 0, 1}) * absdot(normal, wi) / dot(d, d);
+            double e = luminance(light->compute_emitted_radiance(p, d)) * g / pdf;
+            sum += e;
+            sum_sq += e * e;
+        }
+        return sum_sq / n - (sum / n) * (sum / n);
+    };
+    EXPECT_LT(variance(true), 0.1 * variance(false));
+
+    // Inside, the sphere falls back to its area
+    auto inside = light->sample_from({0, 0.5, 0});
+    EXPECT_NEAR(inside.pdf_value, 1.0 / (4 * pi), 1e-12);
+}
+
+TEST(Light, SphereLightEmitsOutwards) {
+    auto light = create_sphere_light({0, 2, 0}, 0.5);
+    EXPECT_FALSE(is_nearly_black(light->compute_emitted_radiance({0, 2.5, 0}, {0, 1, 0})));
+    EXPECT_TRUE(is_nearly_black(light->compute_emitted_radiance({0, 2.5, 0}, {0, -1, 0})));
+    for (int i{}; i < 100; ++i) {
+        auto sample = light->sample_emission();
+        EXPECT_GT(dot(sample.direction, sample.normal), 0.0);
+        EXPECT_NEAR(sample.pdf_direction, dot(sample.direction, sample.normal) / pi, 1e-9);
+    }
+}
+
+TEST(Light, RectLightSamplesSolidAngle) {
+    auto light = create_area_light({0, 2, 0}, {30, 0, 0}, Vec3::all(4), Color::white, 1.0);
+    light->set_sampling(LightSampling::solid_angle);
+    Vec3 ref{0.5, 0, 0.3};
+    Vec3 up{0, 1, 0};
+
+    // Irradiance of the rectangle by Lambert's formula, the sum over the edges of the angle
+    // they subtend times the cosine of their plane
+    const auto& transform = light->get_transformed_shape().get_transform();
+    std::vector<Vec3> corners{transform.on_point({-0.5, 0, -0.5}),
+                              transform.on_point({0.5, 0, -0.5}),
+                              transform.on_point({0.5, 0, 0.5}),
+                              transform.on_point({-0.5, 0, 0.5})};
+    double lambert{};
+    for (size_t i{}; i < corners.size(); ++i) {
+        auto a = normalized(corners[i] - ref);
+        auto b = normalized(corners[(i + 1) % corners.size()] - ref);
+        lambert += std::acos(dot(a, b)) * dot(normalized(cross(a, b)), up);
+    }
+    lambert = std::abs(lambert) / 2;
+
+    constexpr int n{20000};
+    auto estimate = [&](bool solid_angle, double& variance) {
+        double sum{};
+        double sum_sq{};
+        for (int i{}; i < n; ++i) {
+            auto [p, normal, pdf] = solid_angle ? light->sample_from(ref) : light->sample();
+            auto wi  = normalized(p - ref);
+            double e = dot(wi, up) * absdot(normalized(normal), wi) / dot(p - ref, p - ref) / pdf;
+            sum += e;
+            sum_sq += e * e;
+        }
+        variance = sum_sq / n - (sum / n) * (sum / n);
+        return sum / n;
+    };
+    double area_variance{};
+    double solid_angle_variance{};
+    EXPECT_NEAR(estimate(false, area_variance), lambert, 0.02 * lambert);
+    EXPECT_NEAR(estimate(true, solid_angle_variance), lambert, 0.01 * lambert);
+    EXPECT_LT(solid_angle_variance, 0.2 * area_variance);
+
+    // Samples land on the rectangle, and pdf_from() agrees with their density
+    for (int i{}; i < 1000; ++i) {
+        auto [p, normal, pdf] = light->sample_from(ref);
+        auto rec = light->hit({ref, p - ref}, 1e-6, 2.0);
+        ASSERT_TRUE(rec.has_value());
+        EXPECT_LT(distance(rec->p, p), 1e-6);
+        EXPECT_NEAR(light->pdf_from(ref, p), pdf, 1e-9 * pdf);
+    }
+
+    // The density integrates to one over the area
+    double integral{};
+    for (int i{}; i < n; ++i) {
+        auto sample = light->sample();
+        integral += light->pdf_from(ref, sample.p) / sample.pdf_value / n;
+    }
+    EXPECT_NEAR(integral, 1.0, 0.02);
+
+    // Area sampling, or a point in the plane of the rectangle that sees none of it
+    auto in_plane = transform.on_point({2, 0, 0});
+    EXPECT_NEAR(light->sample_from(in_plane).pdf_value, 1.0 / 16.0, 1e-12);
+    light->set_sampling(LightSampling::area);
+    EXPECT_NEAR(light->pdf_from(ref, corners[0]), 1.0 / 16.0, 1e-12);
+}
+
+TEST(Light, ParseLightSampling) {
+    EXPECT_EQ(parse_light_sampling("area"), LightSampling::area);
+    EXPECT_EQ(parse_light_sampling("solid-angle"), LightSampling::solid_angle);
+    EXPECT_THROW(parse_light_sampling("cone"), std::runtime_error);
+}
+
+TEST(Light, SceneRestoresDefaultSampling) {
+    TestScene scene;
+    scene.clear();
+    auto sphere = create_sphere_light({0, 0, 0}, 1.0, Color::white, 1.0);
+    auto rect   = create_area_light({0, 4, 0}, {0, 0, 0}, Vec3::all(2), Color::white, 1.0);
+    scene.add_light(sphere);
+    scene.add_light(rect);
+
+    scene.set_light_sampling(LightSampling::area);
+    EXPECT_EQ(sphere->get_sampling(), LightSampling::area);
+    scene.set_light_sampling(std::nullopt);
+    EXPECT_EQ(sphere->get_sampling(), LightSampling::solid_angle);
+    EXPECT_EQ(rect->get_sampling(), LightSampling::area);
+}
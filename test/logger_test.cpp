@@ -0,0 +1,68 @@
+#include "logger.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "thread_pool.h"
+
+namespace {
+
+struct CountedFormat {
+    static inline int formatted{};
+};
+
+std::ostream& operator<<(std::ostream& os, const CountedFormat&) {
+    ++CountedFormat::formatted;
+    return os << "counted";
+}
+
+}  // namespace
+
+TEST(Logger, LinesFromThreadsDontInterleave) {
+    std::string path{"logger_test.txt"};
+    std::ofstream{path, std::ios::trunc};
+    Logger::set_file(path);
+    Logger::set_level(LogLevel::debug);
+
+    constexpr size_t line_count{2000};
+    ThreadPool pool{3};
+    pool.parallel_for(0, line_count, [](size_t i) {
+        Logger::log("line ", i, " value ", 0.5 * static_cast<double>(i), " end");
+        // Keep the rings from overflowing
+        if (i % 100 == 0) {
+            Logger::flush();
+        }
+    });
+    Logger::flush();
+
+    std::ifstream file{path};
+    std::unordered_map<std::string, int> seen;
+    size_t lines{};
+    for (std::string line; std::getline(file, line); ++lines) {
+        ASSERT_EQ(line.rfind("line ", 0), 0) << line;
+        ASSERT_EQ(line.substr(line.size() - 4), " end") << line;
+        ++seen[line];
+    }
+    EXPECT_EQ(lines + Logger::dropped_count(), line_count);
+    for (const auto& [line, count] : seen) {
+        EXPECT_EQ(count, 1);
+    }
+}
+
+TEST(Logger, LevelCheckedBeforeFormatting) {
+    Logger::set_file("logger_level_test.txt");
+    Logger::set_level(LogLevel::warning);
+
+    CountedFormat::formatted = 0;
+    Logger::log_at(LogLevel::debug, CountedFormat{});
+    EXPECT_EQ(CountedFormat::formatted, 0);
+
+    Logger::log_at(LogLevel::error, CountedFormat{});
+    EXPECT_EQ(CountedFormat::formatted, 1);
+
+    Logger::flush();
+    Logger::set_level(LogLevel::debug);
+}
@@ -0,0 +1,59 @@
+#include "mlt.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "pathtracer.h"
+#include "render_test_helpers.h"
+#include "rng.h"
+
+TEST(Mlt, PrimarySampleReplaysAndRestores) {
+    MltOptions options;
+    options.large_step = 0.0;
+    PrimarySample sample{RandomStream::key(3, 0, 0), RandomStream::key(3, 1, 0), options};
+
+    // The first state is the stream of the initial key, read through RandomStream
+    RandomStream::replay(sample);
+    std::vector<double> first;
+    for (uint64_t i{}; i < 8; ++i) {
+        first.push_back(RandomStream::next());
+        EXPECT_EQ(first.back(), RandomStream::value(RandomStream::key(3, 0, 0), i));
+    }
+    RandomStream::end_replay();
+
+    // Small steps stay close, and a rejected step leaves the state as it was
+    sample.start_iteration();
+    for (uint64_t i{}; i < 8; ++i) {
+        double moved = sample.value(i);
+        EXPECT_NE(moved, first[i]);
+        EXPECT_GE(moved, 0.0);
+        EXPECT_LT(moved, 1.0);
+        double distance = std::abs(moved - first[i]);
+        EXPECT_LT(std::min(distance, 1.0 - distance), 0.1);
+    }
+    sample.reject();
+    sample.start_iteration();
+    sample.reject();
+    for (uint64_t i{}; i < 8; ++i) {
+        EXPECT_EQ(sample.value(i), first[i]);
+    }
+}
+
+TEST(Mlt, MatchesPathTracer) {
+    constexpr int w{16};
+    constexpr int h{8};
+
+    PathTracer reference{w, h, std::make_shared<PixelSampler>(), 512};
+    auto expected = render_diffuse_quadrants(reference);
+
+    MetropolisRenderer renderer{w, h, std::make_shared<PixelSampler>(), 512};
+    MltOptions options;
+    options.bootstrap = 20000;
+    options.chains    = 64;
+    renderer.set_mlt_options(options);
+    auto actual = render_diffuse_quadrants(renderer);
+    EXPECT_EQ(renderer.get_stats().counters.camera_rays, 20000 + 64 + w * h * 512);
+    expect_quadrants_near(actual, expected, 0.1);
+}
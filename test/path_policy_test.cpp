@@ -0,0 +1,105 @@
+#include "path_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "pathtracer.h"
+#include "render_test_helpers.h"
+#include "scene.h"
+
+TEST(PathPolicy, ConstantRoulette) {
+    ConstantRoulette policy{0.7};
+    EXPECT_DOUBLE_EQ(policy.continuation({Color::white, 1, true, 0.0, 0.0}), 0.7);
+    EXPECT_DOUBLE_EQ(policy.continuation({Color::black, 9, false, 1.0, 1.0}), 0.7);
+}
+
+TEST(PathPolicy, ThroughputRoulette) {
+    ThroughputRoulette policy;
+    // No roulette on the first vertices
+    EXPECT_DOUBLE_EQ(policy.continuation({Color::black, 2, true, 0.0, 0.0}), 1.0);
+
+    // Survival follows the throughput, within the probability bounds
+    EXPECT_DOUBLE_EQ(policy.continuation({{0.5, 0.5, 0.5}, 3, true, 0.0, 0.0}), 0.5);
+    EXPECT_DOUBLE_EQ(policy.continuation({{1e-4, 1e-4, 1e-4}, 3, true, 0.0, 0.0}), 0.05);
+    EXPECT_DOUBLE_EQ(policy.continuation({{3.0, 3.0, 3.0}, 3, false, 0.0, 0.0}), 0.95);
+
+    // Paths of pixels darker than the image count for more
+    EXPECT_DOUBLE_EQ(policy.continuation({{0.2, 0.2, 0.2}, 4, true, 0.1, 0.4}), 0.8);
+    EXPECT_DOUBLE_EQ(policy.continuation({{0.2, 0.2, 0.2}, 4, true, 0.4, 0.1}), 0.05);
+
+    auto split = create_path_policy("throughput-split");
+    EXPECT_EQ(split->name(), "throughput-split");
+    EXPECT_DOUBLE_EQ(split->continuation({Color::white, 1, true, 0.0, 0.0}), 4.0);
+    EXPECT_DOUBLE_EQ(split->continuation({Color::white, 1, false, 0.0, 0.0}), 1.0);
+
+    // Behind a specular first hit the first diffuse vertex splits, later ones don't
+    EXPECT_DOUBLE_EQ(split->continuation({Color::white, 2, true, 0.0, 0.0, false}), 4.0);
+    EXPECT_DOUBLE_EQ(split->continuation({Color::white, 2, true, 0.0, 0.0, true}), 1.0);
+    EXPECT_THROW(create_path_policy("never"), std::runtime_error);
+}
+
+TEST(PathPolicy, PoliciesAgreeOnTheImage) {
+    constexpr int w{8};
+    constexpr int h{4};
+    constexpr size_t spp{256};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    auto rendered_luminance = [&](const std::string& policy) {
+        PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+        renderer.load_scene(std::make_shared<TestScene>());
+        renderer.set_path_policy(create_path_policy(policy));
+        renderer.render(*camera);
+        EXPECT_GT(renderer.get_stats().variance_time(), 0.0);
+        return mean_luminance(renderer.get_radiance());
+    };
+
+    // Every policy is unbiased, so only noise separates the images
+    auto expected = rendered_luminance("constant");
+    EXPECT_NEAR(rendered_luminance("throughput"), expected, 0.05 * expected);
+    EXPECT_NEAR(rendered_luminance("throughput-split"), expected, 0.05 * expected);
+}
+
+TEST(PathPolicy, PathTracerMarksVerticesAfterDiffuse) {
+    // Counts the first diffuse vertex of each path, and those found through the glass sphere
+    class RecordingPolicy : public PathPolicy {
+      public:
+        double continuation(const PathVertexState& state) const override {
+            if (state.is_diffuse && !state.after_diffuse) {
+                ++first_diffuse;
+                if (state.depth > 1) {
+                    ++behind_specular;
+                }
+            }
+            return 0.8;
+        }
+
+        std::string name() const override { return "recording"; }
+
+        mutable std::atomic<size_t> first_diffuse{};
+        mutable std::atomic<size_t> behind_specular{};
+    };
+
+    constexpr int w{16};
+    constexpr int h{8};
+    constexpr size_t spp{4};
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    auto policy = std::make_shared<RecordingPolicy>();
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+    renderer.load_scene(std::make_shared<TestScene>());
+    renderer.set_path_policy(policy);
+    renderer.render(*camera);
+
+    // Paths don't split under this policy, so each has at most one
+    EXPECT_LE(policy->first_diffuse, static_cast<size_t>(w * h) * spp);
+    EXPECT_GT(policy->behind_specular, 0);
+}
@@ -0,0 +1,77 @@
+#include "photon_map.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "pathtracer.h"
+#include "render_test_helpers.h"
+#include "rng.h"
+#include "scene.h"
+
+TEST(PhotonMap, LookupFindsPhotonsInRadius) {
+    RandomStream::start(3, 0, 0);
+    std::vector<Photon> photons(5000);
+    for (auto& photon : photons) {
+        photon.p = random_vec3(-2.0, 2.0);
+    }
+
+    constexpr double radius{0.3};
+    PhotonMap map{photons, radius};
+    ASSERT_EQ(map.size(), photons.size());
+    for (int q{}; q < 50; ++q) {
+        auto p = random_vec3(-2.5, 2.5);
+        size_t expected{};
+        for (const auto& photon : photons) {
+            expected += distance(photon.p, p) <= radius;
+        }
+        size_t found{};
+        map.for_each_near(p, [&](const Photon&) { ++found; });
+        EXPECT_EQ(found, expected);
+    }
+}
+
+TEST(PhotonMap, CausticPhotonsLandOnDiffuseSurfaces) {
+    TestScene scene;
+    auto photons = trace_caustic_photons(scene, 20000, 0, 0);
+    ASSERT_FALSE(photons.empty());
+    // All through the glass sphere onto the floor or the walls around it
+    for (const auto& photon : photons) {
+        EXPECT_GE(photon.p.y(), -1e-6);
+        EXPECT_GT(luminance(photon.power), 0.0);
+    }
+    // Another pass traces other photons
+    auto next = trace_caustic_photons(scene, 20000, 0, 1);
+    ASSERT_FALSE(next.empty());
+    EXPECT_NE(next.front().p.x(), photons.front().p.x());
+}
+
+TEST(PhotonMap, CausticsMatchPathTracing) {
+    constexpr int w{8};
+    constexpr int h{4};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    auto rendered_luminance = [&](size_t spp, bool caustics, size_t photons, bool progressive) {
+        PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+        renderer.load_scene(std::make_shared<TestScene>());
+        CausticOptions options;
+        options.photons     = photons;
+        options.progressive = progressive;
+        renderer.set_caustics(caustics, options);
+        renderer.render(*camera);
+        return mean_luminance(renderer.get_radiance());
+    };
+
+    // Photons and paths estimate the same light, up to the blur of the gather radius. Without
+    // photons the caustics, about a tenth of this view, go missing.
+    auto expected = rendered_luminance(256, false, 0, false);
+    EXPECT_NEAR(rendered_luminance(256, true, 20000, false), expected, 0.05 * expected);
+    EXPECT_LT(rendered_luminance(256, true, 1, false), 0.95 * expected);
+
+    // The paths see the same random numbers in both, only the photons differ
+    auto fixed = rendered_luminance(64, true, 20000, false);
+    EXPECT_NEAR(rendered_luminance(64, true, 2000, true), fixed, 0.05 * fixed);
+}
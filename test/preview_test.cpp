@@ -0,0 +1,73 @@
+#include "preview.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <memory>
+
+#include "image.h"
+#include "pathtracer.h"
+#include "scene.h"
+
+TEST(Preview, WriterKeepsLatestSnapshot) {
+    auto path = (std::filesystem::temp_directory_path() / "v3_preview_writer_test.png").string();
+    std::filesystem::remove(path);
+
+    size_t written{};
+    {
+        PreviewWriter writer{path, DisplayOptions{}};
+        Film film{8, 4, ImageTile{2, 1, 6, 3}, AovType::none};
+        for (int pass{1}; pass <= 20; ++pass) {
+            film.radiance.fill({0.5 * pass, 0.5 * pass, 0.5 * pass});
+            film.sample_count.fill(pass);
+            writer.publish(film);
+        }
+        film.radiance.fill({0.0, 0.5 * 21, 0.0});
+        film.sample_count.fill(21);
+        writer.publish(film);
+        written = writer.written_count();
+    }
+    // Snapshots that arrive while one is being written replace each other
+    EXPECT_LE(written, 21);
+
+    Image image{path};
+    ASSERT_EQ(image.get_width(), 8);
+    ASSERT_EQ(image.get_height(), 4);
+    EXPECT_EQ(image.get_pixel_value_u(2, 1).r(), 0);
+    EXPECT_EQ(image.get_pixel_value_u(2, 1).g(), 188);  // sRGB of 0.5
+    EXPECT_EQ(image.get_pixel_value_u(1, 1).g(), 0);    // outside the window
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+    std::filesystem::remove(path);
+}
+
+TEST(Preview, ProgressiveRenderMatchesSinglePass) {
+    constexpr int w{16};
+    constexpr int h{8};
+    constexpr size_t spp{4};
+    auto path = (std::filesystem::temp_directory_path() / "v3_preview_render_test.png").string();
+    std::filesystem::remove(path);
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    PathTracer single{w, h, std::make_shared<PixelSampler>(), spp};
+    single.load_scene(std::make_shared<TestScene>());
+    single.render(*camera);
+
+    PathTracer progressive{w, h, std::make_shared<PixelSampler>(), spp};
+    progressive.load_scene(std::make_shared<TestScene>());
+    progressive.set_preview({path, 0.0, 1});
+    progressive.render(*camera);
+
+    EXPECT_TRUE(std::filesystem::exists(path));
+    EXPECT_EQ(progressive.get_stats().counters.camera_rays, w * h * spp);
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            auto expected = single.get_film().radiance.at(x, y);
+            auto actual   = progressive.get_film().radiance.at(x, y);
+            EXPECT_NEAR(actual.g(), expected.g(), 1e-9 * (1 + expected.g()));
+        }
+    }
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,35 @@
+#include "profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "thread_pool.h"
+
+TEST(Profiler, RecordsOnlyWhenEnabled) {
+    Profiler::clear();
+    Profiler::set_enabled(false);
+    { ProfileZone zone{"disabled"}; }
+    EXPECT_EQ(Profiler::event_count(), 0);
+
+    Profiler::set_enabled(true);
+    ThreadPool pool{3};
+    pool.parallel_for(0, 100, [](size_t) { ProfileZone zone{"work"}; });
+    Profiler::set_enabled(false);
+    EXPECT_EQ(Profiler::event_count(), 100);
+
+    std::string path{"profiler_test_trace.json"};
+    ASSERT_TRUE(Profiler::write_chrome_trace(path));
+
+    std::ifstream file{path};
+    std::stringstream content;
+    content << file.rdbuf();
+    auto json = content.str();
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\"", 0), 0);
+    EXPECT_NE(json.find("\"name\": \"work\", \"ph\": \"X\""), std::string::npos);
+
+    Profiler::clear();
+    EXPECT_EQ(Profiler::event_count(), 0);
+}
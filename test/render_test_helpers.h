@@ -0,0 +1,69 @@
+#pragma once
+
+// Scenes and image statistics the renderer tests compare against each other
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+
+#include "buffer2d.h"
+#include "camera.h"
+#include "renderer.h"
+#include "scene.h"
+
+// Diffuse floor and sphere under an area light, every surface lit from the side it faces
+inline std::shared_ptr<TestScene> create_diffuse_scene() {
+    auto scene = std::make_shared<TestScene>();
+    scene->clear();
+    auto white = std::make_shared<MaterialDiffuse>(Color::white, 0.8);
+    auto red   = std::make_shared<MaterialDiffuse>(Color::red, 0.8);
+    scene->add(create_geometry(primitives.rect_xz, white, {0, 0, 0}, {0, 0, 0}, Vec3::all(8)));
+    scene->add(create_geometry(primitives.sphere, red, {1, 1, 0}, {0, 0, 0}, Vec3::all(1)));
+    scene->add(create_area_light({0, 4, 0}, {0, 0, 0}, Vec3::all(2), Color::white, 4.0));
+    scene->build_accelerator();
+    return scene;
+}
+
+// Mean luminance of the whole image
+inline double mean_luminance(const Buffer2D<RgbColor>& radiance) {
+    double sum{};
+    for (size_t i{}; i < radiance.size(); ++i) {
+        sum += luminance(radiance.data()[i]);
+    }
+    return sum / static_cast<double>(radiance.size());
+}
+
+// Mean luminance of the four quadrants of the image, so misplaced samples show up
+inline std::array<double, 4> quadrant_luminance(const Buffer2D<RgbColor>& radiance) {
+    int w = radiance.get_width();
+    int h = radiance.get_height();
+    std::array<double, 4> res{};
+    for (int y{}; y < h; ++y) {
+        for (int x{}; x < w; ++x) {
+            res[2 * (2 * y / h) + 2 * x / w] += luminance(radiance.at(x, y)) * 4 / (w * h);
+        }
+    }
+    return res;
+}
+
+// Quadrant luminance of 'renderer' on the diffuse scene, seen from above the floor
+inline std::array<double, 4> render_diffuse_quadrants(RayTracer& renderer) {
+    auto camera = create_camera({0, 3, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(2.0);
+    camera->focus_on_point({0, 0.5, 0});
+
+    renderer.load_scene(create_diffuse_scene());
+    renderer.render(*camera);
+    return quadrant_luminance(renderer.get_radiance());
+}
+
+// Every quadrant of 'actual' within a relative 'tolerance' of 'expected', which must be lit
+inline void expect_quadrants_near(const std::array<double, 4>& actual,
+                                  const std::array<double, 4>& expected,
+                                  double tolerance) {
+    for (size_t i{}; i < 4; ++i) {
+        ASSERT_GT(expected[i], 0.0);
+        EXPECT_NEAR(actual[i], expected[i], tolerance * expected[i]);
+    }
+}
@@ -4,6 +4,8 @@
 
 #include <vector>
 
+#include "rng.h"
+
 TEST(Sampler, SamplerTest) {
     Sampler sampler;
 
@@ -24,4 +26,37 @@ TEST(Sampler, SamplerTest) {
         double prob{(1.0 * buckets[i]) / sample_count};
         EXPECT_NEAR(prob, prob_each_bucket, 0.001);
     }
-}
\ No newline at end of file
+}
+
+TEST(Sampler, RandomStreamIsCounterBased) {
+    RandomStream::start(7, 100, 3);
+    double a = RandomStream::next();
+    double b = RandomStream::next();
+    EXPECT_NE(a, b);
+
+    // Any dimension of any sample can be recomputed on its own
+    EXPECT_EQ(RandomStream::value(RandomStream::key(7, 100, 3), 1), b);
+    RandomStream::start(7, 100, 3, 1);
+    EXPECT_EQ(RandomStream::next(), b);
+
+    // Neighboring pixels, samples and seeds are unrelated
+    EXPECT_NE(RandomStream::key(7, 100, 3), RandomStream::key(7, 101, 3));
+    EXPECT_NE(RandomStream::key(7, 100, 3), RandomStream::key(7, 100, 4));
+    EXPECT_NE(RandomStream::key(7, 100, 3), RandomStream::key(8, 100, 3));
+}
+
+TEST(Sampler, RandomStreamUniform) {
+    // Dimension 0 over many samples, the way one pixel sees it
+    constexpr int sample_count{200000};
+    constexpr int bucket_count{20};
+    std::vector<int> buckets(bucket_count, 0);
+    for (int i{}; i < sample_count; ++i) {
+        double x = RandomStream::value(RandomStream::key(0, 5, i), 0);
+        ASSERT_GE(x, 0.0);
+        ASSERT_LT(x, 1.0);
+        ++buckets[static_cast<int>(x * bucket_count)];
+    }
+    for (auto count : buckets) {
+        EXPECT_NEAR(static_cast<double>(count) / sample_count, 1.0 / bucket_count, 0.002);
+    }
+}
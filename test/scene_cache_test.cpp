@@ -0,0 +1,94 @@
+#include "scene_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "image.h"
+#include "light.h"
+#include "utils.h"
+
+namespace {
+
+const char* cache_test_scene = R"(
+film width 40 height 20 spp 2 output cache_test.png
+camera location 0 4 6 focus 0 0 0 vfov 50
+material white diffuse albedo 1 1 1 reflectance 0.8
+material glass glass ior 1.4
+area_light location 0 4 0 scale 2 intensity 3
+sphere_light location -3 3 0 scale 0.5 color 1 0.5 0.2
+shape rect_xz material white scale 100
+shape sphere material glass location 0 1 0
+shape sphere material white location 2 1 0 scale 0.5
+)";
+
+}  // namespace
+
+TEST(SceneCache, RoundTrip) {
+    auto dir        = std::filesystem::temp_directory_path();
+    auto scene_path = (dir / "v3_cache_test.scene").string();
+    auto cache_path = scene_cache_path(scene_path);
+    std::filesystem::remove(cache_path);
+    std::ofstream{scene_path} << cache_test_scene;
+
+    EXPECT_FALSE(is_scene_cache_fresh(cache_path, scene_path));
+    auto parsed = load_scene_cached(scene_path);
+    EXPECT_TRUE(is_scene_cache_fresh(cache_path, scene_path));
+
+    auto cached = read_scene_cache(cache_path);
+    EXPECT_EQ(cached.settings.image_width, 40);
+    EXPECT_EQ(cached.settings.samples_per_pixel, 2);
+    EXPECT_EQ(cached.settings.output, "cache_test.png");
+    EXPECT_EQ(cached.scene->object_count(), 3);
+    EXPECT_EQ(cached.scene->light_count(), 2);
+    EXPECT_TRUE(std::dynamic_pointer_cast<SphereLight>(cached.scene->get_lights()[1]));
+    EXPECT_TRUE(are_nearly_equal(cached.camera->get_look_at(), parsed.camera->get_look_at()));
+
+    // Shared materials stay shared
+    auto objects = cached.scene->get_objects();
+    EXPECT_EQ(objects[0]->get_material(), objects[2]->get_material());
+
+    // The mapped BVH gives the same hits as the freshly built one
+    ASSERT_FALSE(cached.scene->get_accelerator().empty());
+    for (size_t i{}; i < 500; ++i) {
+        Ray ray{random_vec3(-5, 5) + Vec3{0, 6, 0}, random_vec3(-1, 1)};
+        auto expected = parsed.scene->hit(ray);
+        auto actual   = cached.scene->hit(ray);
+        ASSERT_EQ(expected.has_value(), actual.has_value());
+        if (expected.has_value()) {
+            EXPECT_NEAR(expected->t, actual->t, 1e-9);
+            EXPECT_EQ(expected->is_light(), actual->is_light());
+        }
+    }
+
+    // Touching the scene file invalidates the cache
+    std::ofstream{scene_path, std::ios::app} << "# edited\n";
+    EXPECT_FALSE(is_scene_cache_fresh(cache_path, scene_path));
+
+    std::filesystem::remove(scene_path);
+    std::filesystem::remove(cache_path);
+}
+
+TEST(SceneCache, TexturedMaterial) {
+    auto dir          = std::filesystem::temp_directory_path();
+    auto scene_path   = (dir / "v3_cache_texture_test.scene").string();
+    auto texture_path = (dir / "v3_cache_texture_test.png").string();
+    Image img{4, 4};
+    img.fill_u({255, 0, 0});
+    img.save(texture_path);
+    std::ofstream{scene_path} << "material red diffuse albedo 1 1 1 texture v3_cache_texture_test.png\n"
+                                 "shape sphere material red\n";
+
+    load_scene_cached(scene_path);
+    auto cached   = read_scene_cache(scene_cache_path(scene_path));
+    auto material = std::dynamic_pointer_cast<MaterialDiffuse>(
+        cached.scene->get_objects().front()->get_material());
+    ASSERT_TRUE(material && material->get_texture());
+    EXPECT_EQ(material->get_texture()->get_path(), texture_path);
+    EXPECT_NEAR(material->get_albedo({0.5, 0.5}).r(), 1.0, 1e-6);
+    EXPECT_NEAR(material->get_albedo({0.5, 0.5}).g(), 0.0, 1e-6);
+
+    std::filesystem::remove(scene_path);
+    std::filesystem::remove(scene_cache_path(scene_path));
+}
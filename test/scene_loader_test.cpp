@@ -0,0 +1,109 @@
+#include "scene_loader.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+TEST(SceneLoader, ParseScene) {
+    std::istringstream in{R"(
+# comment line
+film width 64 height 32 spp 4 output out.png
+camera location 0 4 6 focus 0 0 0 vfov 45
+
+material white diffuse albedo 1 1 1 reflectance 0.8
+material glass glass ior 1.5
+
+area_light location 0 4 0 scale 2 intensity 3
+shape rect_xz material white scale 1000  # trailing comment
+shape sphere material glass location 0 1 0 scale 1
+)"};
+
+    auto [scene, camera, settings, animations] = SceneLoader{}.load(in);
+
+    EXPECT_EQ(settings.image_width, 64);
+    EXPECT_EQ(settings.image_height, 32);
+    EXPECT_EQ(settings.samples_per_pixel, 4);
+    EXPECT_EQ(settings.output, "out.png");
+
+    EXPECT_EQ(scene->object_count(), 2);
+    EXPECT_EQ(scene->light_count(), 1);
+    EXPECT_TRUE(animations.empty());
+    EXPECT_TRUE(are_nearly_equal(camera->get_location(), {0, 4, 6}));
+
+    auto rec = scene->hit({{0, 5, 0}, {0, -1, 0}});
+    ASSERT_TRUE(rec.has_value());
+    EXPECT_TRUE(rec->is_light());
+    EXPECT_NEAR(rec->p.y(), 4.0, 1e-6);
+}
+
+TEST(SceneLoader, SharesMaterialsAndShapes) {
+    std::istringstream in{R"(
+material a diffuse albedo 1 0 0 reflectance 0.5
+material b diffuse albedo 1 0 0 reflectance 0.5
+material c diffuse albedo 0 1 0 reflectance 0.5
+shape sphere material a location 0 0 0
+shape sphere material b location 3 0 0
+shape sphere material c location 6 0 0
+)"};
+
+    auto desc    = SceneLoader{}.load(in);
+    auto objects = desc.scene->get_objects();
+    ASSERT_EQ(objects.size(), 3);
+
+    EXPECT_EQ(objects[0]->get_material(), objects[1]->get_material());
+    EXPECT_NE(objects[0]->get_material(), objects[2]->get_material());
+
+    auto shape = objects[0]->get_transformed_shape()->get_shape();
+    EXPECT_EQ(shape, primitives.sphere);
+    EXPECT_EQ(shape, objects[2]->get_transformed_shape()->get_shape());
+}
+
+TEST(SceneLoader, Animation) {
+    std::istringstream in{R"(
+material white diffuse
+area_light location 0 4 0 velocity 1 0 0
+shape sphere material white
+shape sphere material white location 0 1 0 velocity 0 0 0.5 spin 0 10 0
+)"};
+
+    auto desc = SceneLoader{}.load(in);
+    ASSERT_EQ(desc.animations.size(), 2);
+    EXPECT_TRUE(desc.animations[0].is_light);
+    EXPECT_EQ(desc.animations[0].index, 0);
+    EXPECT_FALSE(desc.animations[1].is_light);
+    EXPECT_EQ(desc.animations[1].index, 1);
+
+    apply_animations(*desc.scene, desc.animations, 4);
+    auto center = desc.scene->get_objects()[1]->get_transformed_shape()->get_transform().on_point(
+        Vec3::zero());
+    EXPECT_TRUE(are_nearly_equal(center, {0, 1, 2}));
+}
+
+TEST(SceneLoader, SphereLight) {
+    std::istringstream in{R"(
+sphere_light location 0 3 0 scale 0.5 color 1 0.8 0.6 intensity 10
+)"};
+    auto [scene, camera, settings, animations] = SceneLoader{}.load(in);
+    ASSERT_EQ(scene->light_count(), 1);
+
+    auto rec = scene->hit({{0, 5, 0}, {0, -1, 0}});
+    ASSERT_TRUE(rec.has_value());
+    EXPECT_TRUE(rec->is_light());
+    EXPECT_NEAR(rec->p.y(), 3.5, 1e-6);
+    EXPECT_NEAR(scene->get_lights()[0]->get_transformed_shape().compute_area(), pi, 1e-9);
+}
+
+TEST(SceneLoader, Errors) {
+    auto load = [](const std::string& text) {
+        std::istringstream in{text};
+        return SceneLoader{}.load(in);
+    };
+
+    EXPECT_THROW(load("teapot"), std::runtime_error);
+    EXPECT_THROW(load("shape sphere material missing"), std::runtime_error);
+    EXPECT_THROW(load("material m diffuse albedo 1 1"), std::runtime_error);
+    EXPECT_THROW(load("material m diffuse colour 1 1 1"), std::runtime_error);
+    EXPECT_THROW(load("film width 0"), std::runtime_error);
+    EXPECT_THROW(load("sphere_light scale 1 2 1"), std::runtime_error);
+    EXPECT_THROW(SceneLoader{}.load_file("no/such/file.scene"), std::runtime_error);
+}
@@ -47,3 +47,18 @@ TEST(Shape, RectXZ) {
     EXPECT_FALSE(big_rect.hit(s11, 0.01, inf));
     EXPECT_FALSE(big_rect.hit(s12, 0.01, inf));
 }
+
+TEST(Shape, SphereAreaAndSamples) {
+    TransformedShape sphere{primitives.sphere, {1, 2, 3}, {0, 0, 0}, Vec3::all(2)};
+    EXPECT_NEAR(sphere.compute_area(), 16 * pi, 1e-9);
+
+    Vec3 mean{Vec3::zero()};
+    for (int i{}; i < 1000; ++i) {
+        auto sample = sphere.sample_shape();
+        EXPECT_NEAR(distance(sample.p, {1, 2, 3}), 2.0, 1e-9);
+        EXPECT_GT(dot(sample.normal, sample.p - Vec3{1, 2, 3}), 0.0);
+        EXPECT_NEAR(sample.pdf_value, 1.0 / (16 * pi), 1e-12);
+        mean += sample.p / 1000.0;
+    }
+    EXPECT_LT(distance(mean, {1, 2, 3}), 0.2);
+}
@@ -0,0 +1,57 @@
+#include "stats.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "pathtracer.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+TEST(Stats, CollectFromAllThreads) {
+    reset_stats();
+
+    ThreadPool pool{3};
+    pool.parallel_for(0, 1000, [](size_t i) {
+        auto& stats = thread_stats();
+        ++stats.shadow_queries;
+        stats.record_path_length(i % 20);
+    });
+
+    auto total = collect_stats();
+    EXPECT_EQ(total.shadow_queries, 1000);
+    EXPECT_EQ(total.path_lengths[0], 50);
+    EXPECT_EQ(total.path_lengths[StatCounters::max_path_length], 4 * 50);
+
+    reset_stats();
+    EXPECT_EQ(collect_stats().shadow_queries, 0);
+}
+
+TEST(Stats, RenderCounters) {
+    constexpr int w{16};
+    constexpr int h{8};
+    constexpr size_t spp{2};
+
+    auto camera = create_camera({0, 4, 6}, {0, 0, -1});
+    camera->set_aspect_ratio(static_cast<double>(w) / h);
+    camera->focus_on_point({0, 0, 0});
+
+    PathTracer renderer{w, h, std::make_shared<PixelSampler>(), spp};
+    renderer.load_scene(std::make_shared<TestScene>());
+    renderer.render(*camera);
+
+    const auto& stats = renderer.get_stats();
+    const auto& c     = stats.counters;
+    EXPECT_EQ(c.camera_rays, w * h * spp);
+    EXPECT_GE(c.closest_hit_queries, c.camera_rays);
+
+    // Every camera ray ends in exactly one path
+    uint64_t paths{};
+    for (auto count : c.path_lengths) {
+        paths += count;
+    }
+    EXPECT_EQ(paths, c.camera_rays);
+
+    EXPECT_GT(stats.stage_seconds("render"), 0.0);
+    EXPECT_FALSE(stats.bsdf_samples.empty());
+}
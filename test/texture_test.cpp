@@ -0,0 +1,135 @@
+#include "image_texture.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <sstream>
+
+#include "image.h"
+#include "rng.h"
+#include "scene_loader.h"
+#include "texture_cache.h"
+
+namespace {
+
+// Image whose red and green channels encode the pixel position
+std::string write_test_image(const std::string& name, int width, int height) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    Image img{width, height};
+    for (int y{}; y < height; ++y) {
+        for (int x{}; x < width; ++x) {
+            img.set_pixel_value_u(x, y, {static_cast<uint8_t>(x), static_cast<uint8_t>(y), 128});
+        }
+    }
+    img.save(path);
+    std::filesystem::remove(tiled_texture_path(path));
+    return path;
+}
+
+}  // namespace
+
+TEST(SrgbConversion, RoundTrip) {
+    EXPECT_DOUBLE_EQ(srgb_to_linear(0.0), 0.0);
+    EXPECT_DOUBLE_EQ(srgb_to_linear(1.0), 1.0);
+    EXPECT_NEAR(srgb_to_linear(0.5), 0.214, 1e-3);
+    for (double x : {0.01, 0.2, 0.5, 0.9}) {
+        EXPECT_NEAR(linear_to_srgb(srgb_to_linear(x)), x, 1e-9);
+    }
+}
+
+TEST(ImageTexture, TexelsMatchSourceImage) {
+    auto path = write_test_image("v3_texture_test.png", 100, 70);
+    TextureCache cache{1 << 20};
+    ImageTexture texture{path, cache};
+
+    EXPECT_TRUE(std::filesystem::exists(tiled_texture_path(path)));
+    EXPECT_EQ(texture.get_width(), 100);
+    EXPECT_EQ(texture.get_height(), 70);
+    EXPECT_EQ(texture.level_count(), 7);  // 100, 50, 25, 12, 6, 3, 1
+
+    for (auto [x, y] : {std::pair{0, 0}, {63, 5}, {64, 64}, {99, 69}}) {
+        auto c = texture.texel(0, x, y);
+        EXPECT_NEAR(c.r(), srgb_to_linear(x / 255.0), 1e-6);
+        EXPECT_NEAR(c.g(), srgb_to_linear(y / 255.0), 1e-6);
+        EXPECT_NEAR(c.b(), srgb_to_linear(128 / 255.0), 1e-6);
+    }
+    // Coordinates wrap around
+    EXPECT_NEAR(texture.texel(0, 100, -1).g(), srgb_to_linear(69 / 255.0), 1e-6);
+
+    // v = 0 is the bottom row, lookups at texel centers return the texel
+    auto bottom_left = texture.lookup({0.5 / 100, 0.5 / 70});
+    EXPECT_NEAR(bottom_left.r(), srgb_to_linear(0.0), 1e-6);
+    EXPECT_NEAR(bottom_left.g(), srgb_to_linear(69 / 255.0), 1e-6);
+
+    // The coarsest level is the average color
+    auto average = texture.lookup({0.3, 0.6}, 100.0);
+    EXPECT_NEAR(average.b(), srgb_to_linear(128 / 255.0), 2e-3);
+}
+
+TEST(ImageTexture, ReusesTiledFile) {
+    auto path = write_test_image("v3_texture_reuse_test.png", 20, 10);
+    TextureCache cache{1 << 20};
+    ImageTexture{path, cache};
+    auto stamp = std::filesystem::last_write_time(tiled_texture_path(path));
+
+    ImageTexture texture{path, cache};
+    EXPECT_EQ(std::filesystem::last_write_time(tiled_texture_path(path)), stamp);
+    EXPECT_NEAR(texture.texel(0, 19, 9).r(), srgb_to_linear(19 / 255.0), 1e-6);
+}
+
+TEST(TextureCache, EvictsLeastRecentlyUsed) {
+    constexpr size_t tile_bytes{TextureTile::size * TextureTile::size * 3 * sizeof(float)};
+    // Every key below maps to one shard, which gets a sixteenth of the budget
+    TextureCache cache{2 * tile_bytes * TextureCache::shard_count};
+    size_t loads{};
+    auto load = [&] {
+        ++loads;
+        return TextureTile{std::vector<float>(tile_bytes / sizeof(float))};
+    };
+
+    auto key        = [](int i) { return TextureCache::tile_key(1, 0, i, 0); };
+    auto shard_hash = [](uint64_t k) { return mix_bits(k) % TextureCache::shard_count; };
+    // Find three keys sharing a shard
+    std::vector<uint64_t> keys;
+    for (int i{}; keys.size() < 3; ++i) {
+        if (shard_hash(key(i)) == shard_hash(key(0))) {
+            keys.push_back(key(i));
+        }
+    }
+
+    auto first = cache.get(keys[0], load);
+    cache.get(keys[1], load);
+    cache.get(keys[0], load);  // now the most recently used
+    cache.get(keys[2], load);  // evicts keys[1]
+    EXPECT_EQ(loads, 3);
+    EXPECT_EQ(cache.get_stats().evictions, 1);
+    EXPECT_EQ(cache.get_stats().resident_bytes, 2 * tile_bytes);
+
+    cache.get(keys[0], load);
+    EXPECT_EQ(loads, 3);
+    cache.get(keys[1], load);
+    EXPECT_EQ(loads, 4);
+
+    // Evicted tiles stay valid for their holders
+    cache.clear();
+    EXPECT_EQ(first->texels.size(), tile_bytes / sizeof(float));
+    EXPECT_EQ(cache.get_stats().resident_bytes, 0);
+}
+
+TEST(ImageTexture, SceneMaterialTexture) {
+    auto path = write_test_image("v3_texture_scene_test.png", 8, 8);
+    auto scene = "material checker diffuse albedo 0.5 1 1 texture " +
+                 std::filesystem::path{path}.filename().string() + "\n";
+    SceneLoader loader;
+    std::istringstream in{scene + "shape sphere material checker\n"};
+    auto desc = loader.load(in, std::filesystem::path{path}.parent_path().string());
+
+    auto material = std::dynamic_pointer_cast<MaterialDiffuse>(
+        desc.scene->get_objects().front()->get_material());
+    ASSERT_TRUE(material && material->get_texture());
+    EXPECT_EQ(material->get_texture()->get_path(), path);
+
+    auto albedo = material->get_albedo({0.5 / 8, 1 - 2.5 / 8});
+    EXPECT_NEAR(albedo.r(), 0.5 * srgb_to_linear(0 / 255.0), 1e-6);
+    EXPECT_NEAR(albedo.g(), srgb_to_linear(2 / 255.0), 1e-6);
+}
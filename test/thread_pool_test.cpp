@@ -0,0 +1,23 @@
+#include "thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+TEST(ThreadPool, ParallelFor) {
+    ThreadPool pool{3};
+    std::vector<int> visited(1000, 0);
+    pool.parallel_for(0, visited.size(), [&](size_t i) { ++visited[i]; }, 7);
+    for (auto v : visited) {
+        EXPECT_EQ(v, 1);
+    }
+
+    EXPECT_THROW(pool.parallel_for(0, 100,
+                                   [](size_t i) {
+                                       if (i == 42) {
+                                           throw std::runtime_error{"fail"};
+                                       }
+                                   }),
+                 std::runtime_error);
+}
@@ -0,0 +1,85 @@
+#include "tonemap.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace {
+
+RgbColorU8 display_value(const RgbColor& linear, const DisplayOptions& options) {
+    Buffer2D<RgbColor> radiance{1, 1, linear};
+    Image image{1, 1};
+    write_display_image(radiance, options, image);
+    return image.get_pixel_value_u(0, 0);
+}
+
+}  // namespace
+
+TEST(Tonemap, SrgbEncodingMatchesExactCurve) {
+    DisplayOptions options;
+    for (int i{}; i <= 1000; ++i) {
+        double linear = std::pow(i / 1000.0, 2.2);
+        auto expected = static_cast<int>(std::lround(255.0 * linear_to_srgb(linear)));
+        auto actual   = display_value({linear, linear, linear}, options);
+        EXPECT_NEAR(actual.r(), expected, 1) << linear;
+        EXPECT_EQ(actual.r(), actual.b());
+    }
+    EXPECT_EQ(display_value({0.5, 0.0, 1.0}, options).r(), 188);
+}
+
+TEST(Tonemap, LinearOutputAndExposure) {
+    DisplayOptions options;
+    options.srgb = false;
+    EXPECT_EQ(display_value({0.5, 0.0, 2.0}, options).r(), 128);
+    EXPECT_EQ(display_value({0.5, 0.0, 2.0}, options).b(), 255);
+
+    options.exposure = -1.0;
+    EXPECT_EQ(display_value({0.5, 0.0, 2.0}, options).r(), 64);
+    EXPECT_EQ(display_value({0.5, 0.0, 2.0}, options).b(), 255);
+
+    // Negative and NaN radiance end up black
+    EXPECT_EQ(display_value({-1.0, std::nan(""), 0.0}, options).r(), 0);
+    EXPECT_EQ(display_value({-1.0, std::nan(""), 0.0}, options).g(), 0);
+}
+
+TEST(Tonemap, CurvesAreMonotonicAndCompressHighlights) {
+    for (auto name : {"reinhard", "aces", "filmic"}) {
+        DisplayOptions options;
+        options.tonemapper = parse_tonemapper(name);
+        int previous{-1};
+        for (double x{}; x < 50.0; x = x * 1.2 + 0.001) {
+            int value = display_value({x, x, x}, options).g();
+            EXPECT_GE(value, previous) << name << " " << x;
+            previous = value;
+        }
+        // Unlike clamping, values above 1 are still told apart
+        EXPECT_LT(display_value({1.0, 1.0, 1.0}, options).r(),
+                  display_value({4.0, 4.0, 4.0}, options).r())
+            << name;
+    }
+    EXPECT_THROW(parse_tonemapper("gamma"), std::runtime_error);
+}
+
+TEST(Tonemap, DitherKeepsTheMeanAndOffsetsWindows) {
+    DisplayOptions options;
+    options.srgb   = false;
+    options.dither = true;
+
+    // 100.3 / 255 has to round to 100 or 101, averaging 100.3
+    Buffer2D<RgbColor> radiance{64, 64, RgbColor{100.3 / 255, 100.3 / 255, 100.3 / 255}};
+    Image image{80, 70};
+    image.fill(Color::black);
+    write_display_image(radiance, options, image, 16, 6);
+
+    double sum{};
+    for (int y{6}; y < 70; ++y) {
+        for (int x{16}; x < 80; ++x) {
+            auto value = image.get_pixel_value_u(x, y).g();
+            EXPECT_TRUE(value == 100 || value == 101);
+            sum += value;
+        }
+    }
+    EXPECT_NEAR(sum / (64 * 64), 100.3, 0.05);
+    EXPECT_EQ(image.get_pixel_value_u(15, 6).g(), 0);
+    EXPECT_EQ(image.get_pixel_value_u(16, 5).g(), 0);
+}